@@ -1,15 +1,253 @@
+#include "iterative.hpp"
+#include "pack.hpp"
+#include "pooled.hpp"
+#include "staged.hpp"
 #include "utils.hpp"
 #include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
 #if !(defined FPGA_EMU || defined FPGA_HW)
 #define FPGA_EMU
 #endif
 
+// Parses size mix of form `<MB>:<weight>[,<MB>:<weight>...]` ( say `1:8,16:1`
+// ), where each size is power of 2 MB, into ( chunk count, weight ) pairs
+//
+// Returns empty mix, when malformed
+static std::vector<std::pair<size_t, size_t>>
+parse_mix(const std::string& str)
+{
+  std::vector<std::pair<size_t, size_t>> mix;
+
+  std::istringstream ss{ str };
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    size_t mb = 0, weight = 0;
+    char sep = 0;
+
+    std::istringstream is{ item };
+    if (!(is >> mb >> sep >> weight) || sep != ':' || mb == 0 || weight == 0 ||
+        (mb & (mb - 1)) != 0) {
+      return {};
+    }
+
+    mix.emplace_back((mb << 20) / blake3::CHUNK_LEN, weight);
+  }
+
+  return mix;
+}
+
+// Hashes continuously for `duration_s` seconds, at given size mix, printing
+// throughput, latency and resident memory of each `interval_s` -seconds
+// interval as soon as it ends, then drift between first and last quarters of
+// run, see `run_soak`
+static int
+soak(sycl::queue& q,
+     const double duration_s,
+     const double interval_s,
+     const std::string& mix_str)
+{
+  const auto mix = parse_mix(mix_str);
+  if (mix.empty() || duration_s <= 0 || interval_s <= 0) {
+    std::cerr << "bad soak configuration" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Soaking BLAKE3 FPGA implementation, for " << duration_s
+            << " s, at size mix " << mix_str << " ( MB:weight )" << std::endl
+            << std::endl;
+  std::cout << std::setw(16) << std::right << "elapsed"
+            << "\t\t" << std::setw(16) << std::right << "requests"
+            << "\t\t" << std::setw(16) << std::right << "throughput"
+            << "\t\t" << std::setw(16) << std::right << "mean latency"
+            << "\t\t" << std::setw(16) << std::right << "max latency"
+            << "\t\t" << std::setw(16) << std::right << "RSS" << std::endl;
+
+  const auto series =
+    run_soak(q, mix, duration_s, interval_s, [](const soak_interval_t& i) {
+      std::cout << std::setw(14) << std::right << std::fixed
+                << std::setprecision(1) << i.elapsed_s << " s"
+                << "\t\t" << std::setw(16) << std::right << i.requests
+                << "\t\t" << std::setw(22) << std::right
+                << to_readable_bandwidth(i.bytes, i.length_s * 1e9) << "\t\t"
+                << std::setw(22) << std::right
+                << to_readable_timespan(i.mean_ns) << "\t\t" << std::setw(22)
+                << std::right << to_readable_timespan(i.max_ns) << "\t\t"
+                << std::setw(13) << std::right << (i.rss_kb >> 10) << " MB"
+                << (i.partial ? "\t\t( partial, not in drift )" : "")
+                << std::endl;
+    });
+
+  const soak_drift_t drift = soak_drift(series);
+
+  std::cout << std::endl
+            << "drift ( last vs first quarter ) : throughput "
+            << std::showpos << drift.throughput * 100 << "%, latency "
+            << drift.latency * 100 << "%, RSS " << drift.rss * 100 << "%"
+            << std::noshowpos << std::endl;
+
+  if (drift.flagged) {
+    std::cout << "DRIFT beyond " << SOAK_DRIFT * 100 << "% !" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// Varies number of host threads submitting hash requests, queue sharing (
+// one shared queue or one per thread ), queue ordering and input size,
+// printing aggregate throughput and per request latency, see `run_scaling`
+//
+// Each configuration issues `sample_cnt` -many requests in total ( split
+// evenly across threads ), so that p99 latency is estimated from a few
+// samples above it, not just the slowest request
+static int
+scale(sycl::queue& q)
+{
+  constexpr size_t sample_cnt = 512;
+
+  std::cout << "Benchmarking BLAKE3 FPGA implementation, with concurrent "
+               "submitters"
+            << std::endl
+            << std::endl;
+  std::cout << std::setw(16) << std::right << "input size"
+            << "\t\t" << std::setw(8) << std::right << "threads"
+            << "\t\t" << std::setw(24) << std::right << "queues"
+            << "\t\t" << std::setw(16) << std::right << "throughput"
+            << "\t\t" << std::setw(16) << std::right << "mean latency"
+            << "\t\t" << std::setw(16) << std::right << "p99 latency"
+            << std::endl;
+
+  for (size_t i = 1 << 10; i <= 1 << 14; i <<= 4) {
+    for (size_t threads = 1; threads <= 8; threads <<= 1) {
+      for (const bool per_thread : { false, true }) {
+        for (const bool in_order : { true, false }) {
+          const scale_result_t res = run_scaling(
+            q, threads, per_thread, in_order, i, sample_cnt / threads);
+
+          const std::string queues =
+            std::string(per_thread ? "per-thread" : "shared") +
+            (in_order ? ", in-order" : ", out-of-order");
+
+          std::cout << std::setw(13) << std::right
+                    << ((i * blake3::CHUNK_LEN) >> 20) << " MB"
+                    << "\t\t" << std::setw(8) << std::right << threads
+                    << "\t\t" << std::setw(24) << std::right << queues
+                    << "\t\t" << std::setw(22) << std::right
+                    << to_readable_bandwidth(res.bytes, res.elapsed_ns)
+                    << "\t\t" << std::setw(22) << std::right
+                    << to_readable_timespan(res.mean_ns) << "\t\t"
+                    << std::setw(22) << std::right
+                    << to_readable_timespan(res.p99_ns) << std::endl;
+        }
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// Replays hash requests of trace file ( see `load_trace` ), once for each
+// host/ accelerator crossover size ( see `run_replay` ), printing achieved
+// throughput, latency percentiles and routing decisions ( requests and bytes )
+// of each
+static int
+replay(sycl::queue& q,
+       const std::string& path,
+       const std::vector<size_t>& host_max)
+{
+  const auto reqs = load_trace(path);
+  if (reqs.empty()) {
+    std::cerr << "failed to load trace " << path << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Replaying " << reqs.size() << " BLAKE3 requests of " << path
+            << std::endl
+            << std::endl;
+  std::cout << std::setw(16) << std::right << "host max"
+            << "\t\t" << std::setw(16) << std::right << "throughput"
+            << "\t\t" << std::setw(16) << std::right << "p50"
+            << "\t\t" << std::setw(16) << std::right << "p90"
+            << "\t\t" << std::setw(16) << std::right << "p99"
+            << "\t\t" << std::setw(16) << std::right << "p99.9"
+            << "\t\t" << std::setw(24) << std::right << "host/ device requests"
+            << "\t\t" << std::setw(24) << std::right << "host/ device MB"
+            << std::endl;
+
+  for (const size_t m : host_max) {
+    const replay_result_t res = run_replay(q, reqs, m);
+
+    const std::string routed = std::to_string(res.routed[0]) + "/ " +
+                               std::to_string(res.routed[1]);
+
+    std::ostringstream routed_mb;
+    routed_mb << std::fixed << std::setprecision(2)
+              << (double)res.routed_bytes[0] / (double)(1ul << 20) << "/ "
+              << (double)res.routed_bytes[1] / (double)(1ul << 20);
+
+    std::cout << std::setw(16) << std::right
+              << (m == SIZE_MAX ? "all" : std::to_string(m) + " B") << "\t\t"
+              << std::setw(22) << std::right
+              << to_readable_bandwidth(res.bytes, res.elapsed_ns) << "\t\t"
+              << std::setw(22) << std::right << to_readable_timespan(res.p50_ns)
+              << "\t\t" << std::setw(22) << std::right
+              << to_readable_timespan(res.p90_ns) << "\t\t" << std::setw(22)
+              << std::right << to_readable_timespan(res.p99_ns) << "\t\t"
+              << std::setw(22) << std::right
+              << to_readable_timespan(res.p999_ns) << "\t\t" << std::setw(24)
+              << std::right << routed << "\t\t" << std::setw(24) << std::right
+              << routed_mb.str() << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// Usage:
+//
+// - ./fpga_emu.out : sweeps kernels over input sizes
+// - ./fpga_emu.out --soak <seconds> [--interval <seconds>] [--mix <mix>] :
+// hashes continuously, at size mix ( see `parse_mix`, defaults to `1:8,16:1`
+// ), reporting each interval ( defaults to 60 s ), see `soak`
+// - ./fpga_emu.out --scale : varies concurrent submitters, see `scale`
+// - ./fpga_emu.out --replay <trace> [--host-max <bytes>]... : replays trace,
+// once per given crossover size ( defaults to 0, 16KB and all on host ), see
+// `replay`
 int
 main(int argc, char** argv)
 {
+  bool scaling = false;
+  double soak_s = 0;
+  double interval_s = 60;
+  std::string mix = "1:8,16:1";
+  std::string trace;
+  std::vector<size_t> host_max;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+
+    if (arg == "--scale") {
+      scaling = true;
+    } else if (arg == "--soak" && i + 1 < argc) {
+      soak_s = std::atof(argv[++i]);
+    } else if (arg == "--interval" && i + 1 < argc) {
+      interval_s = std::atof(argv[++i]);
+    } else if (arg == "--mix" && i + 1 < argc) {
+      mix = argv[++i];
+    } else if (arg == "--replay" && i + 1 < argc) {
+      trace = argv[++i];
+    } else if (arg == "--host-max" && i + 1 < argc) {
+      host_max.push_back(std::strtoull(argv[++i], nullptr, 10));
+    } else {
+      std::cerr << "usage: " << argv[0]
+                << " [--soak <seconds> [--interval <seconds>] [--mix <mix>]]"
+                   " [--scale] [--replay <trace> [--host-max <bytes>]...]"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
 
 #if defined FPGA_EMU
   sycl::ext::intel::fpga_emulator_selector s{};
@@ -26,9 +264,27 @@ main(int argc, char** argv)
   sycl::queue q{ ctx, d, sycl::property::queue::enable_profiling() };
 
   std::cout << "running on " << d.get_info<sycl::info::device::name>()
+            << std::endl
+            << "board profile " << blake3::BOARD.name << " ( "
+            << blake3::BOARD.iter_lanes << " iterative cores, "
+            << blake3::BOARD.pool_lanes << " pooled engines, "
+            << blake3::BOARD.spill_distance << " iterations spill distance )"
             << std::endl
             << std::endl;
 
+  if (soak_s > 0) {
+    return soak(q, soak_s, interval_s, mix);
+  }
+  if (scaling) {
+    return scale(q);
+  }
+  if (!trace.empty()) {
+    if (host_max.empty()) {
+      host_max = { 0, blake3::PACK_HOST_HASH_MAX, SIZE_MAX };
+    }
+    return replay(q, trace, host_max);
+  }
+
   constexpr size_t itr_cnt = 8;
   double* ts = static_cast<double*>(std::malloc(sizeof(double) * 3));
 
@@ -38,6 +294,7 @@ main(int argc, char** argv)
             << "\t\t" << std::setw(16) << std::right << "execution time"
             << "\t\t" << std::setw(16) << std::right << "host-to-device tx time"
             << "\t\t" << std::setw(16) << std::right << "device-to-host tx time"
+            << "\t\t" << std::setw(16) << std::right << "effective bandwidth"
             << std::endl;
 
   for (size_t i = 1 << 10; i <= 1 << 20; i <<= 1) {
@@ -49,8 +306,190 @@ main(int argc, char** argv)
               << to_readable_timespan(*(ts + 1)) << "\t\t" << std::setw(22)
               << std::right << to_readable_timespan(*(ts + 0)) << "\t\t"
               << std::setw(22) << std::right << to_readable_timespan(*(ts + 2))
+              << "\t\t" << std::setw(22) << std::right
+              << to_readable_bandwidth(i * blake3::CHUNK_LEN, *(ts + 1))
+              << std::endl;
+  }
+
+  // same kernel, but input message blocks are prefetched into on-chip double
+  // buffered staging memory, see include/staged.hpp
+  std::cout << std::endl
+            << "Benchmarking BLAKE3 FPGA implementation, with on-chip double "
+               "buffered input staging"
+            << std::endl
+            << std::endl;
+  std::cout << std::setw(24) << std::right << "input size"
+            << "\t\t" << std::setw(16) << std::right << "execution time"
+            << "\t\t" << std::setw(16) << std::right << "effective bandwidth"
+            << std::endl;
+
+  for (size_t i = 1 << 10; i <= 1 << 20; i <<= 1) {
+    avg_kernel_exec_tm(q, i, itr_cnt, ts, blake3::hash_staged<>);
+
+    std::cout << std::setw(20) << std::right << ((i * blake3::CHUNK_LEN) >> 20)
+              << " MB"
+              << "\t\t" << std::setw(22) << std::right
+              << to_readable_timespan(*(ts + 1)) << "\t\t" << std::setw(22)
+              << std::right
+              << to_readable_bandwidth(i * blake3::CHUNK_LEN, *(ts + 1))
               << std::endl;
   }
 
+  // one pool of compress engines shared by chunk and parent phases, see
+  // include/pooled.hpp; divide bandwidth by ALMs of each kernel ( in area
+  // report ) to compare throughput per ALM
+  std::cout << std::endl
+            << "Benchmarking BLAKE3 FPGA implementation, with shared compress "
+               "engine pool"
+            << std::endl
+            << std::endl;
+  std::cout << std::setw(24) << std::right << "input size"
+            << "\t\t" << std::setw(16) << std::right << "engines"
+            << "\t\t" << std::setw(16) << std::right << "execution time"
+            << "\t\t" << std::setw(16) << std::right << "effective bandwidth"
+            << std::endl;
+
+  const std::pair<hasher_t, size_t> pools[] = {
+    { blake3::hash_pooled<4>, 4 },
+    { blake3::hash_pooled<8>, 8 },
+  };
+
+  for (size_t i = 1 << 10; i <= 1 << 20; i <<= 1) {
+    for (const auto& [hasher, lanes] : pools) {
+      avg_kernel_exec_tm(q, i, itr_cnt, ts, hasher);
+
+      std::cout << std::setw(20) << std::right
+                << ((i * blake3::CHUNK_LEN) >> 20) << " MB"
+                << "\t\t" << std::setw(16) << std::right << lanes << "\t\t"
+                << std::setw(22) << std::right
+                << to_readable_timespan(*(ts + 1)) << "\t\t" << std::setw(22)
+                << std::right
+                << to_readable_bandwidth(i * blake3::CHUNK_LEN, *(ts + 1))
+                << std::endl;
+    }
+  }
+
+  // many small iterative compress cores, instead of a few unrolled ones, see
+  // include/iterative.hpp; compare against above kernels at equal ALMs
+  std::cout << std::endl
+            << "Benchmarking BLAKE3 FPGA implementation, with iterative "
+               "compress cores"
+            << std::endl
+            << std::endl;
+  std::cout << std::setw(24) << std::right << "input size"
+            << "\t\t" << std::setw(16) << std::right << "cores"
+            << "\t\t" << std::setw(16) << std::right << "execution time"
+            << "\t\t" << std::setw(16) << std::right << "effective bandwidth"
+            << std::endl;
+
+  // board's default core count, and twice as many
+  constexpr size_t lanes_0 = blake3::ITER_LANES;
+  constexpr size_t lanes_1 = blake3::ITER_LANES << 1;
+
+  const std::pair<hasher_t, size_t> cores[] = {
+    { blake3::hash_iterative<lanes_0>, lanes_0 },
+    { blake3::hash_iterative<lanes_1>, lanes_1 },
+  };
+
+  for (size_t i = 1 << 10; i <= 1 << 20; i <<= 1) {
+    for (const auto& [hasher, lanes] : cores) {
+      avg_kernel_exec_tm(q, i, itr_cnt, ts, hasher);
+
+      std::cout << std::setw(20) << std::right
+                << ((i * blake3::CHUNK_LEN) >> 20) << " MB"
+                << "\t\t" << std::setw(16) << std::right << lanes << "\t\t"
+                << std::setw(22) << std::right
+                << to_readable_timespan(*(ts + 1)) << "\t\t" << std::setw(22)
+                << std::right
+                << to_readable_bandwidth(i * blake3::CHUNK_LEN, *(ts + 1))
+                << std::endl;
+    }
+  }
+
+  // same kernel, while host waits for it using different strategies, see
+  // `wait_strategy`
+  std::cout << std::endl
+            << "Benchmarking host cost of waiting for BLAKE3 kernel"
+            << std::endl
+            << std::endl;
+  std::cout << std::setw(24) << std::right << "input size"
+            << "\t\t" << std::setw(16) << std::right << "wait strategy"
+            << "\t\t" << std::setw(16) << std::right << "execution time"
+            << "\t\t" << std::setw(16) << std::right << "host CPU time"
+            << "\t\t" << std::setw(16) << std::right << "wake up latency"
+            << std::endl;
+
+  const std::pair<wait_strategy, const char*> strategies[] = {
+    { wait_strategy::blocking, "blocking" },
+    { wait_strategy::yield, "yield" },
+    { wait_strategy::adaptive, "adaptive" },
+    { wait_strategy::polling, "polling" },
+  };
+
+  for (size_t i = 1 << 10; i <= 1 << 14; i <<= 2) {
+    for (const auto& [ws, name] : strategies) {
+      avg_wait_cost(q, i, itr_cnt, ws, ts);
+
+      std::cout << std::setw(20) << std::right
+                << ((i * blake3::CHUNK_LEN) >> 20) << " MB"
+                << "\t\t" << std::setw(16) << std::right << name << "\t\t"
+                << std::setw(22) << std::right
+                << to_readable_timespan(*(ts + 0)) << "\t\t" << std::setw(22)
+                << std::right << to_readable_timespan(*(ts + 1)) << "\t\t"
+                << std::setw(22) << std::right
+                << to_readable_timespan(*(ts + 2)) << std::endl;
+    }
+  }
+
+  // host observed latency of hashing small inputs, where submission overhead
+  // of input tx, kernel and digest tx commands is comparable to their execution
+  // time, see include/graph.hpp
+  std::cout << std::endl
+            << "Benchmarking BLAKE3 small input latency, with and without "
+               "command graph"
+            << std::endl
+            << std::endl;
+  std::cout << std::setw(24) << std::right << "input size"
+            << "\t\t" << std::setw(16) << std::right << "commands"
+            << "\t\t" << std::setw(16) << std::right << "command graph"
+            << std::endl;
+
+  for (size_t i = 1 << 2; i <= 1 << 10; i <<= 2) {
+    const double ts_0 = avg_graph_latency(q, i, itr_cnt, false);
+    const double ts_1 = avg_graph_latency(q, i, itr_cnt, true);
+
+    std::cout << std::setw(20) << std::right << i << " KB"
+              << "\t\t" << std::setw(22) << std::right
+              << to_readable_timespan(ts_0) << "\t\t" << std::setw(22)
+              << std::right << to_readable_timespan(ts_1) << std::endl;
+  }
+
+  // single chain of compressions on host, for small inputs, where latency of
+  // one digest matters, see include/simd.hpp
+  std::cout << std::endl
+            << "Benchmarking BLAKE3 host compression, for small inputs"
+            << std::endl
+            << std::endl;
+  std::cout << std::setw(24) << std::right << "input size"
+            << "\t\t" << std::setw(16) << std::right << "scalar"
+            << "\t\t" << std::setw(16) << std::right << "SSE4.1" << std::endl;
+
+  constexpr size_t h_itr_cnt = 1 << 16;
+
+  for (size_t i = blake3::BLOCK_LEN; i <= blake3::CHUNK_LEN; i <<= 2) {
+    const size_t blk_cnt = i / blake3::BLOCK_LEN;
+
+    const double ts_0 = avg_host_compress_tm(blk_cnt, h_itr_cnt, false);
+    const std::string ts_1 =
+      blake3::has_sse41()
+        ? to_readable_timespan(avg_host_compress_tm(blk_cnt, h_itr_cnt, true))
+        : "n/a";
+
+    std::cout << std::setw(20) << std::right << i << " B"
+              << "\t\t" << std::setw(22) << std::right
+              << to_readable_timespan(ts_0) << "\t\t" << std::setw(22)
+              << std::right << ts_1 << std::endl;
+  }
+
   return EXIT_SUCCESS;
 }
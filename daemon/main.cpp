@@ -0,0 +1,52 @@
+#include "daemon.hpp"
+#include <iostream>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#if !(defined FPGA_EMU || defined FPGA_HW)
+#define FPGA_EMU
+#endif
+
+// Local hashing daemon, which owns FPGA and accepts hashing requests from
+// local processes over Unix domain socket ( see include/daemon.hpp for both
+// client and server side )
+//
+// Usage: ./fpga_emu.out [socket path]
+//
+// When socket path isn't provided, it listens in user's private runtime
+// directory, see `blake3::daemon_default_path`
+int
+main(int argc, char** argv)
+{
+
+#if defined FPGA_EMU
+  sycl::ext::intel::fpga_emulator_selector s{};
+#elif defined FPGA_HW
+  sycl::ext::intel::fpga_selector s{};
+#endif
+
+  sycl::device d{ s };
+  sycl::context c{ d };
+  // in-order queue, so that commands of a job need not be chained explicitly
+  sycl::queue q{ c, d, sycl::property::queue::in_order() };
+
+  const std::string path =
+    argc > 1 ? std::string(argv[1]) : blake3::daemon_default_path();
+
+  blake3::daemon_server server{ q };
+
+  const int err = server.listen_on(path.c_str());
+  if (err != 0) {
+    std::cerr << "failed to listen on " << path << " : " << std::strerror(err)
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "running on " << d.get_info<sycl::info::device::name>()
+            << std::endl
+            << "listening on " << path << std::endl;
+
+  while (server.poll_once(-1))
+    ;
+
+  return EXIT_SUCCESS;
+}
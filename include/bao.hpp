@@ -0,0 +1,122 @@
+#pragma once
+#include "blake3.hpp"
+
+namespace blake3 {
+
+// Just to avoid kernel name mangling in optimization report
+class kernelBlake3VerifySlices;
+
+// Verifies a batch of Bao slices against BLAKE3 digest ( read root chaining
+// value ) of whole input, which has `chunk_count` -many chunks ( power of 2 )
+//
+// Each slice carries one 1024 -bytes chunk ( sitting at index `chunk_idxs[i]`
+// of whole input ) and bin_log(chunk_count) -many 32 -bytes sibling chaining
+// values, which are ordered from root to leaf i.e. in same order as Bao slice
+// encoding emits them
+//
+// Note, this is not Bao's wire format: Bao slice of a streamed range may span
+// several chunks, interleaves parent nodes ( in pre-order ) with chunk data and
+// may end with a partial chunk. Callers need to split such range into one
+// slice per full chunk, extracting each chunk's sibling chaining values, before
+// verifying here; partial final chunk isn't supported, because whole input
+// must have power of 2 -many full chunks
+//
+// Memory layout of device allocations
+//
+// - root       : 32 -bytes expected BLAKE3 digest
+// - chunks     : slice_cnt x 1024 -bytes chunk data
+// - siblings   : slice_cnt x bin_log(chunk_count) x 32 -bytes chaining values
+// - chunk_idxs : slice_cnt -many chunk indices
+// - ok         : slice_cnt -many bytes, 1 if slice verified, else 0
+//
+// Chunk chaining value is recomputed and folded with sibling chaining values,
+// all the way up to root ( see `compress_chunk`, `compress_parent` ), which is
+// compared against expected digest
+void
+verify_slices(sycl::queue& q,                         // SYCL compute queue
+              sycl::uchar* const __restrict root,     // 32 -bytes digest
+              sycl::uchar* const __restrict chunks,   // never modified !
+              sycl::uchar* const __restrict siblings, // never modified !
+              size_t* const __restrict chunk_idxs,
+              const size_t slice_cnt,
+              const size_t chunk_count, // works only with power of 2
+              sycl::uchar* const __restrict ok,
+              sycl::cl_ulong* const __restrict ts // kernel exec time in `ns`
+)
+{
+  assert(chunk_count > 0);
+  assert((chunk_count & (chunk_count - 1)) == 0); // ensure power of 2
+
+  const size_t levels = bin_log(chunk_count);
+
+  sycl::event evt = q.single_task<kernelBlake3VerifySlices>(
+    [=]() [[intel::kernel_args_restrict]] {
+      // Just to hint that Load Store Units don't need to interface with host
+      sycl::device_ptr<sycl::uchar> r_ptr{ root };
+      sycl::device_ptr<sycl::uchar> c_ptr{ chunks };
+      sycl::device_ptr<sycl::uchar> s_ptr{ siblings };
+      sycl::device_ptr<size_t> idx_ptr{ chunk_idxs };
+      sycl::device_ptr<sycl::uchar> ok_ptr{ ok };
+
+      [[intel::fpga_register]] uint32_t msg[16];
+      [[intel::fpga_register]] uint32_t state[16];
+      [[intel::fpga_register]] uint32_t expected[8];
+
+      sycl::private_ptr<uint32_t> msg_ptr{ msg };
+      sycl::private_ptr<uint32_t> state_ptr{ state };
+
+#pragma unroll 8
+      for (size_t i = 0; i < 8; i++) {
+        expected[i] = word_from_le_bytes(r_ptr + (i << 2));
+      }
+
+      for (size_t s = 0; s < slice_cnt; s++) {
+        const size_t chunk_idx = idx_ptr[s];
+        const size_t s_offset = s * levels * OUT_LEN;
+
+        // leaf node of BLAKE3 binary merkle tree, note when whole input is just
+        // one chunk, it's root too
+        compress_chunk(state_ptr,
+                       msg_ptr,
+                       c_ptr + (s << 10),
+                       chunk_idx,
+                       levels == 0 ? ROOT : 0);
+
+        // fold sibling chaining values, starting from leaf level, which is last
+        // sibling carried by slice
+        for (size_t l = 0; l < levels; l++) {
+          const size_t depth = levels - 1 - l;
+          const size_t sib_offset = s_offset + depth * OUT_LEN;
+
+          // whether current node is right child of its parent
+          const bool is_right = (chunk_idx >> l) & 1ul;
+
+#pragma unroll 8
+          for (size_t i = 0; i < 8; i++) {
+            const uint32_t sib =
+              word_from_le_bytes(s_ptr + sib_offset + (i << 2));
+
+            msg_ptr[i] = is_right ? sib : state_ptr[i];
+            msg_ptr[8 + i] = is_right ? state_ptr[i] : sib;
+          }
+
+          compress_parent(state_ptr, msg_ptr, depth == 0 ? ROOT : 0);
+        }
+
+        bool matched = true;
+#pragma unroll 8
+        for (size_t i = 0; i < 8; i++) {
+          matched &= state_ptr[i] == expected[i];
+        }
+
+        ok_ptr[s] = matched ? 1 : 0;
+      }
+    });
+
+  evt.wait();
+
+  if (ts != nullptr) {
+    *ts = time_event(evt);
+  }
+}
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include "blake3.hpp"
+#include <algorithm>
+
+namespace blake3 {
+
+// Just to avoid kernel name mangling in optimization report
+class kernelBlake3ChunkCVs;
+
+// Minimum number of groups ( of four chunks ) compressed in one round of
+// `chunk_cvs` kernel, so that output chaining value of j-th message block of a
+// chunk is written back to global memory, at least these many loop iterations
+// before it's read back as input chaining value of (j + 1)-th message block,
+// see board.hpp
+constexpr size_t CV_SPILL_DISTANCE = BOARD.spill_distance;
+
+// Enqueues BLAKE3 kernel, which computes chaining values of `chunk_cnt` -many
+// full chunks, where i-th chunk is compressed using chunk counter
+// `counters[i]`, without waiting for its completion
+//
+// When `indexed` is false, chunks live consecutively in `chunks` and `offsets`
+// is never read. Otherwise i-th chunk starts at byte `offsets[i]` of `chunks`
+// ( not necessarily 1024 -bytes aligned ), so that chunks can be picked out of
+// a larger staging buffer
+//
+// Chunks may belong to different inputs ( say different streams ) and they are
+// not merged into any tree here, so i-th 32 -bytes chaining value written to
+// `cvs` is simply leaf node, to be merged by caller
+//
+// Message blocks are scheduled same way as `hash( ... )` does i.e. j-th
+// message blocks of four consecutive chunks are compressed in one iteration,
+// while output chaining values are spilled in `cvs`. When there are fewer than
+// `CV_SPILL_DISTANCE` groups of four chunks, idle iterations are inserted, so
+// that spilled chaining value is always written before it's read back
+template<typename KernelName, bool indexed>
+sycl::event
+submit_chunk_cvs(sycl::queue& q,                       // SYCL compute queue
+                 sycl::uchar* const __restrict chunks, // never modified !
+                 size_t* const __restrict offsets,     // only read when indexed
+                 uint64_t* const __restrict counters,  // chunk_cnt -many
+                 const size_t chunk_cnt,               // number of chunks
+                 uint32_t* const __restrict cvs        // chunk_cnt x 32 -bytes
+)
+{
+  return q.single_task<KernelName>(
+    [=]() [[intel::kernel_args_restrict]] {
+      // Just to hint that Load Store Units don't need to interface with host
+      sycl::device_ptr<sycl::uchar> i_ptr{ chunks };
+      sycl::device_ptr<size_t> off_ptr{ offsets };
+      sycl::device_ptr<uint64_t> cnt_ptr{ counters };
+      sycl::device_ptr<uint32_t> o_ptr{ cvs };
+
+      [[intel::fpga_register]] uint32_t msg[4][16];
+      [[intel::fpga_register]] uint32_t state[4][16];
+
+      const size_t grp_cnt =
+        std::max<size_t>((chunk_cnt + 3) >> 2, CV_SPILL_DISTANCE);
+      const size_t itr_cnt = grp_cnt << 4;
+
+      size_t grp_idx = 0;
+      size_t msg_blk_idx = 0;
+
+      [[intel::ivdep(CV_SPILL_DISTANCE)]] for (size_t c = 0; c < itr_cnt; c++)
+      {
+#pragma unroll 4
+        for (size_t l = 0; l < 4; l++) {
+          const size_t idx = (grp_idx << 2) + l;
+
+          // idle lane, either padding of last group or an idle group
+          if (idx < chunk_cnt) {
+            sycl::private_ptr<uint32_t> state_ptr{ state[l] };
+            sycl::private_ptr<uint32_t> msg_ptr{ msg[l] };
+
+            const uint64_t counter = cnt_ptr[idx];
+            const size_t start = indexed ? off_ptr[idx] : idx << 10;
+            const size_t i_offset = start + (msg_blk_idx << 6);
+            const size_t o_offset = idx << 3;
+
+#pragma unroll 8
+            for (size_t i = 0; i < 8; i++) {
+              state_ptr[i] = msg_blk_idx == 0 ? IV[i] : o_ptr[o_offset + i];
+            }
+#pragma unroll 4
+            for (size_t i = 0; i < 4; i++) {
+              state_ptr[8 + i] = IV[i];
+            }
+
+            state_ptr[12] = static_cast<uint32_t>(counter & 0xffffffff);
+            state_ptr[13] = static_cast<uint32_t>(counter >> 32);
+            state_ptr[14] = BLOCK_LEN;
+            state_ptr[15] = (msg_blk_idx == 0 ? CHUNK_START : 0) |
+                            (msg_blk_idx == 15 ? CHUNK_END : 0);
+
+#pragma unroll 16
+            for (size_t i = 0; i < 16; i++) {
+              msg_ptr[i] = word_from_le_bytes(i_ptr + i_offset + (i << 2));
+            }
+
+            compress(state_ptr, msg_ptr);
+
+#pragma unroll 8
+            for (size_t i = 0; i < 8; i++) {
+              o_ptr[o_offset + i] = state_ptr[i];
+            }
+          }
+        }
+
+        // point to next group/ message block
+        if ((grp_idx + 1) == grp_cnt) {
+          grp_idx = 0;
+          msg_blk_idx++;
+        } else {
+          grp_idx++;
+        }
+      }
+    });
+}
+
+// Computes chaining values of `chunk_cnt` -many full chunks, using per chunk
+// counters, see `submit_chunk_cvs`
+void
+chunk_cvs(sycl::queue& q,                       // SYCL compute queue
+          sycl::uchar* const __restrict chunks, // chunk_cnt x 1024 -bytes
+          uint64_t* const __restrict counters,  // chunk_cnt -many
+          const size_t chunk_cnt,               // number of chunks
+          uint32_t* const __restrict cvs,       // chunk_cnt x 32 -bytes
+          sycl::cl_ulong* const __restrict ts   // kernel exec time in `ns`
+)
+{
+  sycl::event evt = submit_chunk_cvs<kernelBlake3ChunkCVs, false>(
+    q, chunks, nullptr, counters, chunk_cnt, cvs);
+  evt.wait();
+
+  if (ts != nullptr) {
+    *ts = time_event(evt);
+  }
+}
+}
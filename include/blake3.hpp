@@ -1,4 +1,5 @@
 #pragma once
+#include "board.hpp"
 #include "common.hpp"
 #include <cassert>
 #include <sycl/ext/intel/fpga_extensions.hpp>
@@ -29,6 +30,9 @@ constexpr uint32_t CHUNK_START = 1 << 0;
 constexpr uint32_t CHUNK_END = 1 << 1;
 constexpr uint32_t PARENT = 1 << 2;
 constexpr uint32_t ROOT = 1 << 3;
+constexpr uint32_t KEYED_HASH = 1 << 4;
+constexpr uint32_t DERIVE_KEY_CONTEXT = 1 << 5;
+constexpr uint32_t DERIVE_KEY_MATERIAL = 1 << 6;
 
 // Binary logarithm of n, when n = 2 ^ i | i = {1, 2, 3, ...}
 const size_t
@@ -215,43 +219,227 @@ words_to_le_bytes(const sycl::private_ptr<uint32_t> msg_words,
   }
 }
 
-// BLAKE3 hash function, can be used when chunk count is power of 2
+// Compresses all sixteen message blocks of one 1024 -bytes chunk, sitting at
+// index `chunk_idx` of whole input, sequentially; resulting 32 -bytes output
+// chaining value lives in first eight words of hash state
 //
-// Note, chunk count is preferred to be relatively large number ( say >= 2^10 )
-// because this function is supposed to be executed on accelerator i.e. FPGA
+// `flags` are additionally set when compressing last message block of chunk (
+// say ROOT, when whole input is just one chunk ), otherwise pass 0
 //
-// See
-// https://github.com/itzmeanjan/blake3/blob/f07d32ec10cbc8a10663b7e6539e0b1dab3e453b/include/blake3.hpp#L1876-L2006
-void
-hash(sycl::queue& q,                       // SYCL compute queue
-     sycl::uchar* const __restrict input,  // it'll never be modified !
-     const size_t i_size,                  // bytes
-     const size_t chunk_count,             // works only with power of 2
-     sycl::uchar* const __restrict digest, // 32 -bytes BLAKE3 digest
-     sycl::cl_ulong* const __restrict ts   // kernel exec time in `ns`
-)
+// Callable both from host and device code
+inline void
+compress_chunk(sycl::private_ptr<uint32_t> state,
+               sycl::private_ptr<uint32_t> msg,
+               const sycl::device_ptr<sycl::uchar> chunk,
+               const size_t chunk_idx,
+               const uint32_t flags)
 {
-  // whole input byte array is splitted into N -many chunks, each
-  // of 1024 -bytes width
-  assert(i_size == chunk_count * CHUNK_LEN);
-  // minimum 1MB input size for this implementation
-  assert(chunk_count >= (1 << 10)); // but you would probably want >= 2^20
-  assert((chunk_count & (chunk_count - 1)) == 0); // ensure power of 2
+  for (size_t j = 0; j < 16; j++) {
+    // input chaining value of first message block is constant initial hash
+    // values, for all remaining blocks it's previous block's output chaining
+    // value, which is already living in first eight words of hash state
+    if (j == 0) {
+#pragma unroll 8
+      for (size_t i = 0; i < 8; i++) {
+        state[i] = IV[i];
+      }
+    }
 
-  // temporary memory allocation on global memory for keeping all intermediate
-  // chaining values
+#pragma unroll 4
+    for (size_t i = 0; i < 4; i++) {
+      state[8 + i] = IV[i];
+    }
+
+    state[12] = static_cast<uint32_t>(chunk_idx & 0xffffffff);
+    state[13] = static_cast<uint32_t>(chunk_idx >> 32);
+    state[14] = BLOCK_LEN;
+    state[15] = (j == 0 ? CHUNK_START : 0) | (j == 15 ? CHUNK_END | flags : 0);
+
+#pragma unroll 16
+    for (size_t i = 0; i < 16; i++) {
+      msg[i] = word_from_le_bytes(chunk + (j << 6) + (i << 2));
+    }
+
+    compress(state, msg);
+  }
+}
+
+// Compresses two children chaining values ( already placed in sixteen message
+// words, left child first ) into parent chaining value, which lives in first
+// eight words of hash state
+//
+// `flags` are additionally set along with PARENT ( say ROOT, when computing
+// BLAKE3 digest ), otherwise pass 0
+//
+// Callable both from host and device code
+inline void
+compress_parent(sycl::private_ptr<uint32_t> state,
+                sycl::private_ptr<uint32_t> msg,
+                const uint32_t flags)
+{
+#pragma unroll 8
+  for (size_t i = 0; i < 8; i++) {
+    state[i] = IV[i];
+  }
+#pragma unroll 4
+  for (size_t i = 0; i < 4; i++) {
+    state[8 + i] = IV[i];
+  }
+
+  state[12] = 0;
+  state[13] = 0;
+  state[14] = BLOCK_LEN;
+  state[15] = PARENT | flags;
+
+  compress(state, msg);
+}
+
+// Computes all intermediate parent chaining values and finally root chaining
+// value ( BLAKE3 digest ) of binary merkle tree, whose `chunk_count` -many leaf
+// chaining values are already placed in second half of `mem` ( see
+// `submit_hash` ), writing 32 -bytes little endian digest to `o_ptr`
+inline void
+merkelize(sycl::device_ptr<uint32_t> mem_ptr,
+          sycl::device_ptr<sycl::uchar> o_ptr,
+          const size_t chunk_count)
+{
+  [[intel::fpga_register]] uint32_t msg_0[16];
+  [[intel::fpga_register]] uint32_t state_0[16];
+  [[intel::fpga_register]] uint32_t msg_1[16];
+  [[intel::fpga_register]] uint32_t state_1[16];
+
+  sycl::private_ptr<uint32_t> state_0_ptr{ state_0 };
+  sycl::private_ptr<uint32_t> msg_0_ptr{ msg_0 };
+  sycl::private_ptr<uint32_t> state_1_ptr{ state_1 };
+  sycl::private_ptr<uint32_t> msg_1_ptr{ msg_1 };
+
+  // --- parent chaining value computation using binary merklization ---
   //
-  // note, chaining values are organized as nodes are kept in fully computed (
-  // all intermediate nodes, along with leaves ) binary merkle tree
+  // except root ( chaining values ) of BLAKE3 merkle tree, all intermediate
+  // parent chaining values are to be computed in data-dependent `levels`
+  // -many rounds
+  const size_t levels = bin_log(chunk_count) - 1;
+
+  // level (i + 1) consumes level i as input ( where leaf nodes are already
+  // computed by chunk compression section of calling kernel )
+  for (size_t l = 0; l < levels; l++) {
+    const size_t i_offset = (chunk_count << 3) >> l;
+    const size_t o_offset = i_offset >> 1;
+    const size_t node_cnt = chunk_count >> (l + 1);
+
+    // these many intermediate chaining values are to be computed in this
+    // level of BLAKE3 binary merkle tree
+    [[intel::ivdep]] for (size_t i = 0; i < node_cnt; i += 2)
+    {
+      const size_t i_offset_0 = i_offset + (i << 4);
+      const size_t i_offset_1 = i_offset + ((i + 1) << 4);
+      const size_t o_offset_0 = o_offset + (i << 3);
+      const size_t o_offset_1 = o_offset + ((i + 1) << 3);
+
+    // read 64 -bytes message words from global memory
+#pragma unroll 16
+      for (size_t j = 0; j < 16; j++) {
+        msg_0_ptr[j] = mem_ptr[i_offset_0 + j];
+      }
+#pragma unroll 16
+      for (size_t j = 0; j < 16; j++) {
+        msg_1_ptr[j] = mem_ptr[i_offset_1 + j];
+      }
+
+    // input chaining values being placed in first 8 words of hash state
+#pragma unroll 8
+      for (size_t i = 0; i < 8; i++) {
+        state_0_ptr[i] = IV[i];
+        state_1_ptr[i] = IV[i];
+      }
+#pragma unroll 4
+      for (size_t i = 0; i < 4; i++) {
+        state_0_ptr[8 + i] = IV[i];
+        state_1_ptr[8 + i] = IV[i];
+      }
+
+      state_0_ptr[12] = 0;
+      state_0_ptr[13] = 0;
+      state_0_ptr[14] = BLOCK_LEN;
+      state_0_ptr[15] = PARENT;
+
+      state_1_ptr[12] = 0;
+      state_1_ptr[13] = 0;
+      state_1_ptr[14] = BLOCK_LEN;
+      state_1_ptr[15] = PARENT;
+
+      // compressing two message blocks, living next to each other
+      compress(state_0_ptr, msg_0_ptr);
+      compress(state_1_ptr, msg_1_ptr);
+
+    // producing parent chaining values
+#pragma unroll 8
+      for (size_t j = 0; j < 8; j++) {
+        mem_ptr[o_offset_0 + j] = state_0_ptr[j];
+        mem_ptr[o_offset_1 + j] = state_1_ptr[j];
+      }
+    }
+  }
   //
-  // @todo this allocation size can be improved !
-  const size_t mem_size = (chunk_count * OUT_LEN) << 1;
-  uint32_t* mem = static_cast<uint32_t*>(sycl::malloc_device(mem_size, q));
+  // --- parent chaining value computation using binary merklization ---
+
+  // --- computing root chaining values ( BLAKE3 digest ) ---
+#pragma unroll 16
+  for (size_t j = 0; j < 16; j++) {
+    msg_0_ptr[j] = mem_ptr[16 + j];
+  }
 
-  sycl::event evt =
-    q.single_task<kernelBlake3Hash>([=]() [[intel::kernel_args_restrict]] {
+#pragma unroll 8
+  for (size_t i = 0; i < 8; i++) {
+    state_0_ptr[i] = IV[i];
+  }
+#pragma unroll 4
+  for (size_t i = 0; i < 4; i++) {
+    state_0_ptr[8 + i] = IV[i];
+  }
+
+  state_0_ptr[12] = 0;
+  state_0_ptr[13] = 0;
+  state_0_ptr[14] = BLOCK_LEN;
+  state_0_ptr[15] = PARENT | ROOT;
+
+  compress(state_0_ptr, msg_0_ptr);
+  // --- computing root chaining values ( BLAKE3 digest ) ---
+
+  // writing little endian digest bytes back to desired memory allocation
+  words_to_le_bytes(state_0_ptr, o_ptr);
+}
+
+// Marks chunk which is a hole ( i.e. all zero bytes ) in `chunk_map` of
+// sparse input, such chunk's message blocks are never read from global memory
+constexpr size_t CHUNK_HOLE = SIZE_MAX;
+
+// Enqueues BLAKE3 kernel, which computes digest of `chunk_count` -many chunks
+// ( power of 2 ), without waiting for its completion
+//
+// When `sparse` is false, all chunks live consecutively in `input` and
+// `chunk_map` is never read. Otherwise `chunk_map[i]` denotes slot of `input`
+// ( each slot 1024 -bytes wide ) where i-th chunk lives, or it's `CHUNK_HOLE`,
+// in which case all zero message blocks are synthesized on-chip, while still
+// using correct chunk counter
+//
+// `mem` must be able to hold ( chunk_count * 64 ) -bytes of intermediate
+// chaining values
+template<typename KernelName, bool sparse>
+sycl::event
+submit_hash(sycl::queue& q,                      // SYCL compute queue
+            sycl::uchar* const __restrict input, // it'll never be modified !
+            size_t* const __restrict chunk_map,  // only read when sparse
+            const size_t chunk_count,            // works only with power of 2
+            uint32_t* const __restrict mem,      // intermediate CVs
+            sycl::uchar* const __restrict digest // 32 -bytes BLAKE3 digest
+)
+{
+  return q.single_task<KernelName>(
+    [=]() [[intel::kernel_args_restrict]] {
       // Just to hint that Load Store Units don't need to interface with host
       sycl::device_ptr<sycl::uchar> i_ptr{ input };
+      sycl::device_ptr<size_t> map_ptr{ chunk_map };
       sycl::device_ptr<uint32_t> mem_ptr{ mem };
       sycl::device_ptr<sycl::uchar> o_ptr{ digest };
 
@@ -322,10 +510,16 @@ hash(sycl::queue& q,                       // SYCL compute queue
       // in 16 consecutive rounds
       [[intel::ivdep]] for (size_t c = 0; c < msg_blk_cnt; c += 4)
       {
-        const size_t i_offset_0 = (chunk_idx << 10) + (msg_blk_idx << 4);
-        const size_t i_offset_1 = ((chunk_idx + 1) << 10) + (msg_blk_idx << 4);
-        const size_t i_offset_2 = ((chunk_idx + 2) << 10) + (msg_blk_idx << 4);
-        const size_t i_offset_3 = ((chunk_idx + 3) << 10) + (msg_blk_idx << 4);
+        // slots of input where four consecutive chunks live
+        const size_t slot_0 = sparse ? map_ptr[chunk_idx] : chunk_idx;
+        const size_t slot_1 = sparse ? map_ptr[chunk_idx + 1] : chunk_idx + 1;
+        const size_t slot_2 = sparse ? map_ptr[chunk_idx + 2] : chunk_idx + 2;
+        const size_t slot_3 = sparse ? map_ptr[chunk_idx + 3] : chunk_idx + 3;
+
+        const size_t i_offset_0 = (slot_0 << 10) + (msg_blk_idx << 6);
+        const size_t i_offset_1 = (slot_1 << 10) + (msg_blk_idx << 6);
+        const size_t i_offset_2 = (slot_2 << 10) + (msg_blk_idx << 6);
+        const size_t i_offset_3 = (slot_3 << 10) + (msg_blk_idx << 6);
         const size_t o_offset_0 = o_offset + (chunk_idx << 3);
         const size_t o_offset_1 = o_offset + ((chunk_idx + 1) << 3);
         const size_t o_offset_2 = o_offset + ((chunk_idx + 2) << 3);
@@ -400,23 +594,33 @@ hash(sycl::queue& q,                       // SYCL compute queue
           state_3_ptr[15] = 0;
         }
 
+        // when sparse, chunks which are holes don't touch global memory
+        const bool hole_0 = sparse && slot_0 == CHUNK_HOLE;
+        const bool hole_1 = sparse && slot_1 == CHUNK_HOLE;
+        const bool hole_2 = sparse && slot_2 == CHUNK_HOLE;
+        const bool hole_3 = sparse && slot_3 == CHUNK_HOLE;
+
       // 64 -bytes message block read from global memory ( expensive, but
       // nothing much to do to avoid this ! )
 #pragma unroll 16
         for (size_t i = 0; i < 16; i++) {
-          msg_0_ptr[i] = word_from_le_bytes(i_ptr + i_offset_0 + (i << 2));
+          msg_0_ptr[i] =
+            hole_0 ? 0 : word_from_le_bytes(i_ptr + i_offset_0 + (i << 2));
         }
 #pragma unroll 16
         for (size_t i = 0; i < 16; i++) {
-          msg_1_ptr[i] = word_from_le_bytes(i_ptr + i_offset_1 + (i << 2));
+          msg_1_ptr[i] =
+            hole_1 ? 0 : word_from_le_bytes(i_ptr + i_offset_1 + (i << 2));
         }
 #pragma unroll 16
         for (size_t i = 0; i < 16; i++) {
-          msg_2_ptr[i] = word_from_le_bytes(i_ptr + i_offset_2 + (i << 2));
+          msg_2_ptr[i] =
+            hole_2 ? 0 : word_from_le_bytes(i_ptr + i_offset_2 + (i << 2));
         }
 #pragma unroll 16
         for (size_t i = 0; i < 16; i++) {
-          msg_3_ptr[i] = word_from_le_bytes(i_ptr + i_offset_3 + (i << 2));
+          msg_3_ptr[i] =
+            hole_3 ? 0 : word_from_le_bytes(i_ptr + i_offset_3 + (i << 2));
         }
 
         // compress four message block(s) from four consecutive chunks
@@ -446,108 +650,79 @@ hash(sycl::queue& q,                       // SYCL compute queue
       //
       // --- chunk compression ---
 
-      // --- parent chaining value computation using binary merklization ---
-      //
-      // except root ( chaining values ) of BLAKE3 merkle tree, all intermediate
-      // parent chaining values are to be computed in data-dependent `levels`
-      // -many rounds
-      const size_t levels = bin_log(chunk_count) - 1;
-
-      // level (i + 1) consumes level i as input ( where leaf nodes are already
-      // computed, see above chunk compression section )
-      for (size_t l = 0; l < levels; l++) {
-        const size_t i_offset = (chunk_count << 3) >> l;
-        const size_t o_offset = i_offset >> 1;
-        const size_t node_cnt = chunk_count >> (l + 1);
-
-        // these many intermediate chaining values are to be computed in this
-        // level of BLAKE3 binary merkle tree
-        [[intel::ivdep]] for (size_t i = 0; i < node_cnt; i += 2)
-        {
-          const size_t i_offset_0 = i_offset + (i << 4);
-          const size_t i_offset_1 = i_offset + ((i + 1) << 4);
-          const size_t o_offset_0 = o_offset + (i << 3);
-          const size_t o_offset_1 = o_offset + ((i + 1) << 3);
-
-        // read 64 -bytes message words from global memory
-#pragma unroll 16
-          for (size_t j = 0; j < 16; j++) {
-            msg_0_ptr[j] = mem_ptr[i_offset_0 + j];
-          }
-#pragma unroll 16
-          for (size_t j = 0; j < 16; j++) {
-            msg_1_ptr[j] = mem_ptr[i_offset_1 + j];
-          }
-
-        // input chaining values being placed in first 8 words of hash state
-#pragma unroll 8
-          for (size_t i = 0; i < 8; i++) {
-            state_0_ptr[i] = IV[i];
-            state_1_ptr[i] = IV[i];
-          }
-#pragma unroll 4
-          for (size_t i = 0; i < 4; i++) {
-            state_0_ptr[8 + i] = IV[i];
-            state_1_ptr[8 + i] = IV[i];
-          }
-
-          state_0_ptr[12] = 0;
-          state_0_ptr[13] = 0;
-          state_0_ptr[14] = BLOCK_LEN;
-          state_0_ptr[15] = PARENT;
-
-          state_1_ptr[12] = 0;
-          state_1_ptr[13] = 0;
-          state_1_ptr[14] = BLOCK_LEN;
-          state_1_ptr[15] = PARENT;
-
-          // compressing two message blocks, living next to each other
-          compress(state_0_ptr, msg_0_ptr);
-          compress(state_1_ptr, msg_1_ptr);
-
-        // producing parent chaining values
-#pragma unroll 8
-          for (size_t j = 0; j < 8; j++) {
-            mem_ptr[o_offset_0 + j] = state_0_ptr[j];
-            mem_ptr[o_offset_1 + j] = state_1_ptr[j];
-          }
-        }
-      }
-    //
-    // --- parent chaining value computation using binary merklization ---
-
-    // --- computing root chaining values ( BLAKE3 digest ) ---
-#pragma unroll 16
-      for (size_t j = 0; j < 16; j++) {
-        msg_0_ptr[j] = mem_ptr[16 + j];
-      }
-
-#pragma unroll 8
-      for (size_t i = 0; i < 8; i++) {
-        state_0_ptr[i] = IV[i];
-      }
-#pragma unroll 4
-      for (size_t i = 0; i < 4; i++) {
-        state_0_ptr[8 + i] = IV[i];
-      }
+      // parent chaining values, finally root chaining value
+      merkelize(mem_ptr, o_ptr, chunk_count);
+    });
+}
 
-      state_0_ptr[12] = 0;
-      state_0_ptr[13] = 0;
-      state_0_ptr[14] = BLOCK_LEN;
-      state_0_ptr[15] = PARENT | ROOT;
+// BLAKE3 hash function, can be used when chunk count is power of 2
+//
+// Note, chunk count is preferred to be relatively large number ( say >= 2^10 )
+// because this function is supposed to be executed on accelerator i.e. FPGA
+//
+// See
+// https://github.com/itzmeanjan/blake3/blob/f07d32ec10cbc8a10663b7e6539e0b1dab3e453b/include/blake3.hpp#L1876-L2006
+//
+// Host thread waits for kernel completion using `ws`, while host cost of
+// waiting is written to `stats` ( if not nullptr ), see `wait_event`
+void
+hash(sycl::queue& q,                        // SYCL compute queue
+     sycl::uchar* const __restrict input,   // it'll never be modified !
+     const size_t i_size,                   // bytes
+     const size_t chunk_count,              // works only with power of 2
+     sycl::uchar* const __restrict digest,  // 32 -bytes BLAKE3 digest
+     sycl::cl_ulong* const __restrict ts,   // kernel exec time in `ns`
+     const wait_strategy ws,                // how host waits for kernel
+     wait_stats_t* const __restrict stats   // host cost of waiting
+)
+{
+  // whole input byte array is splitted into N -many chunks, each
+  // of 1024 -bytes width
+  assert(i_size == chunk_count * CHUNK_LEN);
+  // minimum 1MB input size for this implementation
+  assert(chunk_count >= (1 << 10)); // but you would probably want >= 2^20
+  assert((chunk_count & (chunk_count - 1)) == 0); // ensure power of 2
 
-      compress(state_0_ptr, msg_0_ptr);
-      // --- computing root chaining values ( BLAKE3 digest ) ---
+  // temporary memory allocation on global memory for keeping all intermediate
+  // chaining values
+  //
+  // note, chaining values are organized as nodes are kept in fully computed (
+  // all intermediate nodes, along with leaves ) binary merkle tree
+  //
+  // @todo this allocation size can be improved !
+  const size_t mem_size = (chunk_count * OUT_LEN) << 1;
+  uint32_t* mem = static_cast<uint32_t*>(sycl::malloc_device(mem_size, q));
 
-      // writing little endian digest bytes back to desired memory allocation
-      words_to_le_bytes(state_0_ptr, o_ptr);
-    });
+  const uint64_t submitted_at = host_now_ns();
+  sycl::event evt = submit_hash<kernelBlake3Hash, false>(
+    q, input, nullptr, chunk_count, mem, digest);
 
-  evt.wait();
+  wait_event(evt, ws, submitted_at, stats);
   sycl::free(mem, q);
 
   if (ts != nullptr) {
     *ts = time_event(evt);
   }
 }
+
+// BLAKE3 hash function, same as above, where host thread blocks until kernel
+// completes
+void
+hash(sycl::queue& q,                       // SYCL compute queue
+     sycl::uchar* const __restrict input,  // it'll never be modified !
+     const size_t i_size,                  // bytes
+     const size_t chunk_count,             // works only with power of 2
+     sycl::uchar* const __restrict digest, // 32 -bytes BLAKE3 digest
+     sycl::cl_ulong* const __restrict ts   // kernel exec time in `ns`
+)
+{
+  hash(q,
+       input,
+       i_size,
+       chunk_count,
+       digest,
+       ts,
+       wait_strategy::blocking,
+       nullptr);
+}
 }
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+
+// Per board tuning knobs, so that one source tree generates tuned h/w images
+// for every FPGA card generation; board is chosen at compile time, by defining
+// one of `FPGA_BOARD_A10`, `FPGA_BOARD_S10` or `FPGA_BOARD_AGILEX` ( see
+// Makefile ), Arria 10 PAC being default
+//
+// Note, this file is host and device agnostic, it doesn't depend on SYCL
+namespace blake3 {
+
+// Tuning knobs of one board, which become defaults of kernels' compile time
+// parameters ( say number of compress engines ), so that kernels written
+// against default template arguments pick them up
+struct board_profile_t
+{
+  const char* name;
+
+  // compute
+  size_t iter_lanes;  // iterative compress cores, see `hash_iterative`
+  size_t pool_lanes;  // compress engines of shared pool, see `hash_pooled`
+  size_t stage_depth; // message block prefetch distance, see `hash_staged`
+
+  // pipelining, where higher fmax boards have longer global memory round trip
+  // ( in cycles ), so spilled chaining values are read back later
+  size_t spill_distance;  // loop iterations, see `CV_SPILL_DISTANCE`
+  size_t leaf_pipe_depth; // chaining values, see `LEAF_PIPE_DEPTH`
+};
+
+// Note, fmax target ( `-Xsclock` ) lives only in Makefile, as it's a compiler
+// flag, not a kernel parameter. Global memory layout isn't part of profile
+// either, buffers aren't mapped to DDR banks ( no `buffer_location` ), so they
+// are burst interleaved across all banks by BSP
+
+// Intel PAC with Arria 10 GX, 2 x DDR4 banks
+constexpr board_profile_t A10_PROFILE{ "pac_a10", 16, 4, 8, 64, 64 };
+
+// Intel PAC D5005 with Stratix 10 SX, 4 x DDR4 banks; HyperFlex registers
+// close timing at roughly twice Arria 10 fmax, for more area, so engine counts
+// and pipelining distances are doubled
+constexpr board_profile_t S10_PROFILE{ "pac_s10", 32, 8, 16, 128, 128 };
+
+// Agilex 7 F-series cards ( say DE10-Agilex ), 4 x DDR4 banks; same fmax target
+// as Stratix 10, with room for twice as many iterative cores
+constexpr board_profile_t AGILEX_PROFILE{ "agilex", 64, 8, 16, 128, 128 };
+
+#if defined FPGA_BOARD_S10
+constexpr board_profile_t BOARD = S10_PROFILE;
+#elif defined FPGA_BOARD_AGILEX
+constexpr board_profile_t BOARD = AGILEX_PROFILE;
+#else
+constexpr board_profile_t BOARD = A10_PROFILE;
+#endif
+
+// Compile time check of board profile, to ensure that lane counts and
+// pipelining distances are powers of 2, so that they can be used as defaults
+// of kernels, which require so
+static constexpr bool
+is_valid_board_profile(const board_profile_t& p)
+{
+  auto pow2 = [](const size_t n) { return n > 0 && (n & (n - 1)) == 0; };
+
+  return pow2(p.iter_lanes) && pow2(p.pool_lanes) && pow2(p.stage_depth) &&
+         pow2(p.spill_distance) && pow2(p.leaf_pipe_depth);
+}
+
+static_assert(is_valid_board_profile(BOARD));
+}
@@ -0,0 +1,298 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// Persistent cache of BLAKE3 digests of files, so that repeated scans of same
+// datasets cost a `stat` per unchanged file, instead of reading and hashing it
+//
+// Note, this file is host only, it doesn't depend on SYCL
+namespace blake3 {
+
+// Identifies on-disk cache file and its layout version
+constexpr uint64_t CACHE_MAGIC = 0x31'43'44'33'42'00'00'00ul;
+
+// Initial number of slots of cache table, it's doubled when half full
+constexpr uint64_t CACHE_MIN_SLOTS = 1 << 10;
+
+// Files modified ( or whose inode changed ) less than these many nanoseconds
+// before they were hashed, aren't cached, because same second modification
+// may not be visible in timestamps of coarse grained file systems
+constexpr int64_t CACHE_RACY_NS = 1'000'000'000;
+
+// Identity of file content, as far as file system tells; digest is reused only
+// when all of these match
+struct cache_key_t
+{
+  uint64_t dev;
+  uint64_t ino;
+  uint64_t size;     // bytes
+  int64_t mtime_ns;  // last modification
+  int64_t ctime_ns;  // last inode change ( say rename, chmod, truncate )
+};
+
+// Builds cache key from `stat` of file
+static inline cache_key_t
+cache_key(const struct stat& st)
+{
+  return { static_cast<uint64_t>(st.st_dev),
+           static_cast<uint64_t>(st.st_ino),
+           static_cast<uint64_t>(st.st_size),
+           st.st_mtim.tv_sec * 1'000'000'000l + st.st_mtim.tv_nsec,
+           st.st_ctim.tv_sec * 1'000'000'000l + st.st_ctim.tv_nsec };
+}
+
+// Fixed size header of cache file
+struct cache_header_t
+{
+  uint64_t magic;
+  uint64_t slots; // power of 2
+  uint64_t count; // occupied slots
+  uint64_t reserved;
+};
+
+// One slot of open addressed ( linear probing ) cache table, which lives right
+// after header, in cache file
+struct cache_entry_t
+{
+  cache_key_t key;
+  uint8_t digest[32];
+  uint64_t used; // 1, when slot is occupied
+};
+
+// Digest cache, living in a memory mapped file, keyed by ( device, inode ) and
+// valid while size, mtime and ctime also match
+//
+// Cache file is locked exclusively while opened, so concurrent scans sharing
+// it are serialized. When file is missing, malformed or of another layout
+// version, it's ( re )initialized as empty cache, it's only a cache
+class digest_cache
+{
+public:
+  digest_cache() = default;
+
+  ~digest_cache() { close(); }
+
+  digest_cache(const digest_cache&) = delete;
+  digest_cache& operator=(const digest_cache&) = delete;
+
+  // Opens ( creating, if needed ) cache file at `path`
+  //
+  // Returns false with `errno` set by failing call
+  bool open(const char* const path)
+  {
+    close();
+
+    fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+      return false;
+    }
+
+    if (flock(fd, LOCK_EX) != 0) {
+      close();
+      return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close();
+      return false;
+    }
+
+    // reusing existing table, when it's well formed
+    if (static_cast<size_t>(st.st_size) >= sizeof(cache_header_t)) {
+      cache_header_t h;
+      if (pread(fd, &h, sizeof(h), 0) == static_cast<ssize_t>(sizeof(h)) &&
+          h.magic == CACHE_MAGIC &&
+          h.slots >= CACHE_MIN_SLOTS && (h.slots & (h.slots - 1)) == 0 &&
+          static_cast<uint64_t>(st.st_size) == file_size(h.slots)) {
+        return map(h.slots, false);
+      }
+    }
+
+    return map(CACHE_MIN_SLOTS, true);
+  }
+
+  // Unmaps and unlocks cache file, all stored entries are already in it
+  void close()
+  {
+    if (header != nullptr) {
+      munmap(header, file_size(header->slots));
+      header = nullptr;
+      entries = nullptr;
+    }
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+
+  // Looks up digest of file, whose `stat` is given, writing it to `digest`
+  //
+  // Returns false, when file isn't cached or it has changed since
+  bool lookup(const struct stat& st, uint8_t* const digest) const
+  {
+    if (header == nullptr) {
+      return false;
+    }
+
+    const cache_key_t key = cache_key(st);
+    const cache_entry_t& e = entries[probe(key)];
+
+    if (e.used == 0 || e.key.size != key.size ||
+        e.key.mtime_ns != key.mtime_ns || e.key.ctime_ns != key.ctime_ns) {
+      return false;
+    }
+
+    std::memcpy(digest, e.digest, sizeof(e.digest));
+    return true;
+  }
+
+  // Stores digest of file, whose `stat` is given ( as taken before hashing ),
+  // replacing stale entry of same file, if any, where `hashed_at_ns` is
+  // `CLOCK_REALTIME` time when hashing started
+  //
+  // Racily modified file ( see `CACHE_RACY_NS` ) isn't stored, in which case
+  // returns false with `errno` set to EAGAIN; otherwise returns false with
+  // `errno` set by failing call, when cache couldn't grow
+  bool store(const struct stat& st,
+             const uint8_t* const digest,
+             const int64_t hashed_at_ns)
+  {
+    if (header == nullptr) {
+      errno = EBADF;
+      return false;
+    }
+
+    const cache_key_t key = cache_key(st);
+
+    if (key.mtime_ns > hashed_at_ns - CACHE_RACY_NS ||
+        key.ctime_ns > hashed_at_ns - CACHE_RACY_NS) {
+      errno = EAGAIN;
+      return false;
+    }
+
+    if ((header->count + 1) << 1 > header->slots && !grow()) {
+      return false;
+    }
+
+    cache_entry_t& e = entries[probe(key)];
+    if (e.used == 0) {
+      header->count++;
+    }
+
+    e.key = key;
+    std::memcpy(e.digest, digest, sizeof(e.digest));
+    e.used = 1;
+
+    return true;
+  }
+
+  // Number of cached files
+  uint64_t size() const { return header == nullptr ? 0 : header->count; }
+
+private:
+  static uint64_t file_size(const uint64_t slots)
+  {
+    return sizeof(cache_header_t) + slots * sizeof(cache_entry_t);
+  }
+
+  // Home slot of file, by mixing its ( device, inode ), see
+  // https://xorshift.di.unimi.it/splitmix64.c
+  static uint64_t home(const cache_key_t& key)
+  {
+    uint64_t z = key.ino ^ (key.dev * 0x9e3779b97f4a7c15ul);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ul;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebul;
+    return z ^ (z >> 31);
+  }
+
+  // Slot holding entry of same ( device, inode ), or first empty slot, where it
+  // can be inserted; table is never full, see `store( ... )`
+  uint64_t probe(const cache_key_t& key) const
+  {
+    const uint64_t mask = header->slots - 1;
+
+    uint64_t i = home(key) & mask;
+    while (entries[i].used != 0 &&
+           (entries[i].key.dev != key.dev || entries[i].key.ino != key.ino)) {
+      i = (i + 1) & mask;
+    }
+
+    return i;
+  }
+
+  // Resizes cache file to hold `slots` -many slots and maps it, while
+  // initializing it as empty table, when `fresh` is set
+  bool map(const uint64_t slots, const bool fresh)
+  {
+    const uint64_t f_size = file_size(slots);
+
+    if (fresh && ftruncate(fd, 0) != 0) {
+      close();
+      return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(f_size)) != 0) {
+      close();
+      return false;
+    }
+
+    void* mapped =
+      mmap(nullptr, f_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+      close();
+      return false;
+    }
+
+    header = static_cast<cache_header_t*>(mapped);
+    entries = reinterpret_cast<cache_entry_t*>(header + 1);
+
+    if (fresh) {
+      header->magic = CACHE_MAGIC;
+      header->slots = slots;
+      header->count = 0;
+    }
+
+    return true;
+  }
+
+  // Doubles number of slots, rehashing all entries
+  bool grow()
+  {
+    const uint64_t slots = header->slots;
+
+    std::vector<cache_entry_t> live;
+    live.reserve(header->count);
+    for (uint64_t i = 0; i < slots; i++) {
+      if (entries[i].used != 0) {
+        live.push_back(entries[i]);
+      }
+    }
+
+    munmap(header, file_size(slots));
+    header = nullptr;
+    entries = nullptr;
+
+    if (!map(slots << 1, true)) {
+      return false;
+    }
+
+    for (const cache_entry_t& e : live) {
+      entries[probe(e.key)] = e;
+    }
+    header->count = live.size();
+
+    return true;
+  }
+
+  int fd = -1;
+  cache_header_t* header = nullptr;
+  cache_entry_t* entries = nullptr;
+};
+}
@@ -0,0 +1,287 @@
+#pragma once
+#include "batch.hpp"
+#include "host.hpp"
+#include <array>
+#include <vector>
+
+namespace blake3 {
+
+// Just to avoid kernel name mangling in optimization report
+class kernelBlake3CDCScan;
+class kernelBlake3CDCChunkCVs;
+
+// Content defined chunking parameters ( FastCDC, with normalized chunking ),
+// segment sizes in bytes, where `avg` is power of 2
+struct cdc_params_t
+{
+  size_t min = 1 << 11;
+  size_t avg = 1 << 13;
+  size_t max = 1 << 16;
+};
+
+// Checks that segment sizes are ordered, while average is power of 2, so that
+// boundary masks can be derived from it
+static inline bool
+is_valid_cdc_params(const cdc_params_t& p)
+{
+  return p.min > 0 && p.min < p.avg && p.avg < p.max &&
+         (p.avg & (p.avg - 1)) == 0 && bin_log(p.avg) >= 4;
+}
+
+// Gear table, 256 pseudo random 64 -bit words ( generated by splitmix64, so
+// that same table can be rebuilt anywhere ), indexed by input byte
+static constexpr std::array<uint64_t, 256>
+make_gear_table()
+{
+  std::array<uint64_t, 256> table{};
+
+  uint64_t x = 0x6A09E667BB67AE85ul;
+  for (size_t i = 0; i < 256; i++) {
+    x += 0x9e3779b97f4a7c15ul;
+
+    uint64_t z = x;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ul;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebul;
+    table[i] = z ^ (z >> 31);
+  }
+
+  return table;
+}
+
+constexpr std::array<uint64_t, 256> GEAR = make_gear_table();
+
+// Boundary mask with `bits` -many most significant bits set; gear hash is
+// shifted left on each byte, so its high bits depend on last 64 input bytes,
+// while low bits depend on only a few
+static constexpr uint64_t
+cdc_mask(const size_t bits)
+{
+  return ~0ul << (64 - bits);
+}
+
+// Finds content defined segment boundaries of `len` -bytes input, on host,
+// returning end offset ( exclusive ) of each segment, in order; used as
+// reference for device scanner
+//
+// Segment is cut right after byte, where gear hash ( reset at segment start,
+// updated only after `min` -bytes ) has all bits of mask unset; stricter mask
+// ( two more bits than log2(avg) ) is used before `avg` -bytes and looser one
+// ( two fewer bits ) after, so that segment sizes concentrate around `avg`;
+// segment is forcibly cut at `max` -bytes, last one ends at input end
+std::vector<size_t>
+cdc_cuts_host(const sycl::uchar* const data,
+              const size_t len,
+              const cdc_params_t& p = cdc_params_t{})
+{
+  assert(is_valid_cdc_params(p));
+
+  const uint64_t mask_s = cdc_mask(bin_log(p.avg) + 2);
+  const uint64_t mask_l = cdc_mask(bin_log(p.avg) - 2);
+
+  std::vector<size_t> cuts;
+
+  size_t start = 0;
+  uint64_t h = 0;
+
+  for (size_t i = 0; i < len; i++) {
+    const size_t seg_len = i - start + 1;
+
+    if (seg_len > p.min) {
+      h = (h << 1) + GEAR[data[i]];
+    }
+
+    const uint64_t mask = seg_len < p.avg ? mask_s : mask_l;
+    if ((seg_len > p.min && (h & mask) == 0) || seg_len == p.max) {
+      cuts.push_back(i + 1);
+      start = i + 1;
+      h = 0;
+    }
+  }
+
+  if (start < len) {
+    cuts.push_back(len);
+  }
+
+  return cuts;
+}
+
+// Enqueues boundary scanner kernel, which streams `len` -bytes input ( living
+// in device memory ) once, byte by byte, finding content defined segment
+// boundaries same way as `cdc_cuts_host` does, writing end offset of each
+// segment into `cuts` ( must hold `len / min + 1` entries ) and number of
+// segments into `cut_cnt`
+//
+// Gear hash update is a shift and an add, so loop carried dependency fits in
+// one cycle, while gear table lives in on-chip ROM
+sycl::event
+submit_cdc_scan(sycl::queue& q,                      // SYCL compute queue
+                sycl::uchar* const __restrict input, // never modified !
+                const size_t len,                    // bytes
+                const cdc_params_t p,                // segment sizes
+                size_t* const __restrict cuts,       // segment end offsets
+                size_t* const __restrict cut_cnt     // number of segments
+)
+{
+  assert(is_valid_cdc_params(p));
+
+  const uint64_t mask_s = cdc_mask(bin_log(p.avg) + 2);
+  const uint64_t mask_l = cdc_mask(bin_log(p.avg) - 2);
+
+  return q.single_task<kernelBlake3CDCScan>(
+    [=]() [[intel::kernel_args_restrict]] {
+      // Just to hint that Load Store Units don't need to interface with host
+      sycl::device_ptr<sycl::uchar> i_ptr{ input };
+      sycl::device_ptr<size_t> c_ptr{ cuts };
+      sycl::device_ptr<size_t> n_ptr{ cut_cnt };
+
+      size_t start = 0;
+      size_t cnt = 0;
+      uint64_t h = 0;
+
+      for (size_t i = 0; i < len; i++) {
+        const size_t seg_len = i - start + 1;
+
+        if (seg_len > p.min) {
+          h = (h << 1) + GEAR[i_ptr[i]];
+        }
+
+        const uint64_t mask = seg_len < p.avg ? mask_s : mask_l;
+        if ((seg_len > p.min && (h & mask) == 0) || seg_len == p.max) {
+          c_ptr[cnt++] = i + 1;
+          start = i + 1;
+          h = 0;
+        }
+      }
+
+      if (start < len) {
+        c_ptr[cnt++] = len;
+      }
+
+      n_ptr[0] = cnt;
+    });
+}
+
+// One content defined segment of input, along with its BLAKE3 digest
+struct cdc_segment_t
+{
+  uint64_t offset; // bytes, from start of input
+  uint64_t length; // bytes
+  sycl::uchar digest[32];
+};
+
+// Splits `len` -bytes input ( living in host memory ) into content defined
+// segments and computes BLAKE3 digest of each, on accelerator
+//
+// Input crosses PCIe once and is read from global memory twice
+//
+// - boundary scanner kernel streams it, finding segment boundaries ( see
+// `submit_cdc_scan` ), only boundaries are copied back
+// - `submit_chunk_cvs` kernel ( indexed by byte offset, because segments
+// aren't chunk aligned ) compresses all full chunks of all segments, except
+// last chunk of each segment, in one launch, using per segment chunk counters
+//
+// Last ( possibly partial ) chunk of each segment, which may turn out to be
+// root, and parent nodes are compressed on host, see `cv_stack_root`
+std::vector<cdc_segment_t>
+hash_segments(sycl::queue& q,
+              const sycl::uchar* const data,
+              const size_t len,
+              const cdc_params_t& p = cdc_params_t{})
+{
+  assert(is_valid_cdc_params(p));
+
+  std::vector<cdc_segment_t> segments;
+  if (len == 0) {
+    return segments;
+  }
+
+  const size_t max_cuts = len / p.min + 1;
+  const size_t max_chunks = len / CHUNK_LEN;
+
+  sycl::uchar* i_d = static_cast<sycl::uchar*>(sycl::malloc_device(len, q));
+  size_t* cuts_d =
+    static_cast<size_t*>(sycl::malloc_device(max_cuts * sizeof(size_t), q));
+  size_t* cnt_d = static_cast<size_t*>(sycl::malloc_device(sizeof(size_t), q));
+
+  q.memcpy(i_d, data, len).wait();
+  submit_cdc_scan(q, i_d, len, p, cuts_d, cnt_d).wait();
+
+  size_t cut_cnt = 0;
+  q.memcpy(&cut_cnt, cnt_d, sizeof(size_t)).wait();
+
+  std::vector<size_t> cuts(cut_cnt);
+  q.memcpy(cuts.data(), cuts_d, cut_cnt * sizeof(size_t)).wait();
+
+  // full chunks of each segment, except its last chunk
+  std::vector<size_t> offsets;
+  std::vector<uint64_t> counters;
+  offsets.reserve(max_chunks);
+  counters.reserve(max_chunks);
+
+  size_t start = 0;
+  for (const size_t end : cuts) {
+    const size_t seg_len = end - start;
+    const size_t cnt = (seg_len - 1) / CHUNK_LEN;
+
+    for (size_t j = 0; j < cnt; j++) {
+      offsets.push_back(start + j * CHUNK_LEN);
+      counters.push_back(j);
+    }
+
+    start = end;
+  }
+
+  const size_t chunk_cnt = offsets.size();
+  std::vector<uint32_t> cvs(chunk_cnt << 3);
+
+  if (chunk_cnt > 0) {
+    size_t* offsets_d =
+      static_cast<size_t*>(sycl::malloc_device(chunk_cnt * sizeof(size_t), q));
+    uint64_t* counters_d = static_cast<uint64_t*>(
+      sycl::malloc_device(chunk_cnt * sizeof(uint64_t), q));
+    uint32_t* cvs_d =
+      static_cast<uint32_t*>(sycl::malloc_device(chunk_cnt * OUT_LEN, q));
+
+    q.memcpy(offsets_d, offsets.data(), chunk_cnt * sizeof(size_t)).wait();
+    q.memcpy(counters_d, counters.data(), chunk_cnt * sizeof(uint64_t)).wait();
+    submit_chunk_cvs<kernelBlake3CDCChunkCVs, true>(
+      q, i_d, offsets_d, counters_d, chunk_cnt, cvs_d)
+      .wait();
+    q.memcpy(cvs.data(), cvs_d, chunk_cnt * OUT_LEN).wait();
+
+    sycl::free(offsets_d, q);
+    sycl::free(counters_d, q);
+    sycl::free(cvs_d, q);
+  }
+
+  sycl::free(i_d, q);
+  sycl::free(cuts_d, q);
+  sycl::free(cnt_d, q);
+
+  segments.resize(cut_cnt);
+
+  start = 0;
+  size_t cv_idx = 0;
+  for (size_t i = 0; i < cut_cnt; i++) {
+    const size_t seg_len = cuts[i] - start;
+    const size_t cnt = (seg_len - 1) / CHUNK_LEN;
+
+    cv_stack_t stack;
+    for (size_t j = 0; j < cnt; j++) {
+      cv_stack_push(stack, j + 1, cvs.data() + ((cv_idx + j) << 3));
+    }
+    cv_idx += cnt;
+
+    const size_t last = cnt * CHUNK_LEN;
+    cv_stack_root(
+      stack, data + start + last, seg_len - last, cnt, segments[i].digest);
+
+    segments[i].offset = start;
+    segments[i].length = seg_len;
+
+    start = cuts[i];
+  }
+
+  return segments;
+}
+}
@@ -1,5 +1,8 @@
 #pragma once
 #include <CL/sycl.hpp>
+#include <chrono>
+#include <thread>
+#include <time.h>
 
 // Computes actual execution time of enqueued command with nanosecond level of
 // granularity
@@ -15,3 +18,120 @@ time_event(sycl::event& evt)
 
   return end - start;
 }
+
+// How host thread waits for completion of an enqueued command
+//
+// - blocking : `sycl::event::wait()`, thread sleeps inside SYCL runtime
+// - yield : spins on command status, yielding processor between checks, lowest
+// wake up latency, but burns one core
+// - adaptive : spins ( like `yield` ) for `WAIT_SPIN_NS`, then blocks, so short
+// commands are picked up quickly, while long ones don't burn a core
+// - polling : checks command status every `WAIT_POLL_NS`, sleeping in between,
+// which is what a reactor ( say an event loop, checking many in-flight
+// commands on each of its turns ) does
+enum class wait_strategy
+{
+  blocking,
+  yield,
+  adaptive,
+  polling
+};
+
+// Spin budget of adaptive wait strategy, before it blocks
+constexpr uint64_t WAIT_SPIN_NS = 50'000;
+
+// Interval between two status checks of polling wait strategy
+constexpr uint64_t WAIT_POLL_NS = 20'000;
+
+// Host side cost of waiting for one command
+struct wait_stats_t
+{
+  // CPU time consumed by waiting thread, while waiting
+  uint64_t cpu_ns = 0;
+  // time from command end ( as reported by profiling ) until waiting thread
+  // observes completion
+  uint64_t wake_ns = 0;
+};
+
+// Nanoseconds elapsed on host's monotonic clock
+static inline uint64_t
+host_now_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+// CPU time consumed by calling thread so far, in nanoseconds
+static inline uint64_t
+thread_cpu_ns()
+{
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000ul +
+         static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Whether enqueued command has completed, without blocking
+static inline bool
+is_complete(sycl::event& evt)
+{
+  return evt.get_info<sycl::info::event::command_execution_status>() ==
+         sycl::info::event_command_status::complete;
+}
+
+// Waits for completion of enqueued command, using given strategy
+//
+// When `stats` is not nullptr, host cost of waiting is written there, which
+// requires profiling enabled queue; `submitted_at` must be `host_now_ns()`
+// taken just before command was enqueued, so that wake up latency can be
+// estimated as host time elapsed since submission, minus device time elapsed
+// from submission till command end ( both clocks are not same, so it's an
+// estimate )
+static inline void
+wait_event(sycl::event& evt,
+           const wait_strategy ws,
+           const uint64_t submitted_at = 0,
+           wait_stats_t* const stats = nullptr)
+{
+  const uint64_t cpu_0 = stats != nullptr ? thread_cpu_ns() : 0;
+
+  switch (ws) {
+    case wait_strategy::blocking:
+      evt.wait();
+      break;
+    case wait_strategy::yield:
+      while (!is_complete(evt)) {
+        std::this_thread::yield();
+      }
+      break;
+    case wait_strategy::adaptive: {
+      const uint64_t spin_end = host_now_ns() + WAIT_SPIN_NS;
+      while (!is_complete(evt) && host_now_ns() < spin_end) {
+        std::this_thread::yield();
+      }
+      evt.wait();
+      break;
+    }
+    case wait_strategy::polling:
+      while (!is_complete(evt)) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(WAIT_POLL_NS));
+      }
+      break;
+  }
+
+  if (stats != nullptr) {
+    const uint64_t returned_at = host_now_ns();
+    stats->cpu_ns = thread_cpu_ns() - cpu_0;
+
+    const sycl::cl_ulong submit =
+      evt.get_profiling_info<sycl::info::event_profiling::command_submit>();
+    const sycl::cl_ulong end =
+      evt.get_profiling_info<sycl::info::event_profiling::command_end>();
+
+    const uint64_t host_elapsed = returned_at - submitted_at;
+    const uint64_t dev_elapsed = end - submit;
+    stats->wake_ns =
+      host_elapsed > dev_elapsed ? host_elapsed - dev_elapsed : 0;
+  }
+}
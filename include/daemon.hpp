@@ -0,0 +1,548 @@
+#pragma once
+#include "blake3.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <map>
+#include <poll.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+namespace blake3 {
+
+// Just to avoid kernel name mangling in optimization report
+class kernelBlake3Daemon;
+
+// Default path of Unix domain socket, where local hashing daemon ( see
+// daemon/main.cpp ) listens for requests
+//
+// It lives in user's private runtime directory ( `$XDG_RUNTIME_DIR`, falling
+// back to `/run/user/<uid>` ), not in world-writable `/tmp`
+static inline std::string
+daemon_default_path()
+{
+  const char* dir = std::getenv("XDG_RUNTIME_DIR");
+  if (dir != nullptr && dir[0] != '\0') {
+    return std::string(dir) + "/blake3-fpga.sock";
+  }
+
+  return "/run/user/" + std::to_string(getuid()) + "/blake3-fpga.sock";
+}
+
+// Seals, which must be set on memfd carrying payload, so that client can't
+// shrink it while daemon has it memory mapped
+constexpr int DAEMON_REQUIRED_SEALS = F_SEAL_SHRINK | F_SEAL_GROW;
+
+// Request sent by client, along with memfd holding `size` -bytes payload, which
+// is passed as SCM_RIGHTS ancillary data
+struct daemon_request
+{
+  uint64_t size;
+};
+
+// Response sent by daemon, for each request, in same order as requests were
+// sent on that connection; `digest` is valid only when `status` is 0,
+// otherwise `status` is errno-like error code
+struct daemon_response
+{
+  int32_t status;
+  sycl::uchar digest[OUT_LEN];
+};
+
+// Sends `len` -bytes message on ( SOCK_SEQPACKET ) Unix domain socket, while
+// passing file descriptor `fd` as ancillary data
+//
+// Returns false if message couldn't be sent
+static inline bool
+send_with_fd(const int sock, const void* buf, const size_t len, const int fd)
+{
+  iovec iov{ const_cast<void*>(buf), len };
+  alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(int))];
+  std::memset(ctrl, 0, sizeof(ctrl));
+
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl;
+  msg.msg_controllen = sizeof(ctrl);
+
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+  return sendmsg(sock, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(len);
+}
+
+// Receives at max `len` -bytes message from ( SOCK_SEQPACKET ) Unix domain
+// socket, while `fd` is set to passed file descriptor or -1, if none was
+// passed
+//
+// Returns same as `recvmsg`
+static inline ssize_t
+recv_with_fd(const int sock, void* buf, const size_t len, int* const fd)
+{
+  iovec iov{ buf, len };
+  alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(int))];
+
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl;
+  msg.msg_controllen = sizeof(ctrl);
+
+  *fd = -1;
+
+  const ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  if (n <= 0) {
+    return n;
+  }
+
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg != nullptr && cmsg->cmsg_level == SOL_SOCKET &&
+      cmsg->cmsg_type == SCM_RIGHTS) {
+    std::memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+  }
+
+  return n;
+}
+
+// Connects to local hashing daemon, listening on Unix domain socket `path`
+//
+// Returns connected socket or -1 on failure
+int
+daemon_connect(const char* const path)
+{
+  const int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (sock < 0) {
+    return -1;
+  }
+
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+  if (connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    close(sock);
+    return -1;
+  }
+
+  return sock;
+}
+
+// Asks daemon to hash `size` -bytes payload, already living in `memfd` ( which
+// must carry `DAEMON_REQUIRED_SEALS` ), so that payload is never copied between
+// client and daemon processes
+//
+// Same constraints as `hash` apply to `size`, writes 32 -bytes digest to host
+// memory `digest`
+//
+// Returns 0 on success, otherwise errno-like error code
+int
+daemon_hash_memfd(const int sock,
+                  const int memfd,
+                  const size_t size,
+                  sycl::uchar* const digest)
+{
+  const daemon_request req{ size };
+  if (!send_with_fd(sock, &req, sizeof(req), memfd)) {
+    return errno;
+  }
+
+  daemon_response resp;
+  if (recv(sock, &resp, sizeof(resp), 0) != sizeof(resp)) {
+    return EPROTO;
+  }
+
+  if (resp.status == 0) {
+    std::memcpy(digest, resp.digest, OUT_LEN);
+  }
+
+  return resp.status;
+}
+
+// Copies `len` -bytes payload into a newly created sealed memfd and asks
+// daemon to hash it, see `daemon_hash_memfd`
+//
+// Returns 0 on success, otherwise errno-like error code
+int
+daemon_hash(const int sock,
+            const sycl::uchar* const data,
+            const size_t len,
+            sycl::uchar* const digest)
+{
+  const int memfd =
+    memfd_create("blake3-payload", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (memfd < 0) {
+    return errno;
+  }
+
+  int status = 0;
+  if (ftruncate(memfd, len) != 0) {
+    status = errno;
+  } else {
+    void* dst = mmap(nullptr, len, PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (dst == MAP_FAILED) {
+      status = errno;
+    } else {
+      std::memcpy(dst, data, len);
+      munmap(dst, len);
+
+      if (fcntl(memfd, F_ADD_SEALS, DAEMON_REQUIRED_SEALS) != 0) {
+        status = errno;
+      } else {
+        status = daemon_hash_memfd(sock, memfd, len, digest);
+      }
+    }
+  }
+
+  close(memfd);
+  return status;
+}
+
+// Upper bound on total payload bytes dispatched to device in one batch, so that
+// device memory isn't exhausted; requests beyond this stay in socket buffers,
+// to be picked up in next batch
+constexpr size_t DAEMON_MAX_BATCH_SIZE = 1ul << 30;
+
+// Upper bound on responses waiting to be sent to one client, after which no
+// more requests are read from that client, until it drains its responses
+constexpr size_t DAEMON_MAX_OUTBOX = 64;
+
+// Server side of local hashing daemon, which owns FPGA and accepts hashing
+// requests from local processes, while payloads are passed as sealed memfd, so
+// that they're never copied between processes
+//
+// All requests which are ready when daemon wakes up ( from all clients ) form
+// one batch. Host -> device payload tx, BLAKE3 kernel and device -> host digest
+// tx of all jobs of batch are enqueued back-to-back on in-order queue, while
+// device buffers are taken from a pool, which is kept across batches, and host
+// waits only once per batch
+//
+// Note, device still executes one BLAKE3 kernel at a time ( there's only one
+// kernel instance synthesized ), so jobs of a batch are serialized on device;
+// batching amortizes host side synchronization and allocation cost, not kernel
+// execution
+class daemon_server
+{
+public:
+  explicit daemon_server(sycl::queue& q)
+    : q(q)
+  {}
+
+  ~daemon_server()
+  {
+    for (auto& c : clients) {
+      close(c.first);
+    }
+
+    for (slot& s : pool) {
+      sycl::free(s.i_d, q);
+      sycl::free(s.mem, q);
+      sycl::free(s.o_d, q);
+    }
+
+    if (listener >= 0) {
+      close(listener);
+      unlink(path.c_str());
+    }
+  }
+
+  // Starts listening on Unix domain socket `sock_path`, which must either not
+  // exist or be a stale socket; any other kind of file is never removed
+  //
+  // Returns 0 on success, otherwise errno-like error code
+  int listen_on(const char* const sock_path)
+  {
+    struct stat st;
+    if (lstat(sock_path, &st) == 0) {
+      if (!S_ISSOCK(st.st_mode)) {
+        return EEXIST;
+      }
+      unlink(sock_path);
+    }
+
+    const int sock =
+      socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+      return errno;
+    }
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, sock_path, sizeof(addr.sun_path) - 1);
+
+    if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        chmod(sock_path, S_IRUSR | S_IWUSR) != 0 ||
+        listen(sock, SOMAXCONN) != 0) {
+      const int err = errno;
+      close(sock);
+      return err;
+    }
+
+    listener = sock;
+    path = sock_path;
+    return 0;
+  }
+
+  // Waits at max `timeout` milliseconds ( -1 for no timeout ) for events on
+  // listening/ connected sockets, then reads one batch of requests, dispatches
+  // it to device, queues responses and accepts new connections
+  //
+  // Returns false on fatal error
+  bool poll_once(const int timeout)
+  {
+    std::vector<pollfd> fds{ { listener, POLLIN, 0 } };
+    for (auto& c : clients) {
+      short events = c.second.outbox.size() < DAEMON_MAX_OUTBOX ? POLLIN : 0;
+      if (!c.second.outbox.empty()) {
+        events |= POLLOUT;
+      }
+      fds.push_back({ c.first, events, 0 });
+    }
+
+    if (poll(fds.data(), fds.size(), timeout) < 0) {
+      return errno == EINTR;
+    }
+
+    std::vector<job> batch;
+    std::vector<int> closed;
+    size_t batch_size = 0;
+
+    for (size_t i = 1; i < fds.size(); i++) {
+      if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) == 0) {
+        continue;
+      }
+      if (!read_requests(fds[i].fd, batch, batch_size)) {
+        closed.push_back(fds[i].fd);
+      }
+    }
+
+    dispatch(batch);
+
+    for (job& j : batch) {
+      clients[j.client].outbox.push_back(j.resp);
+    }
+
+    // responses which can't be sent now stay queued, until socket is writable
+    for (auto& c : clients) {
+      if (!flush(c.first, c.second)) {
+        closed.push_back(c.first);
+      }
+    }
+
+    for (const int fd : closed) {
+      if (clients.erase(fd) > 0) {
+        close(fd);
+      }
+    }
+
+    if ((fds[0].revents & POLLIN) != 0) {
+      int fd;
+      while ((fd = accept4(
+                listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >=
+             0) {
+        clients[fd] = client{};
+      }
+    }
+
+    return true;
+  }
+
+private:
+  // Responses waiting to be sent to connected client, in request order
+  struct client
+  {
+    std::deque<daemon_response> outbox;
+  };
+
+  // One request received from some client, waiting to be dispatched to device
+  struct job
+  {
+    int client;
+    size_t size;
+    void* payload; // memory mapped memfd, shared with client
+    daemon_response resp;
+  };
+
+  // Device buffers used by one job of batch, reused across batches
+  struct slot
+  {
+    sycl::uchar* i_d = nullptr;
+    uint32_t* mem = nullptr;
+    sycl::uchar* o_d = nullptr;
+    size_t cap = 0; // bytes of input `i_d` can hold
+  };
+
+  sycl::queue& q;
+  int listener = -1;
+  std::string path;
+  std::map<int, client> clients;
+  std::vector<slot> pool;
+
+  // Validates request and memory maps payload carried by `memfd`
+  //
+  // Returns 0 on success, otherwise errno-like error code, which is sent back
+  // to client
+  static int32_t map_payload(const int memfd,
+                             const size_t size,
+                             void** const payload)
+  {
+    const size_t chunk_count = size / CHUNK_LEN;
+
+    // same constraints as `hash`
+    if (size != chunk_count * CHUNK_LEN || chunk_count < (1 << 10) ||
+        (chunk_count & (chunk_count - 1)) != 0) {
+      return EINVAL;
+    }
+
+    // client must not be able to shrink payload while it's mapped here
+    const int seals = fcntl(memfd, F_GET_SEALS);
+    if (seals < 0 ||
+        (seals & DAEMON_REQUIRED_SEALS) != DAEMON_REQUIRED_SEALS) {
+      return EPERM;
+    }
+
+    struct stat st;
+    if (fstat(memfd, &st) != 0 || static_cast<size_t>(st.st_size) != size) {
+      return EINVAL;
+    }
+
+    void* ptr = mmap(nullptr, size, PROT_READ, MAP_SHARED, memfd, 0);
+    if (ptr == MAP_FAILED) {
+      return errno;
+    }
+
+    *payload = ptr;
+    return 0;
+  }
+
+  // Drains requests pending on client connection `fd`, until batch is full or
+  // client's outbox would overflow
+  //
+  // Returns false when client has hung up
+  bool read_requests(const int fd, std::vector<job>& batch, size_t& batch_size)
+  {
+    size_t pending = clients[fd].outbox.size();
+
+    while (batch_size < DAEMON_MAX_BATCH_SIZE && pending < DAEMON_MAX_OUTBOX) {
+      daemon_request req;
+      int memfd = -1;
+
+      const ssize_t n = recv_with_fd(fd, &req, sizeof(req), &memfd);
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return true;
+      }
+      if (n <= 0) {
+        return false;
+      }
+
+      job j{};
+      j.client = fd;
+      j.size = req.size;
+
+      if (n != sizeof(req) || memfd < 0) {
+        j.resp.status = EPROTO;
+      } else {
+        j.resp.status = map_payload(memfd, j.size, &j.payload);
+      }
+
+      // mapping stays valid, even after memfd is closed
+      if (memfd >= 0) {
+        close(memfd);
+      }
+
+      batch_size += j.resp.status == 0 ? j.size : 0;
+      batch.push_back(j);
+      pending++;
+    }
+
+    return true;
+  }
+
+  // Makes sure that slot can hold `size` -bytes input, growing its device
+  // buffers when required
+  //
+  // Returns false when device memory couldn't be allocated
+  bool reserve(slot& s, const size_t size)
+  {
+    if (s.o_d == nullptr) {
+      s.o_d = static_cast<sycl::uchar*>(sycl::malloc_device(OUT_LEN, q));
+    }
+
+    if (s.cap < size) {
+      sycl::free(s.i_d, q);
+      sycl::free(s.mem, q);
+
+      // intermediate chaining values need ( size / 16 ) -bytes, see `hash`
+      s.i_d = static_cast<sycl::uchar*>(sycl::malloc_device(size, q));
+      s.mem = static_cast<uint32_t*>(sycl::malloc_device(size >> 4, q));
+      s.cap = (s.i_d != nullptr && s.mem != nullptr) ? size : 0;
+    }
+
+    return s.o_d != nullptr && s.cap >= size;
+  }
+
+  // Enqueues all valid jobs of batch back-to-back, using pooled device
+  // buffers, then waits once for whole batch to complete
+  void dispatch(std::vector<job>& batch)
+  {
+    size_t used = 0;
+
+    for (job& j : batch) {
+      if (j.resp.status != 0) {
+        continue;
+      }
+
+      if (pool.size() == used) {
+        pool.emplace_back();
+      }
+
+      slot& s = pool[used];
+      if (!reserve(s, j.size)) {
+        j.resp.status = ENOMEM;
+        continue;
+      }
+      used++;
+
+      q.memcpy(s.i_d, j.payload, j.size);
+      submit_hash<kernelBlake3Daemon, false>(
+        q, s.i_d, nullptr, j.size / CHUNK_LEN, s.mem, s.o_d);
+      q.memcpy(j.resp.digest, s.o_d, OUT_LEN);
+    }
+
+    q.wait();
+
+    for (job& j : batch) {
+      if (j.payload != nullptr) {
+        munmap(j.payload, j.size);
+      }
+    }
+  }
+
+  // Sends as many queued responses as socket accepts now
+  //
+  // Returns false when connection is broken
+  static bool flush(const int fd, client& c)
+  {
+    while (!c.outbox.empty()) {
+      const daemon_response& resp = c.outbox.front();
+
+      if (send(fd, &resp, sizeof(resp), MSG_NOSIGNAL) < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+      }
+      c.outbox.pop_front();
+    }
+
+    return true;
+  }
+};
+}
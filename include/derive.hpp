@@ -0,0 +1,408 @@
+#pragma once
+#include "batch.hpp"
+#include "host.hpp"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string_view>
+
+// BLAKE3 `derive_key` mode, where context string is hashed into a context key
+// first, which is then used as key for hashing key material. Context keys are
+// kept in a bounded cache, so that deriving many subkeys from a few contexts
+// skips context hashing, both on host and on accelerator
+namespace blake3 {
+
+// Just to avoid kernel name mangling in optimization report
+class kernelBlake3DeriveKeys;
+
+// Default number of entries of context key cache
+constexpr size_t DERIVE_CACHE_SLOTS = 256;
+
+// Entries of each set of context key cache, among which victim is picked
+constexpr size_t DERIVE_CACHE_WAYS = 4;
+
+// Contexts longer than these many bytes aren't cached, their context key is
+// computed on each call
+constexpr size_t DERIVE_CTX_MAX = 128;
+
+// Hit statistics of context key cache, since it was created
+struct derive_cache_stats_t
+{
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t inserts;
+  uint64_t evictions;
+};
+
+// Computes 32 -bytes context key of `context` on host, as eight words, which
+// are used as key for hashing key material
+static inline void
+context_key_host(const std::string_view context, uint32_t* const key)
+{
+  sycl::uchar digest[32];
+  host_hash_copy(reinterpret_cast<const sycl::uchar*>(context.data()),
+                 nullptr,
+                 context.size(),
+                 digest,
+                 IV,
+                 DERIVE_KEY_CONTEXT);
+
+  for (size_t i = 0; i < 8; i++) {
+    key[i] = host_word_from_le_bytes(digest + (i << 2));
+  }
+}
+
+// Bounded cache of context keys, keyed by context string, which can be shared
+// by many threads, without locks
+//
+// Cache is set associative, where each set holds `DERIVE_CACHE_WAYS` entries
+// and victim is picked by CLOCK ( second chance ) policy, an approximation of
+// LRU, so that a hit only sets reference bit of entry, instead of reordering a
+// list. Each entry is guarded by a sequence counter ( odd while entry is being
+// written ), so that readers skip entries being replaced, instead of waiting,
+// while a writer finding entry being written by another one simply picks
+// another victim; cache may miss, but never returns torn entry
+class derive_key_cache
+{
+public:
+  explicit derive_key_cache(const size_t slots = DERIVE_CACHE_SLOTS)
+    : set_cnt(slots / DERIVE_CACHE_WAYS)
+    , entries(std::make_unique<entry_t[]>(slots))
+    , hands(std::make_unique<std::atomic<size_t>[]>(slots / DERIVE_CACHE_WAYS))
+  {
+    assert(slots >= DERIVE_CACHE_WAYS && (slots & (slots - 1)) == 0);
+  }
+
+  derive_key_cache(const derive_key_cache&) = delete;
+  derive_key_cache& operator=(const derive_key_cache&) = delete;
+
+  // Writes context key of `context` to `key`, computing it on host and caching
+  // it, when not cached yet
+  void context_key(const std::string_view context, uint32_t* const key)
+  {
+    if (lookup(context, key)) {
+      return;
+    }
+
+    context_key_host(context, key);
+    insert(context, key);
+  }
+
+  // Looks up cached context key of `context`, writing it to `key`
+  //
+  // Returns false, when it's not cached
+  bool lookup(const std::string_view context, uint32_t* const key)
+  {
+    if (context.size() > DERIVE_CTX_MAX) {
+      misses.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    uint64_t words[CTX_WORDS];
+    const uint64_t tag = to_words(context, words);
+    const size_t w_cnt = (context.size() + 7) >> 3;
+
+    const size_t set_idx = (tag >> 1) % set_cnt;
+    entry_t* const set = entries.get() + set_idx * DERIVE_CACHE_WAYS;
+
+    for (size_t w = 0; w < DERIVE_CACHE_WAYS; w++) {
+      entry_t& e = set[w];
+
+      const uint64_t s = e.seq.load(std::memory_order_acquire);
+      if ((s & 1) == 1 || e.tag.load(std::memory_order_relaxed) != tag ||
+          e.len.load(std::memory_order_relaxed) != context.size()) {
+        continue;
+      }
+
+      bool same = true;
+      for (size_t i = 0; i < w_cnt; i++) {
+        same &= e.ctx[i].load(std::memory_order_relaxed) == words[i];
+      }
+
+      uint32_t k[8];
+      for (size_t i = 0; i < 8; i++) {
+        k[i] = e.key[i].load(std::memory_order_relaxed);
+      }
+
+      // entry wasn't replaced, while it was being read
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (!same || e.seq.load(std::memory_order_relaxed) != s) {
+        continue;
+      }
+
+      e.ref.store(1, std::memory_order_relaxed);
+      std::copy(k, k + 8, key);
+
+      hits.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // Caches context key of `context`, replacing an entry of its set, which
+  // wasn't referenced since clock hand last passed it; new entry is
+  // unreferenced until its first hit, so that contexts used once are evicted
+  // first. Contexts longer than `DERIVE_CTX_MAX` -bytes aren't cached
+  void insert(const std::string_view context, const uint32_t* const key)
+  {
+    if (context.size() > DERIVE_CTX_MAX) {
+      return;
+    }
+
+    uint64_t words[CTX_WORDS];
+    const uint64_t tag = to_words(context, words);
+
+    const size_t set_idx = (tag >> 1) % set_cnt;
+    entry_t* const set = entries.get() + set_idx * DERIVE_CACHE_WAYS;
+
+    // every referenced entry gets a second chance, so that after one sweep
+    // some entry is unreferenced, unless it's referenced again meanwhile
+    for (size_t t = 0; t < (DERIVE_CACHE_WAYS << 1); t++) {
+      const size_t w =
+        hands[set_idx].fetch_add(1, std::memory_order_relaxed) %
+        DERIVE_CACHE_WAYS;
+      entry_t& e = set[w];
+
+      const bool last = t + 1 == (DERIVE_CACHE_WAYS << 1);
+      if (e.ref.exchange(0, std::memory_order_relaxed) == 1 && !last) {
+        continue;
+      }
+
+      // another writer is replacing this entry
+      uint64_t s = e.seq.load(std::memory_order_relaxed);
+      if ((s & 1) == 1 ||
+          !e.seq.compare_exchange_strong(s, s + 1, std::memory_order_relaxed)) {
+        continue;
+      }
+      std::atomic_thread_fence(std::memory_order_release);
+
+      if (e.tag.load(std::memory_order_relaxed) != 0) {
+        evictions.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      e.tag.store(tag, std::memory_order_relaxed);
+      e.len.store(context.size(), std::memory_order_relaxed);
+      for (size_t i = 0; i < CTX_WORDS; i++) {
+        e.ctx[i].store(words[i], std::memory_order_relaxed);
+      }
+      for (size_t i = 0; i < 8; i++) {
+        e.key[i].store(key[i], std::memory_order_relaxed);
+      }
+      e.ref.store(0, std::memory_order_relaxed);
+
+      e.seq.store(s + 2, std::memory_order_release);
+
+      inserts.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+
+  // Snapshot of hit statistics
+  derive_cache_stats_t stats() const
+  {
+    return { hits.load(std::memory_order_relaxed),
+             misses.load(std::memory_order_relaxed),
+             inserts.load(std::memory_order_relaxed),
+             evictions.load(std::memory_order_relaxed) };
+  }
+
+private:
+  static constexpr size_t CTX_WORDS = DERIVE_CTX_MAX >> 3;
+
+  // One cached context key, where all fields are atomics, so that entry can be
+  // read while it's being replaced, see `seq`
+  struct entry_t
+  {
+    std::atomic<uint64_t> seq{ 0 };
+    std::atomic<uint64_t> tag{ 0 }; // 0, when entry is empty
+    std::atomic<uint64_t> len{ 0 }; // of context, in bytes
+    std::atomic<uint64_t> ctx[CTX_WORDS]{};
+    std::atomic<uint32_t> key[8]{};
+    std::atomic<uint8_t> ref{ 0 }; // referenced since clock hand passed it
+  };
+
+  // Packs context into zero padded words, returning its tag, which selects
+  // set of cache ( FNV-1a, mixed by splitmix64 finalizer, see
+  // https://xorshift.di.unimi.it/splitmix64.c ), having lowest bit set, so that
+  // it's never 0
+  static uint64_t to_words(const std::string_view context,
+                           uint64_t* const words)
+  {
+    std::fill(words, words + CTX_WORDS, 0ul);
+    std::memcpy(words, context.data(), context.size());
+
+    uint64_t z = 0xcbf29ce484222325ul;
+    for (const char c : context) {
+      z = (z ^ static_cast<uint8_t>(c)) * 0x100000001b3ul;
+    }
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ul;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebul;
+    return (z ^ (z >> 31)) | 1ul;
+  }
+
+  const size_t set_cnt;
+  std::unique_ptr<entry_t[]> entries;
+  std::unique_ptr<std::atomic<size_t>[]> hands; // clock hand of each set
+
+  std::atomic<uint64_t> hits{ 0 };
+  std::atomic<uint64_t> misses{ 0 };
+  std::atomic<uint64_t> inserts{ 0 };
+  std::atomic<uint64_t> evictions{ 0 };
+};
+
+// Derives 32 -bytes key from `len` -bytes key material ( living in host
+// memory ), on host, using context key of `context`, looked up in cache
+void
+derive_key(derive_key_cache& cache,
+           const std::string_view context,
+           const sycl::uchar* const material,
+           const size_t len,
+           sycl::uchar* const out)
+{
+  uint32_t key[8];
+  cache.context_key(context, key);
+
+  host_hash_copy(material, nullptr, len, out, key, DERIVE_KEY_MATERIAL);
+}
+
+// Enqueues BLAKE3 kernel, which derives `count` -many 32 -bytes keys from key
+// materials of `mat_len` -bytes each ( at most one chunk ), living
+// consecutively in `materials`, all under same context key, which is passed as
+// kernel argument, so that context is never hashed on accelerator
+//
+// Each key material is a single chunk input, so its last message block is
+// root. Message blocks are scheduled same way as `submit_chunk_cvs` does i.e.
+// j-th message blocks of all key materials are compressed in j-th round, while
+// output chaining values are spilled in `cvs` ( count x 32 -bytes ); idle
+// iterations are inserted, when there are fewer than `CV_SPILL_DISTANCE` key
+// materials
+sycl::event
+submit_derive_keys(sycl::queue& q,                          // SYCL queue
+                   const std::array<uint32_t, 8> ctx_key,   // context key
+                   sycl::uchar* const __restrict materials, // never modified !
+                   const size_t mat_len,                    // <= 1024 -bytes
+                   const size_t count,                      // number of keys
+                   uint32_t* const __restrict cvs,          // scratch space
+                   sycl::uchar* const __restrict keys       // count x 32 -bytes
+)
+{
+  assert(mat_len <= CHUNK_LEN);
+
+  return q.single_task<kernelBlake3DeriveKeys>(
+    [=]() [[intel::kernel_args_restrict]] {
+      // Just to hint that Load Store Units don't need to interface with host
+      sycl::device_ptr<sycl::uchar> i_ptr{ materials };
+      sycl::device_ptr<uint32_t> cv_ptr{ cvs };
+      sycl::device_ptr<sycl::uchar> o_ptr{ keys };
+
+      [[intel::fpga_register]] uint32_t msg[16];
+      [[intel::fpga_register]] uint32_t state[16];
+
+      sycl::private_ptr<uint32_t> state_ptr{ state };
+      sycl::private_ptr<uint32_t> msg_ptr{ msg };
+
+      const size_t blk_cnt =
+        mat_len == 0 ? 1 : (mat_len + BLOCK_LEN - 1) / BLOCK_LEN;
+      const size_t round_len = std::max<size_t>(count, CV_SPILL_DISTANCE);
+      const size_t itr_cnt = round_len * blk_cnt;
+
+      size_t idx = 0;
+      size_t blk_idx = 0;
+
+      [[intel::ivdep(CV_SPILL_DISTANCE)]] for (size_t c = 0; c < itr_cnt; c++)
+      {
+        // idle iteration, when there are only a few key materials
+        if (idx < count) {
+          const bool last = blk_idx + 1 == blk_cnt;
+          const size_t blk_off = blk_idx * BLOCK_LEN;
+          const size_t blk_len =
+            mat_len > blk_off ? std::min<size_t>(BLOCK_LEN, mat_len - blk_off)
+                              : 0;
+
+#pragma unroll 8
+          for (size_t i = 0; i < 8; i++) {
+            state_ptr[i] = blk_idx == 0 ? ctx_key[i] : cv_ptr[(idx << 3) + i];
+          }
+#pragma unroll 4
+          for (size_t i = 0; i < 4; i++) {
+            state_ptr[8 + i] = IV[i];
+          }
+
+          state_ptr[12] = 0;
+          state_ptr[13] = 0;
+          state_ptr[14] = static_cast<uint32_t>(blk_len);
+          state_ptr[15] = DERIVE_KEY_MATERIAL |
+                          (blk_idx == 0 ? CHUNK_START : 0) |
+                          (last ? CHUNK_END | ROOT : 0);
+
+          // last message block is zero padded
+          const size_t i_offset = idx * mat_len + blk_off;
+
+#pragma unroll 16
+          for (size_t i = 0; i < 16; i++) {
+            uint32_t word = 0;
+#pragma unroll 4
+            for (size_t j = 0; j < 4; j++) {
+              const size_t b = (i << 2) + j;
+              const uint32_t byte = b < blk_len ? i_ptr[i_offset + b] : 0;
+              word |= byte << (j << 3);
+            }
+            msg_ptr[i] = word;
+          }
+
+          compress(state_ptr, msg_ptr);
+
+          if (last) {
+            words_to_le_bytes(state_ptr, o_ptr + (idx << 5));
+          } else {
+#pragma unroll 8
+            for (size_t i = 0; i < 8; i++) {
+              cv_ptr[(idx << 3) + i] = state_ptr[i];
+            }
+          }
+        }
+
+        // point to next key material/ message block
+        if (idx + 1 == round_len) {
+          idx = 0;
+          blk_idx++;
+        } else {
+          idx++;
+        }
+      }
+    });
+}
+
+// Derives `count` -many 32 -bytes keys from key materials of `mat_len` -bytes
+// each ( living consecutively in device memory ), on accelerator, using
+// context key of `context`, looked up in cache, see `submit_derive_keys`
+void
+derive_keys(sycl::queue& q,                          // SYCL compute queue
+            derive_key_cache& cache,                 // context key cache
+            const std::string_view context,          // context string
+            sycl::uchar* const __restrict materials, // count x mat_len -bytes
+            const size_t mat_len,                    // <= 1024 -bytes
+            const size_t count,                      // number of keys
+            sycl::uchar* const __restrict keys,      // count x 32 -bytes
+            sycl::cl_ulong* const __restrict ts      // kernel exec time in `ns`
+)
+{
+  std::array<uint32_t, 8> ctx_key;
+  cache.context_key(context, ctx_key.data());
+
+  uint32_t* cvs = static_cast<uint32_t*>(
+    sycl::malloc_device(std::max<size_t>(count, 1) * OUT_LEN, q));
+
+  sycl::event evt =
+    submit_derive_keys(q, ctx_key, materials, mat_len, count, cvs, keys);
+  evt.wait();
+  sycl::free(cvs, q);
+
+  if (ts != nullptr) {
+    *ts = time_event(evt);
+  }
+}
+}
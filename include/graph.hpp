@@ -0,0 +1,258 @@
+#pragma once
+#include "batch.hpp"
+#include <optional>
+
+namespace blake3 {
+
+// Just to avoid kernel name mangling in optimization report
+class kernelBlake3Graph;
+class kernelBlake3GraphSmall;
+
+// Payloads of fewer chunks than these are hashed by `submit_hash_small`,
+// because `submit_hash` relies on at least 2^10 chunks, for chaining values
+// spilled to global memory to be written back before they're read again
+constexpr size_t GRAPH_SMALL_CHUNKS = 1 << 10;
+
+// Enqueues BLAKE3 kernel for a small payload ( `chunk_count` -many chunks,
+// power of 2, >= 2 ), living in `input`, writing digest to `digest`, where
+// `mem` holds ( chunk_count x 64 ) -bytes of intermediate chaining values, same
+// layout as `submit_hash` uses
+//
+// Whole hashing is one loop over steps, same as `hash_pooled` does, but with
+// one compress engine: first 16 steps compress j-th message blocks of all
+// chunks, next log2(chunk_count) steps compress parent nodes of one tree level.
+// Each step starts with `CV_SPILL_DISTANCE` idle iterations, so that a
+// chaining value written in one step is read back at least these many
+// iterations later, in next step, however few chunks there are
+template<typename KernelName>
+sycl::event
+submit_hash_small(sycl::queue& q,                       // SYCL compute queue
+                  sycl::uchar* const __restrict input,  // never modified !
+                  const size_t chunk_count,             // power of 2
+                  uint32_t* const __restrict mem,       // chaining values
+                  sycl::uchar* const __restrict digest  // 32 -bytes digest
+)
+{
+  // 16 chunk steps, followed by one step per tree level
+  const size_t step_cnt = 16 + bin_log(chunk_count);
+
+  size_t itr_cnt = 0;
+  for (size_t s = 0; s < step_cnt; s++) {
+    const size_t task_cnt = s < 16 ? chunk_count : chunk_count >> (s - 15);
+    itr_cnt += CV_SPILL_DISTANCE + task_cnt;
+  }
+
+  return q.single_task<KernelName>([=]() [[intel::kernel_args_restrict]] {
+    // Just to hint that Load Store Units don't need to interface with host
+    sycl::device_ptr<sycl::uchar> i_ptr{ input };
+    sycl::device_ptr<uint32_t> mem_ptr{ mem };
+    sycl::device_ptr<sycl::uchar> o_ptr{ digest };
+
+    [[intel::fpga_register]] uint32_t msg[16];
+    [[intel::fpga_register]] uint32_t state[16];
+
+    sycl::private_ptr<uint32_t> state_ptr{ state };
+    sycl::private_ptr<uint32_t> msg_ptr{ msg };
+
+    const size_t leaf_offset = chunk_count << 3;
+
+    size_t step = 0;
+    size_t task_cnt = chunk_count;
+    size_t step_itr = 0;
+
+    [[intel::ivdep(CV_SPILL_DISTANCE)]] for (size_t c = 0; c < itr_cnt; c++)
+    {
+      const bool parent = step >= 16;
+      const bool root = parent && task_cnt == 1;
+
+      // level (step - 16) of tree consumes chaining values of level below
+      const size_t level = parent ? step - 16 : 0;
+      const size_t i_offset = leaf_offset >> level;
+      const size_t o_offset = parent ? i_offset >> 1 : leaf_offset;
+
+      // idle, while previous step is being written back
+      if (step_itr >= CV_SPILL_DISTANCE) {
+        const size_t t = step_itr - CV_SPILL_DISTANCE;
+        const size_t o_offset_t = o_offset + (t << 3);
+
+#pragma unroll 8
+        for (size_t i = 0; i < 8; i++) {
+          state_ptr[i] = parent || step == 0 ? IV[i] : mem_ptr[o_offset_t + i];
+        }
+#pragma unroll 4
+        for (size_t i = 0; i < 4; i++) {
+          state_ptr[8 + i] = IV[i];
+        }
+
+        state_ptr[12] = parent ? 0 : static_cast<uint32_t>(t & 0xffffffff);
+        state_ptr[13] = parent ? 0 : static_cast<uint32_t>(t >> 32);
+        state_ptr[14] = BLOCK_LEN;
+        state_ptr[15] = parent ? (PARENT | (root ? ROOT : 0))
+                               : (step == 0 ? CHUNK_START : 0) |
+                                   (step == 15 ? CHUNK_END : 0);
+
+        // either message block of chunk or two children chaining values
+#pragma unroll 16
+        for (size_t i = 0; i < 16; i++) {
+          msg_ptr[i] =
+            parent ? mem_ptr[i_offset + (t << 4) + i]
+                   : word_from_le_bytes(i_ptr + (t << 10) + (step << 6) +
+                                        (i << 2));
+        }
+
+        compress(state_ptr, msg_ptr);
+
+        if (root) {
+          words_to_le_bytes(state_ptr, o_ptr);
+        } else {
+#pragma unroll 8
+          for (size_t i = 0; i < 8; i++) {
+            mem_ptr[o_offset_t + i] = state_ptr[i];
+          }
+        }
+      }
+
+      // point to next iteration of this step, or to next step
+      if (step_itr + 1 == CV_SPILL_DISTANCE + task_cnt) {
+        step++;
+        task_cnt = step < 16 ? chunk_count : task_cnt >> 1;
+        step_itr = 0;
+      } else {
+        step_itr++;
+      }
+    }
+  });
+}
+
+#if defined SYCL_EXT_ONEAPI_GRAPH
+namespace sycl_graph = sycl::ext::oneapi::experimental;
+#endif
+
+// Hashes many payloads of same size ( `chunk_count` -many chunks, power of 2,
+// >= 2 ), one after another, using fixed buffer layout, where payloads of
+// fewer than `GRAPH_SMALL_CHUNKS` chunks are hashed by `submit_hash_small`
+//
+// - pinned host payload buffer, which caller fills with next payload
+// - device input, intermediate chaining value and digest buffers
+// - pinned host digest buffer, where digest of last payload lands
+//
+// Command sequence of one payload ( host -> device input tx, BLAKE3 kernel,
+// device -> host digest tx ) is recorded into a SYCL command graph once, when
+// `sycl_ext_oneapi_graph` extension is available ( and `record` is set ), so
+// that hashing each payload is one graph submission, instead of paying
+// submission overhead of three commands. Otherwise same three commands are
+// enqueued for each payload
+//
+// Commands are issued to an in-order queue ( on same device and context as
+// `q` ), so that they need not be chained explicitly
+class hash_graph
+{
+public:
+  hash_graph(sycl::queue& q,
+             const size_t chunk_count,
+             const bool record = true)
+    : q(q.get_context(), q.get_device(), sycl::property::queue::in_order())
+    , chunk_count(chunk_count)
+  {
+    assert(chunk_count >= 2);
+    assert((chunk_count & (chunk_count - 1)) == 0); // ensure power of 2
+
+    const size_t i_size = chunk_count * CHUNK_LEN;
+    const size_t mem_size = (chunk_count * OUT_LEN) << 1;
+
+    i_h = static_cast<sycl::uchar*>(sycl::malloc_host(i_size, this->q));
+    o_h = static_cast<sycl::uchar*>(sycl::malloc_host(OUT_LEN, this->q));
+    i_d = static_cast<sycl::uchar*>(sycl::malloc_device(i_size, this->q));
+    o_d = static_cast<sycl::uchar*>(sycl::malloc_device(OUT_LEN, this->q));
+    mem = static_cast<uint32_t*>(sycl::malloc_device(mem_size, this->q));
+
+#if defined SYCL_EXT_ONEAPI_GRAPH
+    if (record) {
+      sycl_graph::command_graph g{ this->q.get_context(),
+                                   this->q.get_device() };
+
+      g.begin_recording(this->q);
+      enqueue();
+      g.end_recording(this->q);
+
+      exec.emplace(g.finalize());
+    }
+#else
+    static_cast<void>(record);
+#endif
+  }
+
+  ~hash_graph()
+  {
+    sycl::free(i_h, q);
+    sycl::free(o_h, q);
+    sycl::free(i_d, q);
+    sycl::free(o_d, q);
+    sycl::free(mem, q);
+  }
+
+  hash_graph(const hash_graph&) = delete;
+  hash_graph& operator=(const hash_graph&) = delete;
+
+  // Pinned host buffer of ( chunk_count * 1024 ) -bytes, where next payload
+  // is to be written, before `replay( ... )`
+  sycl::uchar* payload() { return i_h; }
+
+  // 32 -bytes BLAKE3 digest of payload hashed by last `replay( ... )`
+  const sycl::uchar* digest() const { return o_h; }
+
+  // Whether command sequence is replayed from a recorded command graph
+  bool recorded() const
+  {
+#if defined SYCL_EXT_ONEAPI_GRAPH
+    return exec.has_value();
+#else
+    return false;
+#endif
+  }
+
+  // Hashes current content of payload buffer, waiting until digest is
+  // available in host memory
+  void replay()
+  {
+#if defined SYCL_EXT_ONEAPI_GRAPH
+    if (exec.has_value()) {
+      q.ext_oneapi_graph(*exec).wait();
+      return;
+    }
+#endif
+
+    enqueue().wait();
+  }
+
+private:
+  // Enqueues ( or records, while queue is in recording mode ) commands for
+  // hashing payload buffer, returning event of last one
+  sycl::event enqueue()
+  {
+    q.memcpy(i_d, i_h, chunk_count * CHUNK_LEN);
+    if (chunk_count < GRAPH_SMALL_CHUNKS) {
+      submit_hash_small<kernelBlake3GraphSmall>(
+        q, i_d, chunk_count, mem, o_d);
+    } else {
+      submit_hash<kernelBlake3Graph, false>(
+        q, i_d, nullptr, chunk_count, mem, o_d);
+    }
+    return q.memcpy(o_h, o_d, OUT_LEN);
+  }
+
+  sycl::queue q;
+  const size_t chunk_count;
+
+  sycl::uchar* i_h;
+  sycl::uchar* o_h;
+  sycl::uchar* i_d;
+  sycl::uchar* o_d;
+  uint32_t* mem;
+
+#if defined SYCL_EXT_ONEAPI_GRAPH
+  std::optional<sycl_graph::command_graph<sycl_graph::graph_state::executable>>
+    exec;
+#endif
+};
+}
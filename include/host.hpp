@@ -0,0 +1,237 @@
+#pragma once
+#include "simd.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+// BLAKE3 routines executed on host, used for those parts of hashing which are
+// too small to be worth offloading ( say last, possibly partial chunk of an
+// input, or a few parent nodes ), using `host_compress( ... )`
+namespace blake3 {
+
+// Four consecutive little endian bytes ( living in host memory ) are
+// interpreted as 32 -bit unsigned integer
+static inline uint32_t
+host_word_from_le_bytes(const sycl::uchar* const bytes)
+{
+  return static_cast<uint32_t>(bytes[3]) << 24 |
+         static_cast<uint32_t>(bytes[2]) << 16 |
+         static_cast<uint32_t>(bytes[1]) << 8 |
+         static_cast<uint32_t>(bytes[0]) << 0;
+}
+
+// Computes chaining value of one chunk ( living in host memory ), which may be
+// partial i.e. 0 <= len <= 1024, where last message block is zero padded and
+// compressed with its actual length; empty chunk is compressed as one empty
+// message block
+//
+// `flags` are additionally set when compressing last message block of chunk (
+// say ROOT, when whole input is just this chunk ), otherwise pass 0
+//
+// Resulting 32 -bytes chaining value is written to `cv`
+//
+// When `dst` is given, chunk is also copied there, one message block at a
+// time, right after that block is loaded for compression, so that input is
+// read from memory once, for both copy and hashing
+//
+// `key` is input chaining value of first message block, while `mode` flags are
+// set on every message block; defaults are for plain hashing, see derive.hpp
+// for derive_key mode
+void
+host_chunk_cv(const sycl::uchar* const data,
+              const size_t len,
+              const uint64_t chunk_idx,
+              const uint32_t flags,
+              uint32_t* const cv,
+              sycl::uchar* const dst = nullptr,
+              const uint32_t* const key = IV,
+              const uint32_t mode = 0)
+{
+  assert(len <= CHUNK_LEN);
+
+  uint32_t msg[16];
+  uint32_t state[16];
+  sycl::uchar block[BLOCK_LEN];
+
+  const size_t blk_cnt = len == 0 ? 1 : (len + BLOCK_LEN - 1) / BLOCK_LEN;
+
+  std::copy(key, key + 8, cv);
+
+  for (size_t j = 0; j < blk_cnt; j++) {
+    const size_t offset = j * BLOCK_LEN;
+    const size_t blk_len = std::min<size_t>(BLOCK_LEN, len - offset);
+
+    std::memset(block, 0, BLOCK_LEN);
+    if (blk_len > 0) {
+      std::memcpy(block, data + offset, blk_len);
+    }
+    if (dst != nullptr && blk_len > 0) {
+      std::memcpy(dst + offset, block, blk_len);
+    }
+
+    for (size_t i = 0; i < 16; i++) {
+      msg[i] = host_word_from_le_bytes(block + (i << 2));
+    }
+
+    std::copy(cv, cv + 8, state);
+    std::copy(IV, IV + 4, state + 8);
+
+    state[12] = static_cast<uint32_t>(chunk_idx & 0xffffffff);
+    state[13] = static_cast<uint32_t>(chunk_idx >> 32);
+    state[14] = static_cast<uint32_t>(blk_len);
+    state[15] = mode | (j == 0 ? CHUNK_START : 0) |
+                (j == blk_cnt - 1 ? CHUNK_END | flags : 0);
+
+    host_compress(state, msg);
+
+    std::copy(state, state + 8, cv);
+  }
+}
+
+// Computes parent chaining value of two children chaining values, writing it
+// to `cv` ( which may alias either child )
+//
+// `flags` are additionally set along with PARENT ( say ROOT, when computing
+// BLAKE3 digest ), otherwise pass 0; `key` and `mode` are same as for
+// `host_chunk_cv`
+void
+host_parent_cv(const uint32_t* const left,
+               const uint32_t* const right,
+               const uint32_t flags,
+               uint32_t* const cv,
+               const uint32_t* const key = IV,
+               const uint32_t mode = 0)
+{
+  uint32_t msg[16];
+  uint32_t state[16];
+
+  std::copy(left, left + 8, msg);
+  std::copy(right, right + 8, msg + 8);
+
+  std::copy(key, key + 8, state);
+  std::copy(IV, IV + 4, state + 8);
+
+  state[12] = 0;
+  state[13] = 0;
+  state[14] = BLOCK_LEN;
+  state[15] = PARENT | mode | flags;
+
+  host_compress(state, msg);
+
+  std::copy(state, state + 8, cv);
+}
+
+// Eight BLAKE3 words are converted to 32 little endian bytes, in host memory
+static inline void
+host_words_to_le_bytes(const uint32_t* const words, sycl::uchar* const bytes)
+{
+  for (size_t i = 0; i < 8; i++) {
+    for (size_t j = 0; j < 4; j++) {
+      bytes[(i << 2) + j] = static_cast<sycl::uchar>(words[i] >> (j << 3));
+    }
+  }
+}
+
+// Stack of chaining values, where i-th entry ( from bottom ) is root of a
+// complete subtree, which is bigger than subtree rooted at (i + 1)-th entry
+using cv_stack_t = std::vector<std::array<uint32_t, 8>>;
+
+// Pushes chaining value of next chunk into CV stack, where `chunk_cnt` is
+// number of chunks pushed so far ( including this one ), while merging
+// complete subtrees ( as many as there are trailing zero bits in `chunk_cnt` )
+//
+// See
+// https://github.com/BLAKE3-team/BLAKE3/blob/da4c792d8094f35c05c41c9aeb5dfe4aa67ca1ac/reference_impl/reference_impl.rs#L301-L313
+void
+cv_stack_push(cv_stack_t& stack,
+              const uint64_t chunk_cnt,
+              const uint32_t* const chunk_cv,
+              const uint32_t* const key = IV,
+              const uint32_t mode = 0)
+{
+  std::array<uint32_t, 8> cv;
+  std::copy(chunk_cv, chunk_cv + 8, cv.begin());
+
+  for (uint64_t n = chunk_cnt; (n & 1ul) == 0; n >>= 1) {
+    host_parent_cv(stack.back().data(), cv.data(), 0, cv.data(), key, mode);
+    stack.pop_back();
+  }
+
+  stack.push_back(cv);
+}
+
+// Computes 32 -bytes BLAKE3 digest of input, whose all chunks except last are
+// already pushed into CV stack, by compressing last ( possibly partial, or
+// empty, when input is empty ) chunk with counter `chunk_idx`, then folding CV
+// stack from its top, while setting ROOT flag on final compression
+//
+// When `dst` is given, last chunk is also copied there, see `host_chunk_cv`
+void
+cv_stack_root(const cv_stack_t& stack,
+              const sycl::uchar* const last,
+              const size_t len,
+              const uint64_t chunk_idx,
+              sycl::uchar* const digest,
+              sycl::uchar* const dst = nullptr,
+              const uint32_t* const key = IV,
+              const uint32_t mode = 0)
+{
+  uint32_t cv[8];
+
+  // when nothing was pushed, last chunk is whole input
+  host_chunk_cv(
+    last, len, chunk_idx, stack.empty() ? ROOT : 0, cv, dst, key, mode);
+
+  for (size_t i = stack.size(); i > 0; i--) {
+    host_parent_cv(stack[i - 1].data(), cv, i == 1 ? ROOT : 0, cv, key, mode);
+  }
+
+  host_words_to_le_bytes(cv, digest);
+}
+
+// Computes 32 -bytes BLAKE3 digest of `len` -bytes input ( living in host
+// memory ) on host, while copying it to `dst`, as one fused pass over input,
+// so that each message block is compressed while it's still in L1 cache,
+// instead of copying whole input first, then making a second pass over it
+//
+// When `dst` is nullptr, input is only hashed; `key` and `mode` are same as for
+// `host_chunk_cv`
+void
+host_hash_copy(const sycl::uchar* const src,
+               sycl::uchar* const dst,
+               const size_t len,
+               sycl::uchar* const digest,
+               const uint32_t* const key = IV,
+               const uint32_t mode = 0)
+{
+  const size_t cnt = len == 0 ? 0 : (len - 1) / CHUNK_LEN;
+
+  cv_stack_t stack;
+  uint32_t cv[8];
+
+  for (size_t j = 0; j < cnt; j++) {
+    const size_t offset = j * CHUNK_LEN;
+
+    host_chunk_cv(src + offset,
+                  CHUNK_LEN,
+                  j,
+                  0,
+                  cv,
+                  dst == nullptr ? nullptr : dst + offset,
+                  key,
+                  mode);
+    cv_stack_push(stack, j + 1, cv, key, mode);
+  }
+
+  const size_t last = cnt * CHUNK_LEN;
+  cv_stack_root(stack,
+                src + last,
+                len - last,
+                cnt,
+                digest,
+                dst == nullptr ? nullptr : dst + last,
+                key,
+                mode);
+}
+}
@@ -0,0 +1,276 @@
+#pragma once
+#include "blake3.hpp"
+
+namespace blake3 {
+
+// Just to avoid kernel name mangling in optimization report
+template<typename InPipe, typename OutPipe>
+class kernelBlake3IP;
+template<typename InPipe>
+class kernelBlake3IPFeed;
+template<typename OutPipe>
+class kernelBlake3IPDrain;
+
+// One beat of streaming input of BLAKE3 IP component, carrying one 64 -bytes
+// message block, modeled after Avalon-ST packet semantics ( valid byte count,
+// end-of-packet ), where a packet is one message to be hashed
+//
+// - `data` : message block bytes, in order
+// - `len` : number of valid bytes in `data`, which must be 64 for all beats,
+// except last beat of a message, which carries 1..64 bytes ( or 0, only when
+// whole message is empty, so that it's single beat )
+// - `eop` : set on last beat of a message
+struct ip_block_t
+{
+  sycl::uchar data[BLOCK_LEN];
+  uint8_t len;
+  bool eop;
+};
+
+// One beat of streaming output of BLAKE3 IP component, carrying 32 -bytes
+// digest of one message, in order of messages
+struct ip_digest_t
+{
+  sycl::uchar bytes[OUT_LEN];
+};
+
+// Maximum height of CV stack kept on-chip by IP component, which bounds
+// message length to 2 ^ 64 chunks
+constexpr size_t IP_STACK_HEIGHT = 64;
+
+// BLAKE3 IP component, which consumes message blocks from `InPipe` ( of type
+// `ip_block_t` ) and produces digest of each message into `OutPipe` ( of type
+// `ip_digest_t` ), so that it can be instantiated in a larger FPGA design (
+// say NIC or storage controller ) hashing data as it streams through, without
+// host launching a kernel over a global memory buffer
+//
+// Unlike `hash( ... )`, message length isn't known upfront and it's not
+// required to be power of 2 chunks; end of message is signaled by `eop`. So
+// chunk/ tree logic is same as `hash_many( ... )` parent kernel's i.e.
+// chaining value of a chunk is merged into on-chip CV stack as soon as it's
+// known that more input follows, while on `eop`, last chunk is compressed with
+// ROOT flag ( when it's only chunk ) or CV stack is folded into root
+//
+// Component stops after `msg_cnt` -many messages, which is what a testbench
+// needs; when generated through IP authoring flow, `msg_cnt` becomes an
+// argument of component's register map
+//
+// Note, message blocks of one message form a dependency chain through
+// chaining value, so one component sustains one message block per compression
+// latency; replicate it ( with its own pipes ) for higher line rate
+//
+// Note, `InPipe` and `OutPipe` are plain inter-kernel pipes ( on-chip FIFOs ),
+// connecting component to testbench's `feed_ip( ... )` and `drain_ip( ... )`
+// kernels. Generated RTL doesn't expose them as Avalon-ST ports; that needs
+// host/ IO pipes declared with streaming interface properties, which isn't
+// done here, so a design instantiating the component has to provide its own
+// pipe adapters
+template<typename InPipe, typename OutPipe>
+struct ip_component
+{
+  size_t msg_cnt;
+
+  void operator()() const
+  {
+    // CV stack, where i-th entry ( from bottom ) is root of a complete
+    // subtree, which is bigger than subtree rooted at (i + 1)-th entry
+    [[intel::fpga_memory("BLOCK_RAM")]] uint32_t stack[IP_STACK_HEIGHT][8];
+
+    [[intel::fpga_register]] uint32_t msg[16];
+    [[intel::fpga_register]] uint32_t state[16];
+    [[intel::fpga_register]] uint32_t cv[8];
+
+    sycl::private_ptr<uint32_t> msg_ptr{ msg };
+    sycl::private_ptr<uint32_t> state_ptr{ state };
+
+    for (size_t m = 0; m < msg_cnt; m++) {
+      size_t top = 0;
+      uint64_t chunk_idx = 0;
+      size_t blk_idx = 0;
+      bool eop = false;
+
+#pragma unroll 8
+      for (size_t i = 0; i < 8; i++) {
+        cv[i] = IV[i];
+      }
+
+      while (!eop) {
+        const ip_block_t beat = InPipe::read();
+        eop = beat.eop;
+
+#pragma unroll 16
+        for (size_t i = 0; i < 16; i++) {
+          msg_ptr[i] = static_cast<uint32_t>(beat.data[(i << 2) + 3]) << 24 |
+                       static_cast<uint32_t>(beat.data[(i << 2) + 2]) << 16 |
+                       static_cast<uint32_t>(beat.data[(i << 2) + 1]) << 8 |
+                       static_cast<uint32_t>(beat.data[(i << 2) + 0]) << 0;
+        }
+
+#pragma unroll 8
+        for (size_t i = 0; i < 8; i++) {
+          state_ptr[i] = cv[i];
+        }
+#pragma unroll 4
+        for (size_t i = 0; i < 4; i++) {
+          state_ptr[8 + i] = IV[i];
+        }
+
+        const bool chunk_end = blk_idx == 15 || eop;
+
+        state_ptr[12] = static_cast<uint32_t>(chunk_idx & 0xffffffff);
+        state_ptr[13] = static_cast<uint32_t>(chunk_idx >> 32);
+        state_ptr[14] = static_cast<uint32_t>(beat.len);
+        state_ptr[15] = (blk_idx == 0 ? CHUNK_START : 0) |
+                        (chunk_end ? CHUNK_END : 0) |
+                        (eop && chunk_idx == 0 ? ROOT : 0);
+
+        compress(state_ptr, msg_ptr);
+
+#pragma unroll 8
+        for (size_t i = 0; i < 8; i++) {
+          cv[i] = state_ptr[i];
+        }
+
+        if (chunk_end && !eop) {
+          // more input follows, so this chunk isn't root; as many merges as
+          // there are trailing zero bits in number of chunks seen so far
+          for (uint64_t n = chunk_idx + 1; (n & 1ul) == 0; n >>= 1) {
+            top--;
+
+#pragma unroll 8
+            for (size_t i = 0; i < 8; i++) {
+              msg_ptr[i] = stack[top][i];
+              msg_ptr[8 + i] = cv[i];
+            }
+
+            compress_parent(state_ptr, msg_ptr, 0);
+
+#pragma unroll 8
+            for (size_t i = 0; i < 8; i++) {
+              cv[i] = state_ptr[i];
+            }
+          }
+
+#pragma unroll 8
+          for (size_t i = 0; i < 8; i++) {
+            stack[top][i] = cv[i];
+            cv[i] = IV[i];
+          }
+          top++;
+
+          chunk_idx++;
+          blk_idx = 0;
+        } else {
+          blk_idx++;
+        }
+      }
+
+      // folding CV stack from its top, setting ROOT flag on last merge
+      for (size_t t = top; t > 0; t--) {
+#pragma unroll 8
+        for (size_t i = 0; i < 8; i++) {
+          msg_ptr[i] = stack[t - 1][i];
+          msg_ptr[8 + i] = cv[i];
+        }
+
+        compress_parent(state_ptr, msg_ptr, t == 1 ? ROOT : 0);
+
+#pragma unroll 8
+        for (size_t i = 0; i < 8; i++) {
+          cv[i] = state_ptr[i];
+        }
+      }
+
+      ip_digest_t digest;
+#pragma unroll 8
+      for (size_t i = 0; i < 8; i++) {
+#pragma unroll 4
+        for (size_t j = 0; j < 4; j++) {
+          digest.bytes[(i << 2) + j] =
+            static_cast<sycl::uchar>(cv[i] >> (j << 3));
+        }
+      }
+
+      OutPipe::write(digest);
+    }
+  }
+};
+
+// Launches BLAKE3 IP component, as a kernel, consuming `msg_cnt` -many
+// messages from `InPipe`, producing their digests into `OutPipe`
+template<typename InPipe, typename OutPipe>
+sycl::event
+launch_ip(sycl::queue& q, const size_t msg_cnt)
+{
+  return q.single_task<kernelBlake3IP<InPipe, OutPipe>>(
+    ip_component<InPipe, OutPipe>{ msg_cnt });
+}
+
+// Streaming testbench source, which splits `msg_cnt` -many messages, living
+// consecutively in `input` ( device memory ), where i-th message is `lens[i]`
+// -bytes, into 64 -bytes beats, writing them into `InPipe`
+template<typename InPipe>
+sycl::event
+feed_ip(sycl::queue& q,
+        sycl::uchar* const __restrict input, // it'll never be modified !
+        size_t* const __restrict lens,       // msg_cnt -many lengths
+        const size_t msg_cnt)
+{
+  return q.single_task<kernelBlake3IPFeed<InPipe>>(
+    [=]() [[intel::kernel_args_restrict]] {
+      // Just to hint that Load Store Units don't need to interface with host
+      sycl::device_ptr<sycl::uchar> i_ptr{ input };
+      sycl::device_ptr<size_t> l_ptr{ lens };
+
+      size_t offset = 0;
+
+      for (size_t m = 0; m < msg_cnt; m++) {
+        const size_t len = l_ptr[m];
+        const size_t blk_cnt =
+          len == 0 ? 1 : (len + BLOCK_LEN - 1) / BLOCK_LEN;
+
+        for (size_t b = 0; b < blk_cnt; b++) {
+          const size_t blk_off = b * BLOCK_LEN;
+          const size_t blk_len =
+            len - blk_off < BLOCK_LEN ? len - blk_off : BLOCK_LEN;
+
+          ip_block_t beat;
+#pragma unroll 64
+          for (size_t i = 0; i < BLOCK_LEN; i++) {
+            beat.data[i] = i < blk_len ? i_ptr[offset + blk_off + i] : 0;
+          }
+          beat.len = static_cast<uint8_t>(blk_len);
+          beat.eop = b == blk_cnt - 1;
+
+          InPipe::write(beat);
+        }
+
+        offset += len;
+      }
+    });
+}
+
+// Streaming testbench sink, which reads `msg_cnt` -many digests from
+// `OutPipe`, writing them consecutively into `digests` ( device memory )
+template<typename OutPipe>
+sycl::event
+drain_ip(sycl::queue& q,
+         sycl::uchar* const __restrict digests, // msg_cnt x 32 -bytes
+         const size_t msg_cnt)
+{
+  return q.single_task<kernelBlake3IPDrain<OutPipe>>(
+    [=]() [[intel::kernel_args_restrict]] {
+      // Just to hint that Load Store Units don't need to interface with host
+      sycl::device_ptr<sycl::uchar> o_ptr{ digests };
+
+      for (size_t m = 0; m < msg_cnt; m++) {
+        const ip_digest_t digest = OutPipe::read();
+
+#pragma unroll 32
+        for (size_t i = 0; i < OUT_LEN; i++) {
+          o_ptr[m * OUT_LEN + i] = digest.bytes[i];
+        }
+      }
+    });
+}
+}
@@ -0,0 +1,235 @@
+#pragma once
+#include "blake3.hpp"
+
+namespace blake3 {
+
+// Just to avoid kernel name mangling in optimization report, one per number of
+// lanes, so that many variants can live in same binary
+template<size_t lanes>
+class kernelBlake3HashIterative;
+
+// Default number of iterative compress cores, see board.hpp
+constexpr size_t ITER_LANES = BOARD.iter_lanes;
+
+// Number of chunks each iterative core keeps in flight, interleaving their
+// half-rounds, so that next half-round of a chunk starts only after previous
+// one ( a few cycles of latency ) has been written back
+constexpr size_t ITER_CONTEXTS = 8;
+
+// Each round is evaluated as two half-rounds i.e. column step, then diagonal
+// step, each applying four `g( ... )` in parallel
+constexpr size_t HALF_ROUNDS = ROUNDS << 1;
+
+// Compile time check for number of iterative cores, to ensure that it's power
+// of 2 and all cores, with all of their contexts, can be kept busy by minimum
+// chunk count ( = 2^10 )
+static constexpr bool
+is_valid_iter_lanes(const size_t lanes)
+{
+  return lanes > 0 && (lanes & (lanes - 1)) == 0 &&
+         lanes * ITER_CONTEXTS <= (1ul << 10);
+}
+
+// One half-round of BLAKE3 round function, which mixes eight message words into
+// hash state either column-wise ( when `diagonal` is false, using message words
+// [0, 8) ) or diagonally ( using message words [8, 16) ), using only four
+// `g( ... )` for both
+//
+// Diagonal step is column step over hash state, whose i-th row is rotated left
+// by i words, so rows are rotated before and after mixing ( just wiring and
+// 2:1 multiplexers ), instead of synthesizing another four `g( ... )`
+inline void
+half_round(sycl::private_ptr<uint32_t> state,
+           sycl::private_ptr<uint32_t> msg,
+           const bool diagonal)
+{
+  [[intel::fpga_register]] uint32_t v[16];
+  sycl::private_ptr<uint32_t> v_ptr{ v };
+
+#pragma unroll 4
+  for (size_t r = 0; r < 4; r++) {
+#pragma unroll 4
+    for (size_t i = 0; i < 4; i++) {
+      v_ptr[(r << 2) + i] = state[(r << 2) + ((i + (diagonal ? r : 0)) & 3)];
+    }
+  }
+
+  const size_t m = diagonal ? 8 : 0;
+
+  g(v_ptr, 0, 4, 8, 12, msg[m + 0], msg[m + 1]);
+  g(v_ptr, 1, 5, 9, 13, msg[m + 2], msg[m + 3]);
+  g(v_ptr, 2, 6, 10, 14, msg[m + 4], msg[m + 5]);
+  g(v_ptr, 3, 7, 11, 15, msg[m + 6], msg[m + 7]);
+
+#pragma unroll 4
+  for (size_t r = 0; r < 4; r++) {
+#pragma unroll 4
+    for (size_t i = 0; i < 4; i++) {
+      state[(r << 2) + ((i + (diagonal ? r : 0)) & 3)] = v_ptr[(r << 2) + i];
+    }
+  }
+}
+
+// BLAKE3 hash function, which computes same digest as `hash( ... )`, where
+// chunks are compressed by `lanes` -many small, iterative compress cores,
+// instead of a few fully unrolled ones
+//
+// `compress( ... )` unrolls 7 rounds of 8 `g( ... )`, so it compresses one
+// message block per cycle, but its area caps how many times it can be
+// replicated. Iterative core evaluates one half-round ( four `g( ... )` ) per
+// cycle, so it needs 14 cycles per message block, for roughly 1/14 of area,
+// letting it be replicated many more times
+//
+// Each core keeps `ITER_CONTEXTS` chunks in flight ( hash state and message
+// words in on-chip memory ), round robin scheduling their half-rounds, so that
+// loop carried dependency on hash state is `ITER_CONTEXTS` iterations apart.
+// Whole chunk is compressed without leaving chip, so only its output chaining
+// value is written to global memory, then parent nodes are computed by
+// `merkelize( ... )`, same as `hash( ... )` does
+//
+// Same input constraints as `hash( ... )` apply
+template<size_t lanes = ITER_LANES>
+void
+hash_iterative(sycl::queue& q,                       // SYCL compute queue
+               sycl::uchar* const __restrict input,  // never modified !
+               const size_t i_size,                  // bytes
+               const size_t chunk_count,             // power of 2
+               sycl::uchar* const __restrict digest, // 32 -bytes BLAKE3 digest
+               sycl::cl_ulong* const __restrict ts   // kernel exec time in `ns`
+               ) requires(is_valid_iter_lanes(lanes))
+{
+  assert(i_size == chunk_count * CHUNK_LEN);
+  assert(chunk_count >= (1 << 10));
+  assert((chunk_count & (chunk_count - 1)) == 0); // ensure power of 2
+
+  // same layout of intermediate chaining values as `hash( ... )` uses
+  const size_t mem_size = (chunk_count * OUT_LEN) << 1;
+  uint32_t* mem = static_cast<uint32_t*>(sycl::malloc_device(mem_size, q));
+
+  sycl::event evt = q.single_task<kernelBlake3HashIterative<lanes>>(
+    [=]() [[intel::kernel_args_restrict]] {
+      // Just to hint that Load Store Units don't need to interface with host
+      sycl::device_ptr<sycl::uchar> i_ptr{ input };
+      sycl::device_ptr<uint32_t> mem_ptr{ mem };
+      sycl::device_ptr<sycl::uchar> o_ptr{ digest };
+
+      // hash state and message words of each chunk in flight
+      [[intel::fpga_memory]] uint32_t ctx_state[lanes][ITER_CONTEXTS][16];
+      [[intel::fpga_memory]] uint32_t ctx_msg[lanes][ITER_CONTEXTS][16];
+
+      [[intel::fpga_register]] uint32_t msg[lanes][16];
+      [[intel::fpga_register]] uint32_t state[lanes][16];
+
+      const size_t o_offset = chunk_count << 3;
+
+      // chunks compressed together, by all contexts of all cores
+      constexpr size_t grp_size = lanes * ITER_CONTEXTS;
+      const size_t itr_cnt = (chunk_count / grp_size) * ITER_CONTEXTS *
+                             HALF_ROUNDS * (CHUNK_LEN / BLOCK_LEN);
+
+      size_t grp_idx = 0;
+      size_t msg_blk_idx = 0;
+      size_t h = 0; // half-round
+      size_t k = 0; // context
+
+      [[intel::ivdep(ITER_CONTEXTS)]] for (size_t c = 0; c < itr_cnt; c++)
+      {
+#pragma unroll
+        for (size_t l = 0; l < lanes; l++) {
+          sycl::private_ptr<uint32_t> state_ptr{ state[l] };
+          sycl::private_ptr<uint32_t> msg_ptr{ msg[l] };
+
+          const size_t chunk_idx = grp_idx * grp_size + k * lanes + l;
+
+          if (h == 0) {
+            // new message block, whose input chaining value is either constant
+            // initial hash values or output chaining value of previous block
+#pragma unroll 8
+            for (size_t i = 0; i < 8; i++) {
+              state_ptr[i] = msg_blk_idx == 0 ? IV[i] : ctx_state[l][k][i];
+            }
+#pragma unroll 4
+            for (size_t i = 0; i < 4; i++) {
+              state_ptr[8 + i] = IV[i];
+            }
+
+            state_ptr[12] = static_cast<uint32_t>(chunk_idx & 0xffffffff);
+            state_ptr[13] = static_cast<uint32_t>(chunk_idx >> 32);
+            state_ptr[14] = BLOCK_LEN;
+            state_ptr[15] = (msg_blk_idx == 0 ? CHUNK_START : 0) |
+                            (msg_blk_idx == 15 ? CHUNK_END : 0);
+
+            const size_t i_offset = (chunk_idx << 10) + (msg_blk_idx << 6);
+
+#pragma unroll 16
+            for (size_t i = 0; i < 16; i++) {
+              msg_ptr[i] = word_from_le_bytes(i_ptr + i_offset + (i << 2));
+            }
+          } else {
+#pragma unroll 16
+            for (size_t i = 0; i < 16; i++) {
+              state_ptr[i] = ctx_state[l][k][i];
+              msg_ptr[i] = ctx_msg[l][k][i];
+            }
+          }
+
+          half_round(state_ptr, msg_ptr, (h & 1) == 1);
+
+          // message words are permuted after each round, except last one
+          if ((h & 1) == 1 && h + 1 < HALF_ROUNDS) {
+            permute(msg_ptr);
+          }
+
+          if (h + 1 == HALF_ROUNDS) {
+#pragma unroll 8
+            for (size_t i = 0; i < 8; i++) {
+              state_ptr[i] ^= state_ptr[8 + i];
+            }
+
+            // only chunk's output chaining value leaves chip
+            if (msg_blk_idx == 15) {
+#pragma unroll 8
+              for (size_t i = 0; i < 8; i++) {
+                mem_ptr[o_offset + (chunk_idx << 3) + i] = state_ptr[i];
+              }
+            }
+          }
+
+#pragma unroll 16
+          for (size_t i = 0; i < 16; i++) {
+            ctx_state[l][k][i] = state_ptr[i];
+            ctx_msg[l][k][i] = msg_ptr[i];
+          }
+        }
+
+        // round robin over contexts, then next half-round/ message block/
+        // group of chunks
+        if (k + 1 < ITER_CONTEXTS) {
+          k++;
+        } else if (h + 1 < HALF_ROUNDS) {
+          k = 0;
+          h++;
+        } else if (msg_blk_idx < 15) {
+          k = 0;
+          h = 0;
+          msg_blk_idx++;
+        } else {
+          k = 0;
+          h = 0;
+          msg_blk_idx = 0;
+          grp_idx++;
+        }
+      }
+
+      // parent chaining values, finally root chaining value
+      merkelize(mem_ptr, o_ptr, chunk_count);
+    });
+
+  evt.wait();
+  sycl::free(mem, q);
+
+  if (ts != nullptr) {
+    *ts = time_event(evt);
+  }
+}
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "blake3.hpp"
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace blake3 {
+
+// Registers existing host allocation ( say mmap-ed file ) with SYCL runtime
+// for its whole lifetime, so that copies from/ to it are DMA-ed directly,
+// instead of being bounced through runtime's own pinned staging buffer
+//
+// Registration is done using `sycl_ext_oneapi_copy_optimize` extension, when
+// SYCL implementation supports it; otherwise it's a no-op, in which case
+// copies still work, but runtime may stage them internally
+//
+// Memory must stay mapped until registration is released i.e. until this
+// object is destroyed
+class host_registration
+{
+public:
+  host_registration(sycl::queue& q, void* const ptr, const size_t size)
+    : q(q)
+    , ptr(ptr)
+  {
+#if defined SYCL_EXT_ONEAPI_COPY_OPTIMIZE
+    sycl::ext::oneapi::experimental::prepare_for_device_copy(ptr, size, q);
+#endif
+  }
+
+  ~host_registration()
+  {
+#if defined SYCL_EXT_ONEAPI_COPY_OPTIMIZE
+    sycl::ext::oneapi::experimental::release_from_device_copy(ptr, q);
+#endif
+  }
+
+  host_registration(const host_registration&) = delete;
+  host_registration& operator=(const host_registration&) = delete;
+
+private:
+  // only used when registration extension is available
+  [[maybe_unused]] sycl::queue& q;
+  [[maybe_unused]] void* const ptr;
+};
+
+// Computes BLAKE3 digest of file, by mapping it into memory and uploading it
+// to device straight from page cache, without first copying it into pinned
+// staging buffer ( see `host_registration` )
+//
+// Same constraints as `hash`, apply to file size; if file size doesn't satisfy
+// them, returns false with `errno` set to EINVAL, otherwise returns false on
+// I/O error ( `errno` set by failing call )
+bool
+hash_file_mapped(sycl::queue& q,
+                 const int fd,
+                 sycl::uchar* const __restrict digest, // 32 -bytes, on host
+                 sycl::cl_ulong* const __restrict ts   // kernel exec time
+)
+{
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    return false;
+  }
+
+  const size_t f_size = static_cast<size_t>(st.st_size);
+  const size_t chunk_count = f_size / CHUNK_LEN;
+
+  if (f_size != chunk_count * CHUNK_LEN || chunk_count < (1 << 10) ||
+      (chunk_count & (chunk_count - 1)) != 0) {
+    errno = EINVAL;
+    return false;
+  }
+
+  void* mapped = mmap(nullptr, f_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+
+  // whole file is read once, front to back
+  madvise(mapped, f_size, MADV_SEQUENTIAL);
+
+  sycl::uchar* input_d =
+    static_cast<sycl::uchar*>(sycl::malloc_device(f_size, q));
+  sycl::uchar* digest_d =
+    static_cast<sycl::uchar*>(sycl::malloc_device(OUT_LEN, q));
+
+  {
+    // registration must be released before memory is unmapped
+    host_registration reg{ q, mapped, f_size };
+
+    q.memcpy(input_d, mapped, f_size).wait();
+  }
+
+  munmap(mapped, f_size);
+
+  hash(q, input_d, f_size, chunk_count, digest_d, ts);
+  q.memcpy(digest, digest_d, OUT_LEN).wait();
+
+  sycl::free(input_d, q);
+  sycl::free(digest_d, q);
+
+  return true;
+}
+}
@@ -0,0 +1,334 @@
+#pragma once
+#include "batch.hpp"
+#include "host.hpp"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace blake3 {
+
+// Just to avoid kernel name mangling in optimization report
+class kernelBlake3MultipartCVs;
+
+// Default maximum number of chunks compressed in one kernel launch, by
+// multipart assembler
+constexpr size_t MULTIPART_BATCH_CHUNKS = 1 << 12;
+
+// Assembles BLAKE3 digest of an object, uploaded in parts, which arrive out of
+// order ( and possibly from many threads ), without ever re-reading data of
+// a part, after it's been added
+//
+// When a part arrives, all chunks lying fully inside it are compressed on
+// accelerator ( using their chunk counter in object ), then their chaining
+// values are merged on host into roots of maximal aligned complete subtrees
+// i.e. [k * 2^m, (k + 1) * 2^m) chunk ranges, which are nodes of final tree,
+// no matter how large the object turns out to be. Only those subtree roots are
+// kept
+//
+// Chunks which aren't fully inside one part ( because part boundary isn't
+// chunk aligned ) are deferred, their bytes are collected from both parts.
+// First chunk is always deferred, because it's root when object is at most one
+// chunk. On `finalize( ... )`, deferred chunks are compressed on host, then
+// subtree roots are merged, from left to right, into root
+//
+// Parts may be added concurrently, each call stages its chunks in its own set
+// of pinned host and device buffers ( taken from a pool, which grows to number
+// of concurrent callers ), so uploads and kernel launches of different parts
+// overlap; lock is only held while recording subtree roots and fragments
+//
+// Parts must not overlap
+class multipart_assembler
+{
+public:
+  multipart_assembler(sycl::queue& q,
+                      const size_t max_chunks = MULTIPART_BATCH_CHUNKS)
+    : q(q)
+    , max_chunks(max_chunks)
+  {
+    // enough for single threaded use, so it never allocates while hashing
+    pool.push_back(std::make_unique<staging_t>(q, max_chunks));
+  }
+
+  multipart_assembler(const multipart_assembler&) = delete;
+  multipart_assembler& operator=(const multipart_assembler&) = delete;
+
+  // Hashes part of `len` -bytes, living at byte `offset` of object, keeping
+  // only roots of its complete subtrees and bytes of its boundary chunks
+  void add_part(const uint64_t offset,
+                const sycl::uchar* const data,
+                const size_t len)
+  {
+    const uint64_t end = offset + len;
+
+    // chunks lying fully inside this part, except first chunk of object
+    uint64_t first = (offset + CHUNK_LEN - 1) / CHUNK_LEN;
+    first = std::max<uint64_t>(first, 1);
+    const uint64_t last = end / CHUNK_LEN;
+
+    std::vector<subtree_t> roots;
+    if (first < last) {
+      std::unique_ptr<staging_t> st = acquire();
+      for (uint64_t c = first; c < last; c += max_chunks) {
+        const size_t cnt = std::min<uint64_t>(max_chunks, last - c);
+        hash_chunks(*st, c, data + (c * CHUNK_LEN - offset), cnt, roots);
+      }
+      release(std::move(st));
+    }
+
+    std::lock_guard<std::mutex> lock{ mtx };
+
+    for (const subtree_t& t : roots) {
+      subtrees[t.first] = t.second;
+    }
+
+    if (first < last) {
+      defer(offset, std::min(end, first * CHUNK_LEN), data);
+      defer(std::max(offset, last * CHUNK_LEN),
+            end,
+            data + (std::max(offset, last * CHUNK_LEN) - offset));
+    } else {
+      defer(offset, end, data);
+    }
+  }
+
+  // Computes 32 -bytes BLAKE3 digest of object of `total` -bytes, when all of
+  // its parts have been added
+  //
+  // Returns false, when some byte of object hasn't been added yet
+  bool finalize(const uint64_t total, sycl::uchar* const digest)
+  {
+    std::lock_guard<std::mutex> lock{ mtx };
+
+    const uint64_t chunk_cnt =
+      total == 0 ? 1 : (total + CHUNK_LEN - 1) / CHUNK_LEN;
+
+    // ( size in chunks, chaining value ) of subtrees, from left to right
+    std::vector<std::pair<uint64_t, std::array<uint32_t, 8>>> stack;
+
+    uint64_t c = 0;
+    while (c < chunk_cnt) {
+      const auto s_it = subtrees.find(c);
+      if (s_it != subtrees.end()) {
+        push(stack, s_it->second.first, s_it->second.second, chunk_cnt);
+        c += s_it->second.first;
+        continue;
+      }
+
+      const size_t len = static_cast<size_t>(
+        std::min<uint64_t>(CHUNK_LEN, total - c * CHUNK_LEN));
+
+      const auto f_it = fragments.find(c);
+      const bool found = f_it != fragments.end();
+      if ((found ? f_it->second.second : 0) != len) {
+        return false;
+      }
+
+      std::array<uint32_t, 8> cv;
+      host_chunk_cv(found ? f_it->second.first.data() : nullptr,
+                    len,
+                    c,
+                    chunk_cnt == 1 ? ROOT : 0,
+                    cv.data());
+
+      push(stack, 1, cv, chunk_cnt);
+      c++;
+    }
+
+    // fold remaining subtrees, from right to left, setting ROOT flag on last
+    // merge; nothing to fold, when object is a single chunk
+    std::array<uint32_t, 8> cv = stack.back().second;
+    for (size_t i = stack.size() - 1; i > 0; i--) {
+      host_parent_cv(
+        stack[i - 1].second.data(), cv.data(), i == 1 ? ROOT : 0, cv.data());
+    }
+
+    host_words_to_le_bytes(cv.data(), digest);
+    return true;
+  }
+
+  // Forgets all parts added so far, so that assembler ( along with its pinned
+  // buffers ) can be reused for next object
+  void reset()
+  {
+    std::lock_guard<std::mutex> lock{ mtx };
+
+    subtrees.clear();
+    fragments.clear();
+  }
+
+private:
+  // first chunk -> ( size in chunks, chaining value ) of complete subtree
+  using subtree_t =
+    std::pair<uint64_t, std::pair<uint64_t, std::array<uint32_t, 8>>>;
+
+  // Pinned host and device buffers, where one part's chunks are staged, for
+  // hashing upto `max_chunks` -many of them in one kernel launch
+  struct staging_t
+  {
+    staging_t(sycl::queue& q, const size_t max_chunks)
+      : q(q)
+    {
+      chunks_h = static_cast<sycl::uchar*>(
+        sycl::malloc_host(max_chunks * CHUNK_LEN, q));
+      counters_h = static_cast<uint64_t*>(
+        sycl::malloc_host(max_chunks * sizeof(uint64_t), q));
+      cvs_h =
+        static_cast<uint32_t*>(sycl::malloc_host(max_chunks * OUT_LEN, q));
+
+      chunks_d = static_cast<sycl::uchar*>(
+        sycl::malloc_device(max_chunks * CHUNK_LEN, q));
+      counters_d = static_cast<uint64_t*>(
+        sycl::malloc_device(max_chunks * sizeof(uint64_t), q));
+      cvs_d =
+        static_cast<uint32_t*>(sycl::malloc_device(max_chunks * OUT_LEN, q));
+    }
+
+    ~staging_t()
+    {
+      sycl::free(chunks_h, q);
+      sycl::free(counters_h, q);
+      sycl::free(cvs_h, q);
+      sycl::free(chunks_d, q);
+      sycl::free(counters_d, q);
+      sycl::free(cvs_d, q);
+    }
+
+    staging_t(const staging_t&) = delete;
+    staging_t& operator=(const staging_t&) = delete;
+
+    sycl::queue& q;
+    sycl::uchar* chunks_h;
+    uint64_t* counters_h;
+    uint32_t* cvs_h;
+    sycl::uchar* chunks_d;
+    uint64_t* counters_d;
+    uint32_t* cvs_d;
+  };
+
+  // Takes a set of staging buffers from pool, allocating one, when all of them
+  // are in use by concurrent callers
+  std::unique_ptr<staging_t> acquire()
+  {
+    {
+      std::lock_guard<std::mutex> lock{ pool_mtx };
+      if (!pool.empty()) {
+        std::unique_ptr<staging_t> st = std::move(pool.back());
+        pool.pop_back();
+        return st;
+      }
+    }
+
+    return std::make_unique<staging_t>(q, max_chunks);
+  }
+
+  // Returns set of staging buffers to pool, for reuse by later parts
+  void release(std::unique_ptr<staging_t> st)
+  {
+    std::lock_guard<std::mutex> lock{ pool_mtx };
+    pool.push_back(std::move(st));
+  }
+
+  // Compresses `cnt` -many full chunks, starting at chunk `first` of object,
+  // on accelerator ( staged in `st` ), then merges their chaining values into
+  // roots of maximal aligned complete subtrees, appending them to `roots`
+  void hash_chunks(staging_t& st,
+                   const uint64_t first,
+                   const sycl::uchar* const data,
+                   const size_t cnt,
+                   std::vector<subtree_t>& roots)
+  {
+    std::memcpy(st.chunks_h, data, cnt * CHUNK_LEN);
+    for (size_t i = 0; i < cnt; i++) {
+      st.counters_h[i] = first + i;
+    }
+
+    q.memcpy(st.chunks_d, st.chunks_h, cnt * CHUNK_LEN).wait();
+    q.memcpy(st.counters_d, st.counters_h, cnt * sizeof(uint64_t)).wait();
+    submit_chunk_cvs<kernelBlake3MultipartCVs, false>(
+      q, st.chunks_d, nullptr, st.counters_d, cnt, st.cvs_d)
+      .wait();
+    q.memcpy(st.cvs_h, st.cvs_d, cnt * OUT_LEN).wait();
+
+    uint64_t c = first;
+    while (c < first + cnt) {
+      // largest power of 2, which c is aligned to and which fits in range
+      uint64_t size = c & (~c + 1);
+      while (c + size > first + cnt) {
+        size >>= 1;
+      }
+
+      // merging chaining values of subtree, level by level, in place
+      uint32_t* const cvs = st.cvs_h + ((c - first) << 3);
+      for (uint64_t n = size; n > 1; n >>= 1) {
+        for (uint64_t i = 0; i < n; i += 2) {
+          host_parent_cv(
+            cvs + (i << 3), cvs + ((i + 1) << 3), 0, cvs + (i << 2));
+        }
+      }
+
+      std::array<uint32_t, 8> cv;
+      std::copy(cvs, cvs + 8, cv.begin());
+      roots.push_back({ c, { size, cv } });
+
+      c += size;
+    }
+  }
+
+  // Copies bytes [begin, end) of object ( starting at `data` ), which belong
+  // to deferred chunks, into their fragments
+  void defer(uint64_t begin, const uint64_t end, const sycl::uchar* data)
+  {
+    while (begin < end) {
+      const uint64_t c = begin / CHUNK_LEN;
+      const size_t off = static_cast<size_t>(begin - c * CHUNK_LEN);
+      const size_t len =
+        static_cast<size_t>(std::min<uint64_t>(CHUNK_LEN - off, end - begin));
+
+      fragment_t& f = fragments[c];
+      std::memcpy(f.first.data() + off, data, len);
+      f.second += len;
+
+      begin += len;
+      data += len;
+    }
+  }
+
+  // Pushes subtree root ( of `size` chunks ) into stack, while merging equal
+  // sized, adjacent subtrees, unless merged one would be whole object ( of
+  // `chunk_cnt` chunks ), which must be merged with ROOT flag
+  static void push(
+    std::vector<std::pair<uint64_t, std::array<uint32_t, 8>>>& stack,
+    uint64_t size,
+    std::array<uint32_t, 8> cv,
+    const uint64_t chunk_cnt)
+  {
+    while (!stack.empty() && stack.back().first == size &&
+           !(stack.size() == 1 && (size << 1) == chunk_cnt)) {
+      host_parent_cv(stack.back().second.data(), cv.data(), 0, cv.data());
+      stack.pop_back();
+      size <<= 1;
+    }
+
+    stack.emplace_back(size, cv);
+  }
+
+  // ( bytes of chunk, number of bytes collected so far )
+  using fragment_t = std::pair<std::array<sycl::uchar, CHUNK_LEN>, size_t>;
+
+  sycl::queue& q;
+  const size_t max_chunks;
+
+  // guards `subtrees` and `fragments`
+  std::mutex mtx;
+
+  // first chunk -> ( size in chunks, chaining value ) of complete subtrees
+  std::map<uint64_t, std::pair<uint64_t, std::array<uint32_t, 8>>> subtrees;
+  // chunk index -> fragment of deferred chunks
+  std::map<uint64_t, fragment_t> fragments;
+
+  // staging buffers not in use, reused across parts and objects
+  std::mutex pool_mtx;
+  std::vector<std::unique_ptr<staging_t>> pool;
+};
+}
@@ -0,0 +1,416 @@
+#pragma once
+#include "batch.hpp"
+#include "host.hpp"
+#include <cerrno>
+#include <future>
+#include <unistd.h>
+#include <vector>
+
+namespace blake3 {
+
+// Just to avoid kernel name mangling in optimization report
+class kernelBlake3PackCVs;
+
+// Default capacity of each of two staging arenas of pack writer
+constexpr size_t PACK_ARENA_SIZE = 1 << 26;
+
+// Default size ( in bytes ) upto which pack writer hashes object on host, while
+// copying it into staging arena; below this, launch and transfer overhead of
+// hashing on accelerator outweighs host compression cost
+constexpr size_t PACK_HOST_HASH_MAX = 1 << 14;
+
+// Maximum gap ( in bytes ) between uploaded ranges of two objects hashed on
+// accelerator, which is uploaded along with them, so that both go in one copy;
+// below this, setup cost of another DMA transfer outweighs moving few more
+// bytes ( say last chunk of former object, or small objects hashed on host )
+constexpr size_t PACK_UPLOAD_GAP = 1 << 16;
+
+// One entry of pack index, mapping BLAKE3 digest of object to its location in
+// pack file, as written to index file ( in host byte order )
+struct pack_index_entry_t
+{
+  sycl::uchar digest[32];
+  uint64_t offset; // bytes, from start of pack file
+  uint64_t length; // bytes
+};
+
+// Writes objects of a content-addressed store into an append-only pack file,
+// while appending ( digest -> offset ) entries to an index file
+//
+// Objects are accumulated in a pinned staging arena. Objects of at most
+// `host_hash_max` -bytes are hashed on host, in same pass which copies them
+// into arena ( see `host_hash_copy` ), so they're never uploaded. Larger ones
+// start at a 1024 -bytes boundary. When arena can't take next object ( or on
+// `flush( ... )` ), all objects in arena form a batch, whose full chunks (
+// except last chunk of each larger object ) are hashed in one kernel launch (
+// see `submit_chunk_cvs` ), while last chunks and parent nodes are compressed
+// on host
+//
+// There are two arenas, so that while batch k is being written to pack and
+// index files ( on a separate thread ), objects of batch (k + 1) are
+// accumulated and hashed in other arena
+//
+// Objects larger than arena are rejected, so arena size bounds maximum object
+// size
+//
+// Failing write of some batch is sticky, pack and index files are truncated
+// back to where that batch started ( so that they stay in sync ), and every
+// later `add( ... )` or `flush( ... )` fails with `errno` of that write
+class pack_writer
+{
+public:
+  pack_writer(sycl::queue& q,
+              const int pack_fd,
+              const int index_fd,
+              const size_t arena_size = PACK_ARENA_SIZE,
+              const size_t host_hash_max = PACK_HOST_HASH_MAX)
+    : q(q)
+    , pack_fd(pack_fd)
+    , index_fd(index_fd)
+    , arena_size(arena_size)
+    , host_hash_max(host_hash_max)
+  {
+    assert(arena_size % CHUNK_LEN == 0);
+
+    // pack file is only appended to, so offsets continue after its content
+    const off_t end = lseek(pack_fd, 0, SEEK_END);
+    pack_size = end < 0 ? 0 : static_cast<uint64_t>(end);
+
+    const off_t i_end = lseek(index_fd, 0, SEEK_END);
+    index_size = i_end < 0 ? 0 : static_cast<uint64_t>(i_end);
+
+    const size_t slot_cnt = arena_size / CHUNK_LEN;
+
+    for (size_t i = 0; i < 2; i++) {
+      arenas[i].buf =
+        static_cast<sycl::uchar*>(sycl::malloc_host(arena_size, q));
+    }
+
+    offsets_h =
+      static_cast<size_t*>(sycl::malloc_host(slot_cnt * sizeof(size_t), q));
+    counters_h =
+      static_cast<uint64_t*>(sycl::malloc_host(slot_cnt * sizeof(uint64_t), q));
+    cvs_h = static_cast<uint32_t*>(sycl::malloc_host(slot_cnt * OUT_LEN, q));
+
+    arena_d = static_cast<sycl::uchar*>(sycl::malloc_device(arena_size, q));
+    offsets_d =
+      static_cast<size_t*>(sycl::malloc_device(slot_cnt * sizeof(size_t), q));
+    counters_d = static_cast<uint64_t*>(
+      sycl::malloc_device(slot_cnt * sizeof(uint64_t), q));
+    cvs_d = static_cast<uint32_t*>(sycl::malloc_device(slot_cnt * OUT_LEN, q));
+  }
+
+  ~pack_writer()
+  {
+    flush();
+
+    for (size_t i = 0; i < 2; i++) {
+      sycl::free(arenas[i].buf, q);
+    }
+
+    sycl::free(offsets_h, q);
+    sycl::free(counters_h, q);
+    sycl::free(cvs_h, q);
+    sycl::free(arena_d, q);
+    sycl::free(offsets_d, q);
+    sycl::free(counters_d, q);
+    sycl::free(cvs_d, q);
+  }
+
+  pack_writer(const pack_writer&) = delete;
+  pack_writer& operator=(const pack_writer&) = delete;
+
+  // Copies object into staging arena, sealing current batch first, when it
+  // doesn't fit
+  //
+  // Returns false with `errno` set to EFBIG, when object is larger than arena,
+  // or with `errno` set by failing write, when writing some previous batch
+  // failed
+  bool add(const sycl::uchar* const data, const size_t len)
+  {
+    if (error != 0) {
+      errno = error;
+      return false;
+    }
+
+    if (len > arena_size) {
+      errno = EFBIG;
+      return false;
+    }
+
+    const bool on_host = len <= host_hash_max;
+
+    // objects hashed on accelerator start at chunk boundary
+    auto place = [&]() {
+      const size_t used = arenas[cur].used;
+      return on_host ? used : (used + CHUNK_LEN - 1) / CHUNK_LEN * CHUNK_LEN;
+    };
+
+    if (place() + len > arena_size && !seal()) {
+      return false;
+    }
+
+    arena_t& a = arenas[cur];
+    object_t o{ place(), len, on_host, {} };
+
+    if (on_host) {
+      host_hash_copy(data, a.buf + o.offset, len, o.digest);
+    } else {
+      std::memcpy(a.buf + o.offset, data, len);
+    }
+
+    a.objects.push_back(o);
+    a.used = o.offset + len;
+
+    return true;
+  }
+
+  // Hashes and writes all objects added so far, waiting until they're written
+  // to pack and index files
+  //
+  // Returns false with `errno` set by failing write, when writing some batch
+  // failed
+  bool flush()
+  {
+    if (error != 0) {
+      errno = error;
+      return false;
+    }
+
+    if (!arenas[cur].objects.empty() && !seal()) {
+      return false;
+    }
+
+    return wait_write();
+  }
+
+private:
+  // One object of a batch
+  struct object_t
+  {
+    size_t offset; // in arena
+    size_t len;
+    bool hashed; // on host, while being copied into arena
+    sycl::uchar digest[32];
+  };
+
+  // Staging arena, where objects of one batch are accumulated
+  struct arena_t
+  {
+    sycl::uchar* buf = nullptr;
+    size_t used = 0;
+
+    // in order of addition
+    std::vector<object_t> objects;
+  };
+
+  // Hashes objects of current arena, then hands it over to writer thread ( once
+  // it's done with previous batch ), switching to other arena
+  bool seal()
+  {
+    arena_t& a = arenas[cur];
+
+    // full chunks of each object not yet hashed, except its last chunk, which
+    // is compressed on host, because it may turn out to be root; only those
+    // chunks are uploaded, at same offsets, as they're in arena, where ranges
+    // closer than `PACK_UPLOAD_GAP` are coalesced into one copy
+    std::vector<sycl::event> evts;
+    size_t chunk_cnt = 0;
+    size_t up_begin = 0;
+    size_t up_end = 0;
+
+    auto upload = [&]() {
+      if (up_end > up_begin) {
+        evts.push_back(
+          q.memcpy(arena_d + up_begin, a.buf + up_begin, up_end - up_begin));
+      }
+    };
+
+    for (const object_t& o : a.objects) {
+      const size_t cnt = o.hashed || o.len == 0 ? 0 : (o.len - 1) / CHUNK_LEN;
+      if (cnt == 0) {
+        continue;
+      }
+
+      for (size_t j = 0; j < cnt; j++) {
+        offsets_h[chunk_cnt + j] = o.offset + j * CHUNK_LEN;
+        counters_h[chunk_cnt + j] = j;
+      }
+      chunk_cnt += cnt;
+
+      if (up_end == up_begin || o.offset - up_end > PACK_UPLOAD_GAP) {
+        upload();
+        up_begin = o.offset;
+      }
+      up_end = o.offset + cnt * CHUNK_LEN;
+    }
+    upload();
+
+    if (chunk_cnt > 0) {
+      sycl::event::wait(evts);
+      q.memcpy(offsets_d, offsets_h, chunk_cnt * sizeof(size_t)).wait();
+      q.memcpy(counters_d, counters_h, chunk_cnt * sizeof(uint64_t)).wait();
+      submit_chunk_cvs<kernelBlake3PackCVs, true>(
+        q, arena_d, offsets_d, counters_d, chunk_cnt, cvs_d)
+        .wait();
+      q.memcpy(cvs_h, cvs_d, chunk_cnt * OUT_LEN).wait();
+    }
+
+    // previous batch must be written, before its arena is reused, and before
+    // offsets of this batch are assigned, as they're only valid if it succeeded
+    if (!wait_write()) {
+      return false;
+    }
+
+    std::vector<pack_index_entry_t> entries(a.objects.size());
+    const uint64_t p_start = pack_size;
+
+    size_t cv_idx = 0;
+    for (size_t i = 0; i < a.objects.size(); i++) {
+      const object_t& o = a.objects[i];
+
+      if (o.hashed) {
+        std::copy(o.digest, o.digest + OUT_LEN, entries[i].digest);
+      } else {
+        const size_t cnt = o.len == 0 ? 0 : (o.len - 1) / CHUNK_LEN;
+
+        cv_stack_t stack;
+        for (size_t j = 0; j < cnt; j++) {
+          cv_stack_push(stack, j + 1, cvs_h + ((cv_idx + j) << 3));
+        }
+        cv_idx += cnt;
+
+        const size_t last = cnt * CHUNK_LEN;
+        cv_stack_root(stack,
+                      a.buf + o.offset + last,
+                      o.len - last,
+                      cnt,
+                      entries[i].digest);
+      }
+
+      entries[i].offset = pack_size;
+      entries[i].length = o.len;
+      pack_size += o.len;
+    }
+
+    const size_t idx = cur;
+    const uint64_t i_start = index_size;
+    index_size += entries.size() * sizeof(pack_index_entry_t);
+
+    writing =
+      std::async(std::launch::async, [this, idx, entries, p_start, i_start]() {
+        return write_batch(arenas[idx], entries, p_start, i_start);
+      });
+
+    cur ^= 1;
+    return true;
+  }
+
+  // Appends objects of arena to pack file and their index entries to index
+  // file, then empties arena; executed on writer thread
+  //
+  // On failure, both files are truncated back to their sizes before this batch
+  // ( `p_start` and `i_start` -bytes ), so that no partially written batch is
+  // left behind
+  //
+  // Returns 0 on success, otherwise `errno` of failing write
+  int write_batch(arena_t& a,
+                  const std::vector<pack_index_entry_t>& entries,
+                  const uint64_t p_start,
+                  const uint64_t i_start)
+  {
+    int err = 0;
+
+    for (const object_t& o : a.objects) {
+      if (err == 0 && !write_full(pack_fd, a.buf + o.offset, o.len)) {
+        err = errno;
+      }
+    }
+
+    const size_t i_len = entries.size() * sizeof(pack_index_entry_t);
+    if (err == 0 &&
+        !write_full(
+          index_fd, reinterpret_cast<const uint8_t*>(entries.data()), i_len)) {
+      err = errno;
+    }
+
+    // best effort, it's `errno` of failing write, which is reported
+    if (err != 0) {
+      [[maybe_unused]] const int p_trunc =
+        ftruncate(pack_fd, static_cast<off_t>(p_start));
+      [[maybe_unused]] const int i_trunc =
+        ftruncate(index_fd, static_cast<off_t>(i_start));
+    }
+
+    a.used = 0;
+    a.objects.clear();
+
+    return err;
+  }
+
+  // Waits for writer thread to be done with previous batch, if any
+  //
+  // Returns false with `errno` set by failing write, if that batch failed,
+  // which is remembered, so that all later calls fail too
+  bool wait_write()
+  {
+    if (error != 0) {
+      errno = error;
+      return false;
+    }
+
+    if (!writing.valid()) {
+      return true;
+    }
+
+    error = writing.get();
+    if (error != 0) {
+      errno = error;
+      return false;
+    }
+
+    return true;
+  }
+
+  // Fully writes `len` -bytes to file, while retrying on short writes
+  static bool write_full(const int fd, const uint8_t* buf, size_t len)
+  {
+    while (len > 0) {
+      const ssize_t n = write(fd, buf, len);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+
+      buf += n;
+      len -= static_cast<size_t>(n);
+    }
+
+    return true;
+  }
+
+  sycl::queue& q;
+  const int pack_fd;
+  const int index_fd;
+  const size_t arena_size;
+  const size_t host_hash_max;
+
+  arena_t arenas[2];
+  size_t cur = 0;
+  uint64_t pack_size = 0;  // bytes, including batches still being written
+  uint64_t index_size = 0; // bytes, same as above
+  std::future<int> writing;
+  int error = 0; // `errno` of first failing write, sticky
+
+  // pinned host and device buffers, used for hashing one batch at a time
+  size_t* offsets_h;
+  uint64_t* counters_h;
+  uint32_t* cvs_h;
+  sycl::uchar* arena_d;
+  size_t* offsets_d;
+  uint64_t* counters_d;
+  uint32_t* cvs_d;
+};
+}
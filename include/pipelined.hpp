@@ -0,0 +1,222 @@
+#pragma once
+#include "blake3.hpp"
+
+namespace blake3 {
+
+// Just to avoid kernel name mangling in optimization report
+class kernelBlake3ChunkPhase;
+class kernelBlake3ParentPhase;
+class pipeBlake3Leaves;
+
+// 32 -bytes chaining value, as it's passed through pipe
+struct chaining_value_t
+{
+  uint32_t words[8];
+};
+
+// Capacity of pipe connecting chunk and parent kernels, in terms of chaining
+// values, see board.hpp
+constexpr size_t LEAF_PIPE_DEPTH = BOARD.leaf_pipe_depth;
+
+// Leaf chaining values, flowing from chunk kernel to parent kernel, in order of
+// chunk index
+using leaf_pipe =
+  sycl::ext::intel::pipe<pipeBlake3Leaves, chaining_value_t, LEAF_PIPE_DEPTH>;
+
+// Maximum height of CV stack kept on-chip by parent kernel, which is enough for
+// any input size this implementation can handle
+constexpr size_t MAX_TREE_HEIGHT = 64;
+
+// BLAKE3 hash function, which computes digests of `job_cnt` -many equal sized
+// inputs ( each of `chunk_count` -many chunks, power of 2 ), living
+// consecutively in `input`, writing `job_cnt` -many 32 -bytes digests,
+// consecutively in `digests`
+//
+// Unlike `hash( ... )`, where parent reduction runs only after whole chunk
+// compression loop drains, here chunk compression and parent reduction are
+// split into two kernels running concurrently, connected by a pipe
+//
+// - chunk kernel compresses chunks of each job ( using same interleaved
+// schedule as `hash( ... )` ), pushing leaf chaining values into pipe as soon
+// as last message block of a chunk is compressed
+// - parent kernel keeps an on-chip CV stack, merging leaf chaining values into
+// parents as they arrive, so that when last leaf of a job arrives, its digest
+// is ready
+//
+// So device chunk compresses job (i + 1), while finishing tree of job i, which
+// removes parent reduction tail from steady-state throughput
+//
+// Note, both kernels must be able to run concurrently, so `q` must not be an
+// in-order queue. Kernel execution time is measured from start of chunk kernel
+// to end of parent kernel
+void
+hash_many(sycl::queue& q,                        // SYCL compute queue
+          sycl::uchar* const __restrict input,   // it'll never be modified !
+          const size_t chunk_count,              // per job, power of 2
+          const size_t job_cnt,                  // number of inputs
+          sycl::uchar* const __restrict digests, // job_cnt x 32 -bytes
+          sycl::cl_ulong* const __restrict ts    // kernel exec time in `ns`
+)
+{
+  assert(chunk_count >= (1 << 10));
+  assert((chunk_count & (chunk_count - 1)) == 0); // ensure power of 2
+  assert(bin_log(chunk_count) < MAX_TREE_HEIGHT);
+
+  // spilled chaining values of chunks being compressed, reused across jobs
+  const size_t mem_size = chunk_count * OUT_LEN;
+  uint32_t* mem = static_cast<uint32_t*>(sycl::malloc_device(mem_size, q));
+
+  sycl::event evt_0 = q.single_task<kernelBlake3ChunkPhase>(
+    [=]() [[intel::kernel_args_restrict]] {
+      // Just to hint that Load Store Units don't need to interface with host
+      sycl::device_ptr<sycl::uchar> i_ptr{ input };
+      sycl::device_ptr<uint32_t> mem_ptr{ mem };
+
+      [[intel::fpga_register]] uint32_t msg[4][16];
+      [[intel::fpga_register]] uint32_t state[4][16];
+
+      const size_t i_size = chunk_count << 10;
+      const size_t msg_blk_cnt = chunk_count << 4;
+
+      for (size_t job = 0; job < job_cnt; job++) {
+        const size_t j_offset = job * i_size;
+
+        size_t chunk_idx = 0;
+        size_t msg_blk_idx = 0;
+
+        [[intel::ivdep]] for (size_t c = 0; c < msg_blk_cnt; c += 4)
+        {
+#pragma unroll 4
+          for (size_t l = 0; l < 4; l++) {
+            sycl::private_ptr<uint32_t> state_ptr{ state[l] };
+            sycl::private_ptr<uint32_t> msg_ptr{ msg[l] };
+
+            const size_t c_idx = chunk_idx + l;
+            const size_t i_offset =
+              j_offset + (c_idx << 10) + (msg_blk_idx << 6);
+            const size_t o_offset = c_idx << 3;
+
+#pragma unroll 8
+            for (size_t i = 0; i < 8; i++) {
+              state_ptr[i] =
+                msg_blk_idx == 0 ? IV[i] : mem_ptr[o_offset + i];
+            }
+#pragma unroll 4
+            for (size_t i = 0; i < 4; i++) {
+              state_ptr[8 + i] = IV[i];
+            }
+
+            state_ptr[12] = static_cast<uint32_t>(c_idx & 0xffffffff);
+            state_ptr[13] = static_cast<uint32_t>(c_idx >> 32);
+            state_ptr[14] = BLOCK_LEN;
+            state_ptr[15] = (msg_blk_idx == 0 ? CHUNK_START : 0) |
+                            (msg_blk_idx == 15 ? CHUNK_END : 0);
+
+#pragma unroll 16
+            for (size_t i = 0; i < 16; i++) {
+              msg_ptr[i] = word_from_le_bytes(i_ptr + i_offset + (i << 2));
+            }
+
+            compress(state_ptr, msg_ptr);
+
+            if (msg_blk_idx == 15) {
+              // leaf chaining value is ready, hand it over to parent kernel
+              chaining_value_t cv;
+#pragma unroll 8
+              for (size_t i = 0; i < 8; i++) {
+                cv.words[i] = state_ptr[i];
+              }
+              leaf_pipe::write(cv);
+            } else {
+#pragma unroll 8
+              for (size_t i = 0; i < 8; i++) {
+                mem_ptr[o_offset + i] = state_ptr[i];
+              }
+            }
+          }
+
+          // point to next chunk/ message block
+          if ((chunk_idx + 4) == chunk_count) {
+            chunk_idx = 0;
+            msg_blk_idx++;
+          } else {
+            chunk_idx += 4;
+          }
+        }
+      }
+    });
+
+  sycl::event evt_1 = q.single_task<kernelBlake3ParentPhase>(
+    [=]() [[intel::kernel_args_restrict]] {
+      // Just to hint that Load Store Units don't need to interface with host
+      sycl::device_ptr<sycl::uchar> o_ptr{ digests };
+
+      // CV stack, where i-th entry ( from bottom ) is root of a complete
+      // subtree, which is bigger than subtree rooted at (i + 1)-th entry
+      [[intel::fpga_memory("BLOCK_RAM")]] uint32_t stack[MAX_TREE_HEIGHT][8];
+
+      [[intel::fpga_register]] uint32_t msg[16];
+      [[intel::fpga_register]] uint32_t state[16];
+      [[intel::fpga_register]] uint32_t cv[8];
+
+      sycl::private_ptr<uint32_t> msg_ptr{ msg };
+      sycl::private_ptr<uint32_t> state_ptr{ state };
+
+      for (size_t job = 0; job < job_cnt; job++) {
+        size_t top = 0;
+
+        for (size_t i = 0; i < chunk_count; i++) {
+          const chaining_value_t leaf = leaf_pipe::read();
+
+#pragma unroll 8
+          for (size_t j = 0; j < 8; j++) {
+            cv[j] = leaf.words[j];
+          }
+
+          // as many merges as there are trailing zero bits in number of leaves
+          // seen so far, where last merge of last leaf produces root
+          for (size_t n = i + 1; (n & 1ul) == 0; n >>= 1) {
+            top--;
+
+#pragma unroll 8
+            for (size_t j = 0; j < 8; j++) {
+              msg_ptr[j] = stack[top][j];
+              msg_ptr[8 + j] = cv[j];
+            }
+
+            const bool is_root = (i + 1) == chunk_count && top == 0;
+            compress_parent(state_ptr, msg_ptr, is_root ? ROOT : 0);
+
+#pragma unroll 8
+            for (size_t j = 0; j < 8; j++) {
+              cv[j] = state_ptr[j];
+            }
+          }
+
+#pragma unroll 8
+          for (size_t j = 0; j < 8; j++) {
+            stack[top][j] = cv[j];
+          }
+          top++;
+        }
+
+        // writing little endian digest bytes of this job
+        words_to_le_bytes(sycl::private_ptr<uint32_t>{ cv },
+                          o_ptr + job * OUT_LEN);
+      }
+    });
+
+  evt_1.wait();
+  evt_0.wait();
+  sycl::free(mem, q);
+
+  if (ts != nullptr) {
+    const sycl::cl_ulong start =
+      evt_0.get_profiling_info<sycl::info::event_profiling::command_start>();
+    const sycl::cl_ulong end =
+      evt_1.get_profiling_info<sycl::info::event_profiling::command_end>();
+
+    *ts = end - start;
+  }
+}
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include "blake3.hpp"
+
+namespace blake3 {
+
+// Just to avoid kernel name mangling in optimization report, one per pool
+// size, so that many pools can live in same binary
+template<size_t lanes>
+class kernelBlake3HashPooled;
+
+// Default number of compress engines in shared pool, see board.hpp
+constexpr size_t POOL_LANES = BOARD.pool_lanes;
+
+// Number of idle iterations inserted before each tree level of pooled kernel,
+// so that chaining value written in one step is always read back at least
+// these many iterations later, in next step; it's global memory round trip of
+// target board, see board.hpp
+constexpr size_t POOL_SPILL_DISTANCE = BOARD.spill_distance;
+
+// Compile time check for size of engine pool, to ensure that it's power of 2
+// and that each chunk step spans at least POOL_SPILL_DISTANCE iterations, for
+// minimum chunk count ( = 2^10 ), so chunk steps need no padding; chaining
+// value of a chunk, written in some iteration of chunk step j, is read back in
+// same iteration of step (j + 1), which is exactly ( 2^10 / lanes ) iterations
+// later
+static constexpr bool
+is_valid_pool_lanes(const size_t lanes)
+{
+  return lanes >= 2 && (lanes & (lanes - 1)) == 0 &&
+         (1ul << 10) / lanes >= POOL_SPILL_DISTANCE;
+}
+
+static_assert(is_valid_pool_lanes(POOL_LANES));
+
+// BLAKE3 hash function, which computes same digest as `hash( ... )`, using one
+// pool of `lanes` -many compress engines, shared by chunk and parent phases
+//
+// In `hash( ... )`, chunk compression loop synthesizes four compress engines,
+// while `merkelize( ... )` synthesizes three more ( two for parent levels, one
+// for root ), which are idle during chunk phase, same as chunk engines are
+// idle during parent phase. Here whole hashing is one loop over steps, where
+// first 16 steps compress j-th message blocks of all chunks and next
+// log2(chunk_count) steps compress all parent nodes of one tree level ( last
+// one being root ). In each iteration, every engine takes next task of current
+// step, with its message words and hash state selected either from input
+// message block or from pair of children chaining values; engines are idle
+// only when a level has fewer nodes than engines, or while waiting for
+// previous level to be written back ( see `POOL_SPILL_DISTANCE` )
+//
+// Same input constraints as `hash( ... )` apply
+template<size_t lanes = POOL_LANES>
+void
+hash_pooled(sycl::queue& q,                       // SYCL compute queue
+            sycl::uchar* const __restrict input,  // it'll never be modified !
+            const size_t i_size,                  // bytes
+            const size_t chunk_count,             // works only with power of 2
+            sycl::uchar* const __restrict digest, // 32 -bytes BLAKE3 digest
+            sycl::cl_ulong* const __restrict ts   // kernel exec time in `ns`
+            ) requires(is_valid_pool_lanes(lanes))
+{
+  assert(i_size == chunk_count * CHUNK_LEN);
+  assert(chunk_count >= (1 << 10));
+  assert((chunk_count & (chunk_count - 1)) == 0); // ensure power of 2
+
+  // same layout of intermediate chaining values as `hash( ... )` uses
+  const size_t mem_size = (chunk_count * OUT_LEN) << 1;
+  uint32_t* mem = static_cast<uint32_t*>(sycl::malloc_device(mem_size, q));
+
+  // 16 chunk steps, followed by one step per tree level
+  const size_t step_cnt = 16 + bin_log(chunk_count);
+
+  // iterations of each step, where tree levels are preceded by idle ones
+  size_t itr_cnt = 0;
+  for (size_t s = 0; s < step_cnt; s++) {
+    const size_t task_cnt = s < 16 ? chunk_count : chunk_count >> (s - 15);
+    const size_t pad = s < 16 ? 0 : POOL_SPILL_DISTANCE;
+    itr_cnt += pad + (task_cnt + lanes - 1) / lanes;
+  }
+
+  sycl::event evt = q.single_task<kernelBlake3HashPooled<lanes>>(
+    [=]() [[intel::kernel_args_restrict]] {
+      // Just to hint that Load Store Units don't need to interface with host
+      sycl::device_ptr<sycl::uchar> i_ptr{ input };
+      sycl::device_ptr<uint32_t> mem_ptr{ mem };
+      sycl::device_ptr<sycl::uchar> o_ptr{ digest };
+
+      [[intel::fpga_register]] uint32_t msg[lanes][16];
+      [[intel::fpga_register]] uint32_t state[lanes][16];
+
+      const size_t leaf_offset = chunk_count << 3;
+
+      size_t step = 0;
+      size_t task_cnt = chunk_count;
+      size_t pad = 0;
+      size_t step_itr_cnt = chunk_count / lanes;
+      size_t step_itr = 0;
+
+      [[intel::ivdep(POOL_SPILL_DISTANCE)]] for (size_t c = 0; c < itr_cnt; c++)
+      {
+        const bool parent = step >= 16;
+        const bool root = parent && task_cnt == 1;
+
+        // level (step - 16) of tree consumes chaining values of level below
+        const size_t level = parent ? step - 16 : 0;
+        const size_t i_offset = leaf_offset >> level;
+        const size_t o_offset = parent ? i_offset >> 1 : leaf_offset;
+
+        const bool busy = step_itr >= pad;
+        const size_t first = busy ? (step_itr - pad) * lanes : 0;
+
+#pragma unroll
+        for (size_t l = 0; l < lanes; l++) {
+          const size_t t = first + l;
+
+          // idle engine, either padding of current step or last few nodes
+          if (busy && t < task_cnt) {
+            sycl::private_ptr<uint32_t> state_ptr{ state[l] };
+            sycl::private_ptr<uint32_t> msg_ptr{ msg[l] };
+
+            const size_t o_offset_l = o_offset + (t << 3);
+
+            // input chaining value is constant initial hash values, except
+            // for j-th ( > 0 ) message block of a chunk, where it's output
+            // chaining value of previous message block
+#pragma unroll 8
+            for (size_t i = 0; i < 8; i++) {
+              state_ptr[i] =
+                parent || step == 0 ? IV[i] : mem_ptr[o_offset_l + i];
+            }
+#pragma unroll 4
+            for (size_t i = 0; i < 4; i++) {
+              state_ptr[8 + i] = IV[i];
+            }
+
+            state_ptr[12] = parent ? 0 : static_cast<uint32_t>(t & 0xffffffff);
+            state_ptr[13] = parent ? 0 : static_cast<uint32_t>(t >> 32);
+            state_ptr[14] = BLOCK_LEN;
+            state_ptr[15] = parent ? (PARENT | (root ? ROOT : 0))
+                                   : (step == 0 ? CHUNK_START : 0) |
+                                       (step == 15 ? CHUNK_END : 0);
+
+            // either message block of chunk or two children chaining values
+#pragma unroll 16
+            for (size_t i = 0; i < 16; i++) {
+              msg_ptr[i] =
+                parent ? mem_ptr[i_offset + (t << 4) + i]
+                       : word_from_le_bytes(i_ptr + (t << 10) + (step << 6) +
+                                            (i << 2));
+            }
+
+            compress(state_ptr, msg_ptr);
+
+            if (root) {
+              words_to_le_bytes(state_ptr, o_ptr);
+            } else {
+#pragma unroll 8
+              for (size_t i = 0; i < 8; i++) {
+                mem_ptr[o_offset_l + i] = state_ptr[i];
+              }
+            }
+          }
+        }
+
+        // point to next iteration of this step, or to next step
+        if (step_itr + 1 == step_itr_cnt) {
+          step++;
+          task_cnt = step < 16 ? chunk_count : task_cnt >> 1;
+          pad = step < 16 ? 0 : POOL_SPILL_DISTANCE;
+          step_itr_cnt = pad + (task_cnt + lanes - 1) / lanes;
+          step_itr = 0;
+        } else {
+          step_itr++;
+        }
+      }
+    });
+
+  evt.wait();
+  sycl::free(mem, q);
+
+  if (ts != nullptr) {
+    *ts = time_event(evt);
+  }
+}
+}
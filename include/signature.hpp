@@ -0,0 +1,429 @@
+#pragma once
+#include "batch.hpp"
+#include "host.hpp"
+#include <cerrno>
+#include <future>
+#include <unistd.h>
+#include <vector>
+
+namespace blake3 {
+
+// Just to avoid kernel name mangling in optimization report
+class kernelBlake3SigWeak;
+class kernelBlake3SigCVs;
+
+// Identifies signature file and its layout version
+constexpr uint64_t SIG_MAGIC = 0x31'47'49'53'33'42'00'00ul;
+
+// Default size of blocks, whose signatures are computed
+constexpr size_t SIG_BLOCK_LEN = 1 << 16;
+
+// Default number of leading bytes of BLAKE3 digest of block, kept in signature
+// file, as strong checksum
+constexpr size_t SIG_STRONG_LEN = 16;
+
+// Bytes of input, uploaded to accelerator and checksummed in one round, must be
+// multiple of block size
+constexpr size_t SIG_WINDOW = 1 << 26;
+
+// Fixed size header of signature file ( in host byte order ), followed by one
+// entry per block, in order, where each entry is 4 -bytes weak checksum ( in
+// host byte order ) and `strong_len` -bytes strong checksum
+struct sig_header_t
+{
+  uint64_t magic;
+  uint64_t block_len;  // bytes, last block may be shorter
+  uint64_t file_len;   // bytes
+  uint64_t strong_len; // bytes, prefix of BLAKE3 digest
+};
+
+// Signature of one block of file
+struct block_sig_t
+{
+  uint32_t weak;
+  sycl::uchar strong[32]; // only first `strong_len` -bytes are meaningful
+};
+
+// Checks that block size is power of 2 and each block has at least two chunks,
+// so that chunks are never root, while a window holds whole blocks
+static inline bool
+is_valid_sig_block_len(const size_t block_len)
+{
+  return block_len >= (CHUNK_LEN << 1) && block_len <= SIG_WINDOW &&
+         (block_len & (block_len - 1)) == 0;
+}
+
+// Weak checksum of `len` -bytes block, as rsync computes it i.e. lower 16 bits
+// hold sum of bytes, upper 16 bits hold sum of bytes, where i-th byte is
+// weighted by (len - i), both modulo 2^16
+static inline uint32_t
+weak_checksum(const sycl::uchar* const data, const size_t len)
+{
+  uint32_t a = 0;
+  uint32_t b = 0;
+
+  for (size_t i = 0; i < len; i++) {
+    a += data[i];
+    b += static_cast<uint32_t>(len - i) * data[i];
+  }
+
+  return (a & 0xffff) | (b << 16);
+}
+
+// Weak checksum of `len` -bytes block, which is slid forward by one byte, where
+// `out` is byte leaving block and `in` is byte entering it, in O(1), so that
+// delta sync can look up block signatures at every offset of new file
+static inline uint32_t
+weak_roll(const uint32_t sum,
+          const sycl::uchar out,
+          const sycl::uchar in,
+          const size_t len)
+{
+  const uint32_t a = (sum & 0xffff) - out + in;
+  const uint32_t b = (sum >> 16) - static_cast<uint32_t>(len) * out + a;
+
+  return (a & 0xffff) | (b << 16);
+}
+
+// Enqueues weak checksum kernel, which streams `block_cnt` -many consecutive
+// `block_len` -bytes blocks ( living in device memory ), 64 -bytes per
+// iteration, writing weak checksum of i-th block to `sums[i]`, same as
+// `weak_checksum( ... )` computes
+//
+// Weighted sum of 64 bytes is split into (r x sum of bytes) - sum of bytes
+// weighted by their index, where r is weight of first of them, so that loop
+// carried dependency is just two additions
+sycl::event
+submit_weak_sums(sycl::queue& q,                      // SYCL compute queue
+                 sycl::uchar* const __restrict input, // never modified !
+                 const size_t block_len,              // multiple of 64
+                 const size_t block_cnt,              // number of blocks
+                 uint32_t* const __restrict sums      // block_cnt -many
+)
+{
+  return q.single_task<kernelBlake3SigWeak>(
+    [=]() [[intel::kernel_args_restrict]] {
+      // Just to hint that Load Store Units don't need to interface with host
+      sycl::device_ptr<sycl::uchar> i_ptr{ input };
+      sycl::device_ptr<uint32_t> o_ptr{ sums };
+
+      const size_t step_cnt = block_len >> 6;
+      const size_t itr_cnt = block_cnt * step_cnt;
+
+      uint32_t a = 0;
+      uint32_t b = 0;
+      size_t blk_idx = 0;
+      size_t step = 0;
+
+      for (size_t c = 0; c < itr_cnt; c++) {
+        uint32_t s = 0;
+        uint32_t w = 0;
+
+#pragma unroll 64
+        for (size_t k = 0; k < 64; k++) {
+          const uint32_t x = i_ptr[(c << 6) + k];
+          s += x;
+          w += static_cast<uint32_t>(k) * x;
+        }
+
+        const uint32_t r = static_cast<uint32_t>(block_len - (step << 6));
+        a += s;
+        b += r * s - w;
+
+        // last 64 -bytes of block
+        if (step + 1 == step_cnt) {
+          o_ptr[blk_idx] = (a & 0xffff) | (b << 16);
+
+          a = 0;
+          b = 0;
+          step = 0;
+          blk_idx++;
+        } else {
+          step++;
+        }
+      }
+    });
+}
+
+// Generates rsync style signature file of input, having weak ( rolling )
+// checksum and strong checksum ( prefix of BLAKE3 digest ) of every
+// `block_len` -bytes block, for delta sync
+//
+// Input is uploaded to accelerator one window ( see `SIG_WINDOW` ) at a time,
+// crossing PCIe once, where weak checksum kernel ( see `submit_weak_sums` )
+// and chunk kernel ( see `submit_chunk_cvs` ), compressing all chunks of all
+// blocks of window with per block chunk counters, are enqueued together, on
+// same buffer. Each block is an independent BLAKE3 input, so only its parent
+// nodes are compressed on host, on a separate thread, while next window is
+// processed on accelerator; last partial block ( if any ) is checksummed on
+// host
+//
+// Pinned and device buffers are allocated once, so that one generator can be
+// reused across files
+class signature_generator
+{
+public:
+  signature_generator(sycl::queue& q,
+                      const size_t block_len = SIG_BLOCK_LEN,
+                      const size_t strong_len = SIG_STRONG_LEN)
+    : q(q)
+    , block_len(block_len)
+    , strong_len(strong_len)
+  {
+    assert(is_valid_sig_block_len(block_len));
+    assert(strong_len > 0 && strong_len <= OUT_LEN);
+
+    const size_t chunk_cnt = SIG_WINDOW / CHUNK_LEN;
+    const size_t block_cnt = SIG_WINDOW / block_len;
+    const size_t cpb = block_len / CHUNK_LEN;
+
+    for (size_t i = 0; i < 2; i++) {
+      cvs_h[i] =
+        static_cast<uint32_t*>(sycl::malloc_host(chunk_cnt * OUT_LEN, q));
+      sums_h[i] = static_cast<uint32_t*>(
+        sycl::malloc_host(block_cnt * sizeof(uint32_t), q));
+    }
+
+    input_d = static_cast<sycl::uchar*>(sycl::malloc_device(SIG_WINDOW, q));
+    counters_d = static_cast<uint64_t*>(
+      sycl::malloc_device(chunk_cnt * sizeof(uint64_t), q));
+    cvs_d = static_cast<uint32_t*>(sycl::malloc_device(chunk_cnt * OUT_LEN, q));
+    sums_d = static_cast<uint32_t*>(
+      sycl::malloc_device(block_cnt * sizeof(uint32_t), q));
+
+    // chunk counters restart at each block, same for every window
+    std::vector<uint64_t> counters(chunk_cnt);
+    for (size_t i = 0; i < chunk_cnt; i++) {
+      counters[i] = i % cpb;
+    }
+    q.memcpy(counters_d, counters.data(), chunk_cnt * sizeof(uint64_t)).wait();
+  }
+
+  ~signature_generator()
+  {
+    for (size_t i = 0; i < 2; i++) {
+      sycl::free(cvs_h[i], q);
+      sycl::free(sums_h[i], q);
+    }
+
+    sycl::free(input_d, q);
+    sycl::free(counters_d, q);
+    sycl::free(cvs_d, q);
+    sycl::free(sums_d, q);
+  }
+
+  signature_generator(const signature_generator&) = delete;
+  signature_generator& operator=(const signature_generator&) = delete;
+
+  // Writes signature file of `len` -bytes input ( living in host memory, say
+  // memory mapped file ) to `fd`, header first, then one entry per block
+  //
+  // Returns false with `errno` set by failing write
+  bool write(const sycl::uchar* const data, const size_t len, const int fd)
+  {
+    const sig_header_t h{ SIG_MAGIC, block_len, len, strong_len };
+    if (!write_full(fd, reinterpret_cast<const uint8_t*>(&h), sizeof(h))) {
+      return false;
+    }
+
+    const size_t cpb = block_len / CHUNK_LEN;
+    const size_t win_blocks = SIG_WINDOW / block_len;
+    const size_t full_blocks = len / block_len;
+
+    std::future<int> writing;
+    size_t cur = 0;
+
+    // waits for host thread to be done with previous window, if any
+    auto wait_write = [&]() {
+      if (!writing.valid()) {
+        return true;
+      }
+
+      const int err = writing.get();
+      if (err != 0) {
+        errno = err;
+        return false;
+      }
+
+      return true;
+    };
+
+    for (size_t b = 0; b < full_blocks; b += win_blocks) {
+      const size_t n = std::min(win_blocks, full_blocks - b);
+      const size_t chunk_cnt = n * cpb;
+
+      q.memcpy(input_d, data + b * block_len, n * block_len).wait();
+
+      // both kernels only read uploaded window, so they may run concurrently
+      std::vector<sycl::event> evts{
+        submit_weak_sums(q, input_d, block_len, n, sums_d),
+        submit_chunk_cvs<kernelBlake3SigCVs, false>(
+          q, input_d, nullptr, counters_d, chunk_cnt, cvs_d)
+      };
+      sycl::event::wait(evts);
+
+      // buffers of window before previous one are already released, see
+      // below
+      q.memcpy(cvs_h[cur], cvs_d, chunk_cnt * OUT_LEN).wait();
+      q.memcpy(sums_h[cur], sums_d, n * sizeof(uint32_t)).wait();
+
+      // previous window must be written, before this one is handed over
+      if (!wait_write()) {
+        return false;
+      }
+
+      const size_t idx = cur;
+      writing = std::async(std::launch::async, [this, idx, n, fd]() {
+        return write_window(cvs_h[idx], sums_h[idx], n, fd);
+      });
+
+      cur ^= 1;
+    }
+
+    if (!wait_write()) {
+      return false;
+    }
+
+    // last partial block
+    const size_t tail = len - full_blocks * block_len;
+    if (tail > 0) {
+      const sycl::uchar* const last = data + full_blocks * block_len;
+
+      block_sig_t s;
+      s.weak = weak_checksum(last, tail);
+      host_hash_copy(last, nullptr, tail, s.strong);
+
+      const std::vector<uint8_t> buf = encode(&s, 1);
+      if (!write_full(fd, buf.data(), buf.size())) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+private:
+  // Serializes `cnt` -many block signatures as entries of signature file
+  std::vector<uint8_t> encode(const block_sig_t* const sigs,
+                              const size_t cnt) const
+  {
+    const size_t e_len = sizeof(uint32_t) + strong_len;
+    std::vector<uint8_t> buf(cnt * e_len);
+
+    for (size_t i = 0; i < cnt; i++) {
+      std::memcpy(buf.data() + i * e_len, &sigs[i].weak, sizeof(uint32_t));
+      std::memcpy(
+        buf.data() + i * e_len + sizeof(uint32_t), sigs[i].strong, strong_len);
+    }
+
+    return buf;
+  }
+
+  // Merges chunk chaining values of each of `n` -many blocks of a window into
+  // its BLAKE3 digest, then appends their entries to signature file; executed
+  // on host thread
+  //
+  // Returns 0 on success, otherwise `errno` of failing write
+  int write_window(uint32_t* const cvs,
+                   const uint32_t* const sums,
+                   const size_t n,
+                   const int fd) const
+  {
+    const size_t cpb = block_len / CHUNK_LEN;
+    std::vector<block_sig_t> sigs(n);
+
+    for (size_t i = 0; i < n; i++) {
+      uint32_t* const blk_cvs = cvs + ((i * cpb) << 3);
+
+      // block is a perfect binary tree, merged level by level, in place
+      for (size_t m = cpb; m > 1; m >>= 1) {
+        for (size_t j = 0; j < (m >> 1); j++) {
+          host_parent_cv(blk_cvs + ((j << 1) << 3),
+                         blk_cvs + (((j << 1) + 1) << 3),
+                         m == 2 ? ROOT : 0,
+                         blk_cvs + (j << 3));
+        }
+      }
+
+      sigs[i].weak = sums[i];
+      host_words_to_le_bytes(blk_cvs, sigs[i].strong);
+    }
+
+    const std::vector<uint8_t> buf = encode(sigs.data(), n);
+    return write_full(fd, buf.data(), buf.size()) ? 0 : errno;
+  }
+
+  // Fully writes `len` -bytes to file, while retrying on short writes
+  static bool write_full(const int fd, const uint8_t* buf, size_t len)
+  {
+    while (len > 0) {
+      const ssize_t n = ::write(fd, buf, len);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+
+      buf += n;
+      len -= static_cast<size_t>(n);
+    }
+
+    return true;
+  }
+
+  sycl::queue& q;
+  const size_t block_len;
+  const size_t strong_len;
+
+  // pinned host buffers, one pair per window in flight
+  uint32_t* cvs_h[2];
+  uint32_t* sums_h[2];
+
+  // device buffers, used for checksumming one window at a time
+  sycl::uchar* input_d;
+  uint64_t* counters_d;
+  uint32_t* cvs_d;
+  uint32_t* sums_d;
+};
+
+// Reads signature file from `fd`, filling header and one signature per block
+//
+// Returns false with `errno` set to EINVAL, when file is malformed or of
+// another layout version, otherwise with `errno` set by failing read
+bool
+read_signatures(const int fd, sig_header_t& h, std::vector<block_sig_t>& sigs)
+{
+  const ssize_t n = pread(fd, &h, sizeof(h), 0);
+  if (n != static_cast<ssize_t>(sizeof(h))) {
+    errno = n < 0 ? errno : EINVAL;
+    return false;
+  }
+
+  if (h.magic != SIG_MAGIC || !is_valid_sig_block_len(h.block_len) ||
+      h.strong_len == 0 || h.strong_len > OUT_LEN) {
+    errno = EINVAL;
+    return false;
+  }
+
+  const size_t cnt = (h.file_len + h.block_len - 1) / h.block_len;
+  const size_t e_len = sizeof(uint32_t) + h.strong_len;
+
+  std::vector<uint8_t> buf(cnt * e_len);
+  const ssize_t m = pread(fd, buf.data(), buf.size(), sizeof(h));
+  if (m != static_cast<ssize_t>(buf.size())) {
+    errno = m < 0 ? errno : EINVAL;
+    return false;
+  }
+
+  sigs.assign(cnt, block_sig_t{});
+  for (size_t i = 0; i < cnt; i++) {
+    std::memcpy(&sigs[i].weak, buf.data() + i * e_len, sizeof(uint32_t));
+    std::memcpy(sigs[i].strong,
+                buf.data() + i * e_len + sizeof(uint32_t),
+                h.strong_len);
+  }
+
+  return true;
+}
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include "blake3.hpp"
+
+// Row vectorized BLAKE3 compression function for host, used for latency of
+// small inputs, where there's only one compression chain ( so nothing to
+// vectorize across chunks )
+//
+// Only available on x86_64 host compilation pass, SSE4.1 code is enabled per
+// function ( so no global compiler flag is required ) and selected at runtime,
+// when CPU supports it
+#if !defined __SYCL_DEVICE_ONLY__ && defined __x86_64__
+#define BLAKE3_HOST_SSE41
+#include <immintrin.h>
+#endif
+
+namespace blake3 {
+
+// Message word schedule of each of seven rounds, obtained by applying
+// `MSG_PERMUTATION` r times, for r-th round
+constexpr uint8_t MSG_SCHEDULE[ROUNDS][16] = {
+  { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+  { 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 },
+  { 3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1 },
+  { 10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6 },
+  { 12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4 },
+  { 9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7 },
+  { 11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13 },
+};
+
+#if defined BLAKE3_HOST_SSE41
+
+#define BLAKE3_SSE41 __attribute__((target("sse4.1")))
+
+// Circular right shift of each of four 32 -bit lanes, by 16/ 12/ 8/ 7 bit
+// places, where byte aligned rotations are done using byte shuffles
+BLAKE3_SSE41 static inline __m128i
+rotr16_sse41(const __m128i x)
+{
+  return _mm_shuffle_epi8(
+    x, _mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+}
+
+BLAKE3_SSE41 static inline __m128i
+rotr12_sse41(const __m128i x)
+{
+  return _mm_or_si128(_mm_srli_epi32(x, 12), _mm_slli_epi32(x, 20));
+}
+
+BLAKE3_SSE41 static inline __m128i
+rotr8_sse41(const __m128i x)
+{
+  return _mm_shuffle_epi8(
+    x, _mm_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1));
+}
+
+BLAKE3_SSE41 static inline __m128i
+rotr7_sse41(const __m128i x)
+{
+  return _mm_or_si128(_mm_srli_epi32(x, 7), _mm_slli_epi32(x, 25));
+}
+
+// Four `g( ... )` invocations at once, where i-th lane of each row belongs to
+// i-th column ( or diagonal, after diagonalization ) of hash state
+BLAKE3_SSE41 static inline void
+g_sse41(__m128i& a,
+        __m128i& b,
+        __m128i& c,
+        __m128i& d,
+        const __m128i mx,
+        const __m128i my)
+{
+  a = _mm_add_epi32(_mm_add_epi32(a, b), mx);
+  d = rotr16_sse41(_mm_xor_si128(d, a));
+  c = _mm_add_epi32(c, d);
+  b = rotr12_sse41(_mm_xor_si128(b, c));
+  a = _mm_add_epi32(_mm_add_epi32(a, b), my);
+  d = rotr8_sse41(_mm_xor_si128(d, a));
+  c = _mm_add_epi32(c, d);
+  b = rotr7_sse41(_mm_xor_si128(b, c));
+}
+
+// BLAKE3 compression function, with same contract as `compress( ... )` i.e.
+// sixteen words of hash state are compressed with sixteen message words, where
+// output chaining value lives in first eight words of hash state
+//
+// 4x4 hash state is kept in four row vectors, so column step is four lanes of
+// one `g_sse41( ... )`, while diagonal step rotates rows 1, 2 and 3 ( by 1, 2
+// and 3 lanes, using shuffles ) so that diagonals line up as columns, and
+// rotates them back afterwards
+BLAKE3_SSE41 void
+compress_sse41(uint32_t* const state, const uint32_t* const msg)
+{
+  __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 0));
+  __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4));
+  __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 8));
+  __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 12));
+
+  for (size_t r = 0; r < ROUNDS; r++) {
+    const uint8_t* s = MSG_SCHEDULE[r];
+
+    // column step
+    g_sse41(a,
+            b,
+            c,
+            d,
+            _mm_set_epi32(msg[s[6]], msg[s[4]], msg[s[2]], msg[s[0]]),
+            _mm_set_epi32(msg[s[7]], msg[s[5]], msg[s[3]], msg[s[1]]));
+
+    // diagonalize
+    b = _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1));
+    c = _mm_shuffle_epi32(c, _MM_SHUFFLE(1, 0, 3, 2));
+    d = _mm_shuffle_epi32(d, _MM_SHUFFLE(2, 1, 0, 3));
+
+    // diagonal step
+    g_sse41(a,
+            b,
+            c,
+            d,
+            _mm_set_epi32(msg[s[14]], msg[s[12]], msg[s[10]], msg[s[8]]),
+            _mm_set_epi32(msg[s[15]], msg[s[13]], msg[s[11]], msg[s[9]]));
+
+    // undiagonalize
+    b = _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3));
+    c = _mm_shuffle_epi32(c, _MM_SHUFFLE(1, 0, 3, 2));
+    d = _mm_shuffle_epi32(d, _MM_SHUFFLE(0, 3, 2, 1));
+  }
+
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 0), _mm_xor_si128(a, c));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_xor_si128(b, d));
+}
+
+#undef BLAKE3_SSE41
+
+#endif
+
+// Whether row vectorized compression function can be used on this host
+static inline bool
+has_sse41()
+{
+#if defined BLAKE3_HOST_SSE41
+  static const bool supported = __builtin_cpu_supports("sse4.1");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+// BLAKE3 compression function for host, which uses row vectorized
+// implementation when available, otherwise falls back to `compress( ... )`,
+// which is also synthesized on FPGA
+//
+// Note, message words may be clobbered
+inline void
+host_compress(uint32_t* const state, uint32_t* const msg)
+{
+#if defined BLAKE3_HOST_SSE41
+  if (has_sse41()) {
+    compress_sse41(state, msg);
+    return;
+  }
+#endif
+
+  compress(sycl::private_ptr<uint32_t>{ state },
+           sycl::private_ptr<uint32_t>{ msg });
+}
+}
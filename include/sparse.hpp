@@ -0,0 +1,263 @@
+#pragma once
+#include "blake3.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace blake3 {
+
+// Just to avoid kernel name mangling in optimization report
+class kernelBlake3HashSparse;
+
+// Fully reads `len` -bytes from file at `offset`, while retrying on short reads
+//
+// Returns false if I/O fails or file ends before `len` -bytes are read
+static inline bool
+pread_full(const int fd, sycl::uchar* buf, size_t len, off_t offset)
+{
+  while (len > 0) {
+    const ssize_t n = pread(fd, buf, len, offset);
+    if (n <= 0) {
+      return false;
+    }
+
+    buf += n;
+    len -= n;
+    offset += n;
+  }
+
+  return true;
+}
+
+// Discovers data extents of file ( having `chunk_count` -many chunks ) using
+// `SEEK_DATA`/ `SEEK_HOLE`, without reading any file content, while assigning
+// consecutive 1024 -bytes slots to those chunks which overlap with some data
+// extent, in increasing order of chunk index
+//
+// `chunk_map[i]` is set to slot index assigned to i-th chunk, or `CHUNK_HOLE`
+// when i-th chunk is fully inside a hole ( i.e. all zero bytes )
+//
+// Note, on file systems which don't report holes, whole file is one data
+// extent, so all chunks end up being assigned a slot
+//
+// Returns number of data chunks ( i.e. slots required ), or -1 on I/O error
+ssize_t
+map_data_chunks(const int fd,
+                const size_t chunk_count,
+                size_t* const __restrict chunk_map)
+{
+  const off_t f_size = static_cast<off_t>(chunk_count * CHUNK_LEN);
+
+  for (size_t i = 0; i < chunk_count; i++) {
+    chunk_map[i] = CHUNK_HOLE;
+  }
+
+  size_t slots = 0;
+  off_t pos = 0;
+
+  while (pos < f_size) {
+    const off_t data = lseek(fd, pos, SEEK_DATA);
+    if (data < 0) {
+      // ENXIO denotes there's no more data extent after `pos`
+      if (errno == ENXIO) {
+        break;
+      }
+      return -1;
+    }
+
+    off_t hole = lseek(fd, data, SEEK_HOLE);
+    if (hole < 0) {
+      return -1;
+    }
+    hole = std::min(hole, f_size);
+
+    // chunks [beg, end) overlap with data extent [data, hole), though first
+    // one might already have a slot, if it also overlaps with previous extent
+    size_t beg = static_cast<size_t>(data) >> 10;
+    const size_t end = (static_cast<size_t>(hole) + CHUNK_LEN - 1) >> 10;
+
+    if (beg < end && chunk_map[beg] != CHUNK_HOLE) {
+      beg++;
+    }
+
+    for (size_t i = beg; i < end; i++) {
+      chunk_map[i] = slots++;
+    }
+
+    pos = hole;
+  }
+
+  return static_cast<ssize_t>(slots);
+}
+
+// Reads those chunks of file which were assigned a slot by `map_data_chunks`
+// into `packed`, where each run of consecutive data chunks is read using one
+// `pread`
+//
+// `packed` must be able to hold ( slots * 1024 ) -bytes
+//
+// Returns false on I/O error
+bool
+read_data_chunks(const int fd,
+                 const size_t chunk_count,
+                 size_t* const __restrict chunk_map,
+                 sycl::uchar* const __restrict packed)
+{
+  size_t i = 0;
+
+  while (i < chunk_count) {
+    if (chunk_map[i] == CHUNK_HOLE) {
+      i++;
+      continue;
+    }
+
+    // slots are assigned in increasing order of chunk index, so a run of data
+    // chunks lives in consecutive slots
+    size_t end = i + 1;
+    while (end < chunk_count && chunk_map[end] != CHUNK_HOLE) {
+      end++;
+    }
+
+    const size_t len = (end - i) << 10;
+    if (!pread_full(fd, packed + (chunk_map[i] << 10), len, i << 10)) {
+      return false;
+    }
+
+    i = end;
+  }
+
+  return true;
+}
+
+// BLAKE3 hash function for sparse input, where only data chunks live in
+// `packed` ( see `map_data_chunks`, `read_data_chunks` ) and message blocks of
+// holes are synthesized on-chip, so that they never cross PCIe or touch global
+// memory
+//
+// Same constraints as `hash`, apply to `chunk_count`, also host waits for
+// kernel completion using `ws`, see `wait_event`
+void
+hash_sparse(sycl::queue& q,                       // SYCL compute queue
+            sycl::uchar* const __restrict packed, // data chunks
+            size_t* const __restrict chunk_map,   // chunk index -> slot
+            const size_t chunk_count,             // works only with power of 2
+            sycl::uchar* const __restrict digest, // 32 -bytes BLAKE3 digest
+            sycl::cl_ulong* const __restrict ts,  // kernel exec time in `ns`
+            const wait_strategy ws,               // how host waits for kernel
+            wait_stats_t* const __restrict stats  // host cost of waiting
+)
+{
+  // minimum 1MB input size for this implementation
+  assert(chunk_count >= (1 << 10));
+  assert((chunk_count & (chunk_count - 1)) == 0); // ensure power of 2
+
+  const size_t mem_size = (chunk_count * OUT_LEN) << 1;
+  uint32_t* mem = static_cast<uint32_t*>(sycl::malloc_device(mem_size, q));
+
+  const uint64_t submitted_at = host_now_ns();
+  sycl::event evt = submit_hash<kernelBlake3HashSparse, true>(
+    q, packed, chunk_map, chunk_count, mem, digest);
+
+  wait_event(evt, ws, submitted_at, stats);
+  sycl::free(mem, q);
+
+  if (ts != nullptr) {
+    *ts = time_event(evt);
+  }
+}
+
+// Computes BLAKE3 digest of file, while uploading only its data chunks to
+// accelerator, writing 32 -bytes digest to host memory `digest`
+//
+// File size must be ( chunk_count * 1024 ) -bytes, with same constraints as
+// `hash`; `data_chunks` ( if not nullptr ) is set to number of chunks which
+// were actually read and uploaded
+//
+// Data extents are discovered first, so that pinned host memory is allocated
+// only for data chunks, not for whole ( mostly hole ) file
+//
+// Returns false on I/O error or when file size doesn't satisfy above
+// constraints, in which case `errno` is set to EINVAL
+bool
+hash_file_sparse(sycl::queue& q,
+                 const int fd,
+                 sycl::uchar* const __restrict digest,
+                 size_t* const __restrict data_chunks,
+                 sycl::cl_ulong* const __restrict ts)
+{
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    return false;
+  }
+
+  const size_t f_size = static_cast<size_t>(st.st_size);
+  const size_t chunk_count = f_size / CHUNK_LEN;
+
+  // same constraints as `hash`, otherwise digest would be computed over
+  // truncated file
+  if (f_size != chunk_count * CHUNK_LEN || chunk_count < (1 << 10) ||
+      (chunk_count & (chunk_count - 1)) != 0) {
+    errno = EINVAL;
+    return false;
+  }
+
+  size_t* map_h = static_cast<size_t*>(
+    sycl::malloc_host(chunk_count * sizeof(size_t), q));
+
+  const ssize_t slots = map_data_chunks(fd, chunk_count, map_h);
+  if (slots < 0) {
+    sycl::free(map_h, q);
+    return false;
+  }
+
+  // at least one slot is allocated, even when whole file is a hole
+  const size_t p_size = std::max<size_t>(slots, 1) * CHUNK_LEN;
+
+  // pinned host memory, so that data chunks can be DMA-ed to device
+  sycl::uchar* packed_h =
+    static_cast<sycl::uchar*>(sycl::malloc_host(p_size, q));
+
+  if (!read_data_chunks(fd, chunk_count, map_h, packed_h)) {
+    sycl::free(packed_h, q);
+    sycl::free(map_h, q);
+    return false;
+  }
+
+  sycl::uchar* packed_d =
+    static_cast<sycl::uchar*>(sycl::malloc_device(p_size, q));
+  size_t* map_d =
+    static_cast<size_t*>(sycl::malloc_device(chunk_count * sizeof(size_t), q));
+  sycl::uchar* digest_d =
+    static_cast<sycl::uchar*>(sycl::malloc_device(OUT_LEN, q));
+
+  // only data chunks cross PCIe
+  sycl::event evt_0 = q.memcpy(packed_d, packed_h, slots * CHUNK_LEN);
+  sycl::event evt_1 = q.memcpy(map_d, map_h, chunk_count * sizeof(size_t));
+  evt_0.wait();
+  evt_1.wait();
+
+  hash_sparse(q,
+              packed_d,
+              map_d,
+              chunk_count,
+              digest_d,
+              ts,
+              wait_strategy::blocking,
+              nullptr);
+  q.memcpy(digest, digest_d, OUT_LEN).wait();
+
+  if (data_chunks != nullptr) {
+    *data_chunks = static_cast<size_t>(slots);
+  }
+
+  sycl::free(packed_h, q);
+  sycl::free(map_h, q);
+  sycl::free(packed_d, q);
+  sycl::free(map_d, q);
+  sycl::free(digest_d, q);
+
+  return true;
+}
+}
@@ -0,0 +1,176 @@
+#pragma once
+#include "blake3.hpp"
+
+namespace blake3 {
+
+// Just to avoid kernel name mangling in optimization report
+class kernelBlake3HashStaged;
+
+// Default number of iterations ( of chunk compression loop ) for which message
+// blocks are prefetched ahead of compression, see board.hpp
+constexpr size_t STAGE_DEPTH = BOARD.stage_depth;
+
+// Compile time check for staging depth, to ensure that it's power of 2 and
+// whole staging buffer ( 2 x depth x 256 -bytes ) fits in a few M20K blocks
+static constexpr bool
+is_valid_stage_depth(const size_t depth)
+{
+  return depth > 0 && depth <= 64 && (depth & (depth - 1)) == 0;
+}
+
+// BLAKE3 hash function, which computes same digest as `hash( ... )`, while
+// staging input message blocks in on-chip double buffered ( M20K ) memory
+//
+// In `hash( ... )`, each lane's 64 -bytes message block is read from global
+// memory right before being compressed, so global memory read latency sits on
+// critical path of chunk compression loop. Here chunk compression loop is
+// tiled into groups of `depth` iterations, where each iteration compresses one
+// message block of four consecutive chunks ( i.e. 256 -bytes ). While message
+// blocks of current tile are being consumed from one half of staging buffer,
+// message blocks of next tile are prefetched into other half, so that global
+// memory reads are issued `depth` iterations ahead of their use
+//
+// Same input constraints as `hash( ... )` apply
+template<size_t depth = STAGE_DEPTH>
+void
+hash_staged(sycl::queue& q,                       // SYCL compute queue
+            sycl::uchar* const __restrict input,  // it'll never be modified !
+            const size_t i_size,                  // bytes
+            const size_t chunk_count,             // works only with power of 2
+            sycl::uchar* const __restrict digest, // 32 -bytes BLAKE3 digest
+            sycl::cl_ulong* const __restrict ts   // kernel exec time in `ns`
+            ) requires(is_valid_stage_depth(depth))
+{
+  assert(i_size == chunk_count * CHUNK_LEN);
+  assert(chunk_count >= (1 << 10));
+  assert((chunk_count & (chunk_count - 1)) == 0); // ensure power of 2
+
+  // same layout of intermediate chaining values as `hash( ... )` uses
+  const size_t mem_size = (chunk_count * OUT_LEN) << 1;
+  uint32_t* mem = static_cast<uint32_t*>(sycl::malloc_device(mem_size, q));
+
+  sycl::event evt = q.single_task<kernelBlake3HashStaged>(
+    [=]() [[intel::kernel_args_restrict]] {
+      // Just to hint that Load Store Units don't need to interface with host
+      sycl::device_ptr<sycl::uchar> i_ptr{ input };
+      sycl::device_ptr<uint32_t> mem_ptr{ mem };
+      sycl::device_ptr<sycl::uchar> o_ptr{ digest };
+
+      // two halves of staging buffer, each holding message blocks of four
+      // lanes for `depth` -many iterations
+      //
+      // one bank per lane, each 64 -bytes wide, so that one message block is
+      // read ( for compression ) and one is written ( by prefetch ) in every
+      // iteration, without stalling
+      [[intel::fpga_memory("BLOCK_RAM"),
+        intel::bankwidth(64),
+        intel::numbanks(4)]] uint32_t stage[2][depth][4][16];
+
+      [[intel::fpga_register]] uint32_t msg[4][16];
+      [[intel::fpga_register]] uint32_t state[4][16];
+
+      const size_t o_offset = chunk_count << 3;
+
+      // each iteration compresses one message block of four consecutive
+      // chunks, so j-th message blocks of all chunks are covered by
+      // ( chunk_count / 4 ) -many iterations
+      const size_t itr_cnt = chunk_count << 2;
+      const size_t itr_per_blk_log = bin_log(chunk_count >> 2);
+      const size_t itr_per_blk_mask = (chunk_count >> 2) - 1;
+
+      // reads four message blocks, to be compressed in `itr` -th iteration,
+      // from global memory into k-th slot of `half` of staging buffer
+      auto prefetch = [&](const size_t half,
+                          const size_t k,
+                          const size_t itr) {
+        const size_t chunk_idx = (itr & itr_per_blk_mask) << 2;
+        const size_t msg_blk_idx = itr >> itr_per_blk_log;
+
+#pragma unroll 4
+        for (size_t l = 0; l < 4; l++) {
+          const size_t i_offset = ((chunk_idx + l) << 10) + (msg_blk_idx << 6);
+
+#pragma unroll 16
+          for (size_t i = 0; i < 16; i++) {
+            stage[half][k][l][i] =
+              word_from_le_bytes(i_ptr + i_offset + (i << 2));
+          }
+        }
+      };
+
+      // fill first half, before compression of first tile starts
+      for (size_t k = 0; k < depth; k++) {
+        prefetch(0, k, k);
+      }
+
+      const size_t tile_cnt = itr_cnt / depth;
+
+      for (size_t t = 0; t < tile_cnt; t++) {
+        const size_t cur = t & 1ul;
+
+        // prefetch ( into other half ) and compression ( from current half )
+        // never touch same half of staging buffer
+        [[intel::ivdep]] for (size_t k = 0; k < depth; k++)
+        {
+          const size_t itr = t * depth + k;
+
+          if (itr + depth < itr_cnt) {
+            prefetch(cur ^ 1ul, k, itr + depth);
+          }
+
+          const size_t chunk_idx = (itr & itr_per_blk_mask) << 2;
+          const size_t msg_blk_idx = itr >> itr_per_blk_log;
+
+#pragma unroll 4
+          for (size_t l = 0; l < 4; l++) {
+            sycl::private_ptr<uint32_t> state_ptr{ state[l] };
+            sycl::private_ptr<uint32_t> msg_ptr{ msg[l] };
+
+            const size_t c_idx = chunk_idx + l;
+            const size_t o_offset_l = o_offset + (c_idx << 3);
+
+            // input chaining value is either constant initial hash values or
+            // output chaining value of previous message block of same chunk
+#pragma unroll 8
+            for (size_t i = 0; i < 8; i++) {
+              state_ptr[i] =
+                msg_blk_idx == 0 ? IV[i] : mem_ptr[o_offset_l + i];
+            }
+#pragma unroll 4
+            for (size_t i = 0; i < 4; i++) {
+              state_ptr[8 + i] = IV[i];
+            }
+
+            state_ptr[12] = static_cast<uint32_t>(c_idx & 0xffffffff);
+            state_ptr[13] = static_cast<uint32_t>(c_idx >> 32);
+            state_ptr[14] = BLOCK_LEN;
+            state_ptr[15] = (msg_blk_idx == 0 ? CHUNK_START : 0) |
+                            (msg_blk_idx == 15 ? CHUNK_END : 0);
+
+          // message block is already on-chip, staged `depth` iterations ago
+#pragma unroll 16
+            for (size_t i = 0; i < 16; i++) {
+              msg_ptr[i] = stage[cur][k][l][i];
+            }
+
+            compress(state_ptr, msg_ptr);
+
+#pragma unroll 8
+            for (size_t i = 0; i < 8; i++) {
+              mem_ptr[o_offset_l + i] = state_ptr[i];
+            }
+          }
+        }
+      }
+
+      merkelize(mem_ptr, o_ptr, chunk_count);
+    });
+
+  evt.wait();
+  sycl::free(mem, q);
+
+  if (ts != nullptr) {
+    *ts = time_event(evt);
+  }
+}
+}
@@ -0,0 +1,205 @@
+#pragma once
+#include "batch.hpp"
+#include "host.hpp"
+#include <vector>
+
+namespace blake3 {
+
+// Default maximum number of chunks compressed in one engine tick
+constexpr size_t MAX_TICK_CHUNKS = 1 << 12;
+
+// Multiplexes incremental hashing of many concurrently open streams ( say
+// thousands of uploads, each receiving data in pieces ) on one accelerator
+//
+// Each stream keeps its state in a table, which is
+//
+// - bytes received, but not yet compressed
+// - counter of next chunk to be compressed
+// - CV stack i.e. roots of complete subtrees, compressed so far
+//
+// On each `tick( ... )`, full chunks of all streams are gathered into one
+// batch, whose chaining values are computed using single `chunk_cvs` kernel
+// launch ( with correct chunk counter per chunk ), then they're merged into CV
+// stack of respective stream, on host
+//
+// Last chunk of a stream is never compressed in a tick, even when it's full,
+// because it may turn out to be root ( or whole input ), which can only be
+// known on `finalize( ... )`, where it's compressed on host
+class stream_engine
+{
+public:
+  stream_engine(sycl::queue& q, const size_t max_chunks = MAX_TICK_CHUNKS)
+    : q(q)
+    , max_chunks(max_chunks)
+  {
+    chunks_h = static_cast<sycl::uchar*>(
+      sycl::malloc_host(max_chunks * CHUNK_LEN, q));
+    counters_h = static_cast<uint64_t*>(
+      sycl::malloc_host(max_chunks * sizeof(uint64_t), q));
+    cvs_h = static_cast<uint32_t*>(sycl::malloc_host(max_chunks * OUT_LEN, q));
+
+    chunks_d = static_cast<sycl::uchar*>(
+      sycl::malloc_device(max_chunks * CHUNK_LEN, q));
+    counters_d = static_cast<uint64_t*>(
+      sycl::malloc_device(max_chunks * sizeof(uint64_t), q));
+    cvs_d =
+      static_cast<uint32_t*>(sycl::malloc_device(max_chunks * OUT_LEN, q));
+  }
+
+  ~stream_engine()
+  {
+    sycl::free(chunks_h, q);
+    sycl::free(counters_h, q);
+    sycl::free(cvs_h, q);
+    sycl::free(chunks_d, q);
+    sycl::free(counters_d, q);
+    sycl::free(cvs_d, q);
+  }
+
+  stream_engine(const stream_engine&) = delete;
+  stream_engine& operator=(const stream_engine&) = delete;
+
+  // Opens a new stream, returning its identifier, which stays valid until
+  // stream is finalized ( after that, it may be reused )
+  size_t open()
+  {
+    if (!free_ids.empty()) {
+      const size_t id = free_ids.back();
+      free_ids.pop_back();
+
+      table[id].live = true;
+      return id;
+    }
+
+    table.emplace_back();
+    table.back().live = true;
+    return table.size() - 1;
+  }
+
+  // Appends `len` -many bytes to stream, which are compressed in some later
+  // tick
+  void update(const size_t id, const sycl::uchar* const data, const size_t len)
+  {
+    assert(id < table.size() && table[id].live);
+
+    std::vector<sycl::uchar>& pending = table[id].pending;
+    pending.insert(pending.end(), data, data + len);
+  }
+
+  // Compresses at most `max_chunks` -many full chunks, gathered from all open
+  // streams ( round-robin, starting after the stream where last tick stopped,
+  // so that no stream starves ), using one kernel launch, then merges resulting
+  // chaining values into CV stack of respective streams
+  //
+  // Returns number of chunks compressed, 0 when no stream had a compressible
+  // chunk
+  size_t tick()
+  {
+    // ( stream id, number of chunks ) taken from each stream, in batch order
+    std::vector<std::pair<size_t, size_t>> taken;
+    size_t chunk_cnt = 0;
+
+    const size_t stream_cnt = table.size();
+    const size_t start = cursor;
+
+    for (size_t i = 0; i < stream_cnt && chunk_cnt < max_chunks; i++) {
+      const size_t id = (start + i) % stream_cnt;
+      stream_t& st = table[id];
+
+      const size_t cnt = std::min(ready_chunks(st), max_chunks - chunk_cnt);
+      if (!st.live || cnt == 0) {
+        continue;
+      }
+
+      std::memcpy(chunks_h + chunk_cnt * CHUNK_LEN,
+                  st.pending.data(),
+                  cnt * CHUNK_LEN);
+      for (size_t j = 0; j < cnt; j++) {
+        counters_h[chunk_cnt + j] = st.counter + j;
+      }
+
+      taken.emplace_back(id, cnt);
+      chunk_cnt += cnt;
+      cursor = (id + 1) % stream_cnt;
+    }
+
+    if (chunk_cnt == 0) {
+      return 0;
+    }
+
+    q.memcpy(chunks_d, chunks_h, chunk_cnt * CHUNK_LEN).wait();
+    q.memcpy(counters_d, counters_h, chunk_cnt * sizeof(uint64_t)).wait();
+    submit_chunk_cvs<kernelBlake3ChunkCVs, false>(
+      q, chunks_d, nullptr, counters_d, chunk_cnt, cvs_d)
+      .wait();
+    q.memcpy(cvs_h, cvs_d, chunk_cnt * OUT_LEN).wait();
+
+    size_t offset = 0;
+    for (const auto& [id, cnt] : taken) {
+      stream_t& st = table[id];
+
+      for (size_t j = 0; j < cnt; j++) {
+        cv_stack_push(st.stack, ++st.counter, cvs_h + ((offset + j) << 3));
+      }
+
+      st.pending.erase(st.pending.begin(),
+                       st.pending.begin() + cnt * CHUNK_LEN);
+      offset += cnt;
+    }
+
+    return chunk_cnt;
+  }
+
+  // Computes 32 -bytes BLAKE3 digest of all bytes appended to stream, then
+  // closes it
+  //
+  // Pending full chunks of this stream are compressed first ( in ticks, so
+  // that other streams also make progress ), last chunk is compressed on host
+  void finalize(const size_t id, sycl::uchar* const digest)
+  {
+    assert(id < table.size() && table[id].live);
+
+    while (ready_chunks(table[id]) > 0) {
+      tick();
+    }
+
+    stream_t& st = table[id];
+    cv_stack_root(
+      st.stack, st.pending.data(), st.pending.size(), st.counter, digest);
+
+    st = stream_t{};
+    free_ids.push_back(id);
+  }
+
+private:
+  struct stream_t
+  {
+    bool live = false;
+    std::vector<sycl::uchar> pending;
+    uint64_t counter = 0;
+    cv_stack_t stack;
+  };
+
+  // Number of full chunks of stream, which can be compressed now i.e. all
+  // full chunks, which are followed by at least one more byte
+  static size_t ready_chunks(const stream_t& st)
+  {
+    return st.pending.empty() ? 0 : (st.pending.size() - 1) / CHUNK_LEN;
+  }
+
+  sycl::queue& q;
+  const size_t max_chunks;
+
+  std::vector<stream_t> table;
+  std::vector<size_t> free_ids;
+  size_t cursor = 0;
+
+  // pinned host and device buffers, reused across ticks
+  sycl::uchar* chunks_h;
+  uint64_t* counters_h;
+  uint32_t* cvs_h;
+  sycl::uchar* chunks_d;
+  uint64_t* counters_d;
+  uint32_t* cvs_d;
+};
+}
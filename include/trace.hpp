@@ -0,0 +1,301 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Offline evaluation of global memory schedules of BLAKE3 kernels, without
+// compiling for FPGA, by generating exact address trace of a schedule and
+// running it through a simple DDR model
+//
+// Note, this file is host only, it doesn't depend on SYCL
+namespace blake3::trace {
+
+constexpr size_t CHUNK_LEN = 1024; // bytes
+constexpr size_t BLOCK_LEN = 64;   // bytes
+constexpr size_t OUT_LEN = 32;     // bytes
+
+// Global memory schedules, which can be traced
+//
+// - interleaved : j-th message blocks of all chunks are compressed, before any
+// (j + 1)-th message block, spilling chaining values to global memory after
+// each message block, which is what `blake3::hash( ... )` does
+// - chunk_major : all sixteen message blocks of four consecutive chunks are
+// compressed, before moving to next four chunks, keeping chaining values
+// on-chip, only leaf chaining values are written to global memory
+// - tiled : interleaved schedule, but restricted to a tile of `tile` -many
+// consecutive chunks at a time, so spilled chaining values of a tile are
+// reused soon after being written
+enum class schedule
+{
+  interleaved,
+  chunk_major,
+  tiled
+};
+
+// Kind of global memory allocation being accessed
+enum class region
+{
+  input, // message bytes
+  cvs    // intermediate chaining values
+};
+
+// One global memory access, issued by kernel
+struct access_t
+{
+  region reg;
+  uint64_t offset; // bytes, from start of region
+  uint32_t size;   // bytes
+  bool write;
+};
+
+// Generates global memory address trace of BLAKE3 kernel computing digest of
+// `chunk_count` -many chunks ( power of 2, >= 4 ), using given schedule, in
+// same order as kernel issues them, handing each access to `emit`, as it's
+// generated, so that trace of large input ( ~50M accesses for 1GB input ) is
+// never materialized
+//
+// Chaining value region has same layout as `blake3::hash( ... )` uses i.e.
+// leaves live in second half and level i of binary merkle tree is reduced into
+// first half of level i's memory; parent reduction is same for all schedules
+template<typename Sink>
+void
+generate(const schedule sched,
+         const size_t chunk_count,
+         const size_t tile,
+         Sink&& emit)
+{
+  assert(chunk_count >= 4 && (chunk_count & (chunk_count - 1)) == 0);
+  assert(sched != schedule::tiled ||
+         (tile >= 4 && tile <= chunk_count && (tile & (tile - 1)) == 0));
+
+  const uint64_t leaf_offset = chunk_count * OUT_LEN;
+
+  // chaining value of chunk, living in leaf level
+  auto cv_offset = [&](const size_t chunk_idx) {
+    return leaf_offset + chunk_idx * OUT_LEN;
+  };
+
+  // compresses j-th message block of four consecutive chunks, starting at
+  // `chunk_idx`, where `spill` denotes whether chaining values live in
+  // global memory, between message blocks
+  auto four_lanes = [&](const size_t chunk_idx,
+                        const size_t j,
+                        const bool spill) {
+    if (spill && j > 0) {
+      for (size_t l = 0; l < 4; l++) {
+        const uint64_t offset = cv_offset(chunk_idx + l);
+        emit(access_t{ region::cvs, offset, OUT_LEN, false });
+      }
+    }
+    for (size_t l = 0; l < 4; l++) {
+      const uint64_t offset = (chunk_idx + l) * CHUNK_LEN + j * BLOCK_LEN;
+      emit(access_t{ region::input, offset, BLOCK_LEN, false });
+    }
+    if (spill || j == 15) {
+      for (size_t l = 0; l < 4; l++) {
+        const uint64_t offset = cv_offset(chunk_idx + l);
+        emit(access_t{ region::cvs, offset, OUT_LEN, true });
+      }
+    }
+  };
+
+  switch (sched) {
+    case schedule::interleaved:
+      for (size_t j = 0; j < 16; j++) {
+        for (size_t i = 0; i < chunk_count; i += 4) {
+          four_lanes(i, j, true);
+        }
+      }
+      break;
+    case schedule::chunk_major:
+      for (size_t i = 0; i < chunk_count; i += 4) {
+        for (size_t j = 0; j < 16; j++) {
+          four_lanes(i, j, false);
+        }
+      }
+      break;
+    case schedule::tiled:
+      for (size_t t = 0; t < chunk_count; t += tile) {
+        for (size_t j = 0; j < 16; j++) {
+          for (size_t i = t; i < t + tile; i += 4) {
+            four_lanes(i, j, true);
+          }
+        }
+      }
+      break;
+  }
+
+  // parent levels, two parents at a time, see `blake3::merkelize`
+  size_t levels = 0;
+  for (size_t n = chunk_count; n > 2; n >>= 1) {
+    levels++;
+  }
+
+  for (size_t l = 0; l < levels; l++) {
+    const uint64_t i_offset = (chunk_count * OUT_LEN) >> l;
+    const uint64_t o_offset = i_offset >> 1;
+    const size_t node_cnt = chunk_count >> (l + 1);
+
+    for (size_t i = 0; i < node_cnt; i += 2) {
+      emit(access_t{ region::cvs, i_offset + i * 64, 64, false });
+      emit(access_t{ region::cvs, i_offset + (i + 1) * 64, 64, false });
+      emit(access_t{ region::cvs, o_offset + i * 32, 32, true });
+      emit(access_t{ region::cvs, o_offset + (i + 1) * 32, 32, true });
+    }
+  }
+
+  // root
+  emit(access_t{ region::cvs, 64, 64, false });
+}
+
+// Same as above, but collects whole trace, for small inputs
+std::vector<access_t>
+generate(const schedule sched, const size_t chunk_count, const size_t tile = 0)
+{
+  std::vector<access_t> trace;
+  generate(sched, chunk_count, tile, [&](const access_t& a) {
+    trace.push_back(a);
+  });
+
+  return trace;
+}
+
+// Parameters of simple DDR model, defaults resemble one DDR4-2400 channel with
+// 64 -bit wide data bus, timings in memory clock cycles
+struct ddr_config_t
+{
+  size_t burst_bytes = 64; // bytes moved by one burst ( BL8 )
+  size_t banks = 16;
+  size_t row_bytes = 8192; // row buffer size, per bank
+  size_t t_burst = 4;      // data bus occupancy of one burst
+  size_t t_rp = 16;        // precharge, when closing open row
+  size_t t_rcd = 16;       // activate, when opening row
+  size_t t_wtr = 8;        // bus turnaround, between write and read
+  double peak_gbps = 19.2; // peak bandwidth of channel, in GB/s
+};
+
+// Outcome of running a trace through DDR model
+struct ddr_stats_t
+{
+  uint64_t accesses = 0;
+  uint64_t bytes_requested = 0;
+  uint64_t bursts = 0;
+  uint64_t row_hits = 0;
+  uint64_t row_misses = 0;
+  uint64_t turnarounds = 0;
+  uint64_t cycles = 0;
+
+  // fraction of cycles, where data bus moves requested bytes
+  double efficiency(const ddr_config_t& cfg) const
+  {
+    const double useful = static_cast<double>(bytes_requested) /
+                          static_cast<double>(cfg.burst_bytes) *
+                          static_cast<double>(cfg.t_burst);
+    return cycles == 0 ? 0. : useful / static_cast<double>(cycles);
+  }
+
+  // estimated effective bandwidth, in GB/s
+  double bandwidth(const ddr_config_t& cfg) const
+  {
+    return efficiency(cfg) * cfg.peak_gbps;
+  }
+};
+
+// Simple DDR model, which accesses of a trace are issued to, one at a time,
+// with open page policy, where address is mapped as row | bank | column, input
+// region starts at address 0 and chaining value region starts at next row
+// boundary ( of all banks ) after input region
+//
+// Each access is split into bursts, where a burst costs `t_burst` cycles, plus
+// precharge/ activate when it misses open row of its bank, plus turnaround when
+// data bus switches from write to read. Command overlapping across banks is
+// not modeled, so estimates are pessimistic for bank parallel schedules; use
+// it to rank schedules, not to predict absolute bandwidth
+class ddr_model
+{
+public:
+  ddr_model(const size_t i_size, const ddr_config_t& cfg = ddr_config_t{})
+    : cfg(cfg)
+    , stripe(cfg.row_bytes * cfg.banks)
+    , cvs_base(((i_size + stripe - 1) / stripe) * stripe)
+    , open_row(cfg.banks, -1)
+  {
+  }
+
+  void issue(const access_t& a)
+  {
+    const uint64_t base = a.reg == region::input ? 0 : cvs_base;
+    const uint64_t begin = base + a.offset;
+    const uint64_t end = begin + a.size;
+
+    st.accesses++;
+    st.bytes_requested += a.size;
+
+    if (last_write && !a.write) {
+      st.turnarounds++;
+      st.cycles += cfg.t_wtr;
+    }
+    last_write = a.write;
+
+    const uint64_t first = begin / cfg.burst_bytes;
+    const uint64_t last = (end - 1) / cfg.burst_bytes;
+
+    for (uint64_t b = first; b <= last; b++) {
+      const uint64_t addr = b * cfg.burst_bytes;
+      const size_t bank = (addr / cfg.row_bytes) % cfg.banks;
+      const int64_t row = static_cast<int64_t>(addr / stripe);
+
+      if (open_row[bank] == row) {
+        st.row_hits++;
+      } else {
+        st.row_misses++;
+        st.cycles += (open_row[bank] < 0 ? 0 : cfg.t_rp) + cfg.t_rcd;
+        open_row[bank] = row;
+      }
+
+      st.bursts++;
+      st.cycles += cfg.t_burst;
+    }
+  }
+
+  const ddr_stats_t& stats() const { return st; }
+
+private:
+  const ddr_config_t cfg;
+  const uint64_t stripe;
+  const uint64_t cvs_base;
+
+  std::vector<int64_t> open_row;
+  bool last_write = false;
+  ddr_stats_t st;
+};
+
+// Runs whole address trace through DDR model, see `ddr_model`
+ddr_stats_t
+simulate(const std::vector<access_t>& trace,
+         const size_t i_size,
+         const ddr_config_t& cfg = ddr_config_t{})
+{
+  ddr_model m{ i_size, cfg };
+  for (const access_t& a : trace) {
+    m.issue(a);
+  }
+
+  return m.stats();
+}
+
+// Generates address trace of given schedule and runs it through DDR model,
+// one access at a time, so that memory use doesn't grow with input size
+ddr_stats_t
+simulate(const schedule sched,
+         const size_t chunk_count,
+         const size_t tile,
+         const ddr_config_t& cfg = ddr_config_t{})
+{
+  ddr_model m{ chunk_count * CHUNK_LEN, cfg };
+  generate(sched, chunk_count, tile, [&](const access_t& a) { m.issue(a); });
+
+  return m.stats();
+}
+}
@@ -1,5 +1,27 @@
 #pragma once
-#include "blake3.hpp"
+#include "graph.hpp"
+#include "multipart.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Signature of BLAKE3 hash functions ( say `blake3::hash` or
+// `blake3::hash_staged` ), which can be benchmarked using following routine
+using hasher_t = void (*)(sycl::queue&,
+                          sycl::uchar* const,
+                          const size_t,
+                          const size_t,
+                          sycl::uchar* const,
+                          sycl::cl_ulong* const);
 
 // Executes BLAKE3 kernels with same input size `itr_cnt` -many times and
 // computes average execution time of following SYCL commands
@@ -7,11 +29,14 @@
 // - host -> device input tx time
 // - kernel execution time
 // - device -> host input tx time
+//
+// Kernel being benchmarked can be chosen using `hasher`
 void
 avg_kernel_exec_tm(sycl::queue& q,
                    size_t chunk_count,
                    size_t itr_cnt,
-                   double* const ts)
+                   double* const ts,
+                   hasher_t hasher = blake3::hash)
 {
   constexpr size_t ts_size = sizeof(sycl::cl_ulong) * 3;
 
@@ -42,7 +67,7 @@ avg_kernel_exec_tm(sycl::queue& q,
 
     // compute on accelerator, wait until completed
     sycl::cl_ulong ts = 0; // exec time of kernels
-    blake3::hash(q, i_d, i_size, chunk_count, o_d, &ts);
+    hasher(q, i_d, i_size, chunk_count, o_d, &ts);
 
     // device to host digest tx
     sycl::event evt_1 = q.memcpy(o_h, o_d, blake3::OUT_LEN);
@@ -68,6 +93,659 @@ avg_kernel_exec_tm(sycl::queue& q,
   std::free(ts_rnd);
 }
 
+// Executes BLAKE3 kernel with same input size `itr_cnt` -many times, while host
+// waits for its completion using `ws`, computing average of
+//
+// - kernel execution time
+// - CPU time consumed by host thread, while waiting
+// - wake up latency i.e. time from kernel end till host observes it
+//
+// See `wait_event`; requires profiling enabled queue
+void
+avg_wait_cost(sycl::queue& q,
+              size_t chunk_count,
+              size_t itr_cnt,
+              wait_strategy ws,
+              double* const ts)
+{
+  const size_t i_size = chunk_count * blake3::CHUNK_LEN;
+
+  sycl::uchar* i_d = static_cast<sycl::uchar*>(sycl::malloc_device(i_size, q));
+  sycl::uchar* o_d =
+    static_cast<sycl::uchar*>(sycl::malloc_device(blake3::OUT_LEN, q));
+
+  q.memset(i_d, 0xff, i_size).wait();
+
+  sycl::cl_ulong ts_sum[3] = {};
+
+  for (size_t i = 0; i < itr_cnt; i++) {
+    sycl::cl_ulong ts_k = 0;
+    wait_stats_t stats;
+
+    blake3::hash(q, i_d, i_size, chunk_count, o_d, &ts_k, ws, &stats);
+
+    ts_sum[0] += ts_k;
+    ts_sum[1] += stats.cpu_ns;
+    ts_sum[2] += stats.wake_ns;
+  }
+
+  for (size_t i = 0; i < 3; i++) {
+    *(ts + i) = (double)ts_sum[i] / (double)itr_cnt;
+  }
+
+  sycl::free(i_d, q);
+  sycl::free(o_d, q);
+}
+
+// Hashes `itr_cnt` -many payloads of `chunk_count` -many chunks, one after
+// another, using `blake3::hash_graph`, returning average host observed latency
+// ( in nanoseconds ) of one payload i.e. input tx, kernel and digest tx
+//
+// When `record` is set, each payload is one replay of recorded command graph (
+// if extension is available ), otherwise three commands are enqueued
+double
+avg_graph_latency(sycl::queue& q,
+                  size_t chunk_count,
+                  size_t itr_cnt,
+                  bool record)
+{
+  blake3::hash_graph g{ q, chunk_count, record };
+  std::memset(g.payload(), 0xff, chunk_count * blake3::CHUNK_LEN);
+
+  // first replay isn't timed, it pays one time setup cost
+  g.replay();
+
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < itr_cnt; i++) {
+    g.payload()[0] = static_cast<sycl::uchar>(i);
+    g.replay();
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  const auto ns =
+    std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  return (double)ns / (double)itr_cnt;
+}
+
+// Compresses chain of `blk_cnt` -many message blocks on host ( like hashing
+// `blk_cnt * 64` -bytes input, which fits in one chunk ), `itr_cnt` -many
+// times, returning average time ( in nanoseconds ) taken by one chain
+//
+// When `vectorized` is set, row vectorized compression function is used,
+// otherwise `compress( ... )`, which is also synthesized on FPGA; caller must
+// check `blake3::has_sse41()` before asking for vectorized one
+double
+avg_host_compress_tm(size_t blk_cnt, size_t itr_cnt, bool vectorized)
+{
+  uint32_t cv[8];
+  uint32_t msg[16];
+  uint32_t state[16];
+
+  std::copy(blake3::IV, blake3::IV + 8, cv);
+
+  const auto start = std::chrono::steady_clock::now();
+
+  for (size_t i = 0; i < itr_cnt; i++) {
+    for (size_t j = 0; j < blk_cnt; j++) {
+      // message words depend on previous chaining value, so that compressions
+      // can't be hoisted out of loop
+      for (size_t k = 0; k < 16; k++) {
+        msg[k] = cv[k & 7] ^ static_cast<uint32_t>(j);
+      }
+
+      std::copy(cv, cv + 8, state);
+      std::copy(blake3::IV, blake3::IV + 4, state + 8);
+      state[12] = static_cast<uint32_t>(i);
+      state[13] = 0;
+      state[14] = blake3::BLOCK_LEN;
+      state[15] = j == 0 ? blake3::CHUNK_START : 0;
+
+#if defined BLAKE3_HOST_SSE41
+      if (vectorized) {
+        blake3::compress_sse41(state, msg);
+      } else {
+        blake3::compress(sycl::private_ptr<uint32_t>{ state },
+                         sycl::private_ptr<uint32_t>{ msg });
+      }
+#else
+      blake3::compress(sycl::private_ptr<uint32_t>{ state },
+                       sycl::private_ptr<uint32_t>{ msg });
+#endif
+
+      std::copy(state, state + 8, cv);
+    }
+  }
+
+  const auto end = std::chrono::steady_clock::now();
+
+  // so that compiler can't drop chains, whose output is never used
+  volatile uint32_t sink = cv[0];
+  static_cast<void>(sink);
+
+  const auto ns =
+    std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  return (double)ns / (double)itr_cnt;
+}
+
+// Relative change ( between first and last quarters of soak run ) beyond which
+// throughput, latency or resident memory is flagged as drifting
+constexpr double SOAK_DRIFT = 0.05;
+
+// Throughput, latency and memory footprint observed during one interval of
+// soak run
+struct soak_interval_t
+{
+  double elapsed_s; // since start of run, at end of interval
+  double length_s;  // of this interval
+  size_t requests;
+  size_t bytes;
+  double mean_ns; // host observed latency of one request
+  double max_ns;
+  size_t rss_kb; // resident set size of process, at end of interval
+  bool partial;  // cut short by end of run, so shorter than `interval_s`
+};
+
+// Resident set size of this process, in KB, read from `/proc/self/statm` ( 0,
+// when unavailable )
+static inline size_t
+rss_kb()
+{
+  std::FILE* f = std::fopen("/proc/self/statm", "r");
+  if (f == nullptr) {
+    return 0;
+  }
+
+  size_t pages = 0;
+  size_t resident = 0;
+  const int n = std::fscanf(f, "%zu %zu", &pages, &resident);
+  std::fclose(f);
+
+  return n == 2 ? resident * (static_cast<size_t>(sysconf(_SC_PAGESIZE)) >> 10)
+                : 0;
+}
+
+// Hashes continuously for `duration_s` seconds, using `blake3::hash`, where
+// input sizes ( in chunks ) are taken from `mix` i.e. ( chunk count, weight )
+// pairs, in weighted round robin order, so that runs are repeatable
+//
+// Throughput, host observed latency ( enqueue till digest available, which
+// includes `blake3::hash`'s own allocation and release of intermediate buffer
+// ) and resident memory are recorded for each `interval_s` -seconds interval;
+// `on_interval` ( if set ) is called as soon as an interval ends, so that long
+// runs can be followed live
+std::vector<soak_interval_t>
+run_soak(sycl::queue& q,
+         const std::vector<std::pair<size_t, size_t>>& mix,
+         double duration_s,
+         double interval_s,
+         const std::function<void(const soak_interval_t&)>& on_interval = {})
+{
+  // one input buffer per distinct size, allocated once
+  std::vector<size_t> order;
+  std::vector<sycl::uchar*> inputs;
+
+  for (const auto& [chunk_count, weight] : mix) {
+    sycl::uchar* i_d = static_cast<sycl::uchar*>(
+      sycl::malloc_device(chunk_count * blake3::CHUNK_LEN, q));
+    q.memset(i_d, 0xff, chunk_count * blake3::CHUNK_LEN).wait();
+
+    for (size_t w = 0; w < weight; w++) {
+      order.push_back(inputs.size());
+    }
+    inputs.push_back(i_d);
+  }
+
+  sycl::uchar* o_d =
+    static_cast<sycl::uchar*>(sycl::malloc_device(blake3::OUT_LEN, q));
+
+  // first request of each size isn't recorded, it pays one time setup cost
+  for (size_t i = 0; i < mix.size(); i++) {
+    const size_t chunk_count = mix[i].first;
+    blake3::hash(q,
+                 inputs[i],
+                 chunk_count * blake3::CHUNK_LEN,
+                 chunk_count,
+                 o_d,
+                 nullptr);
+  }
+
+  std::vector<soak_interval_t> series;
+
+  const uint64_t start = host_now_ns();
+  const uint64_t end = start + static_cast<uint64_t>(duration_s * 1e9);
+  const uint64_t step = static_cast<uint64_t>(interval_s * 1e9);
+
+  uint64_t interval_start = start;
+  soak_interval_t cur{};
+  double lat_sum = 0;
+
+  for (size_t r = 0;; r++) {
+    const uint64_t now = host_now_ns();
+
+    if (now >= interval_start + step || now >= end) {
+      cur.elapsed_s = (double)(now - start) * 1e-9;
+      cur.length_s = (double)(now - interval_start) * 1e-9;
+      cur.mean_ns = cur.requests == 0 ? 0 : lat_sum / (double)cur.requests;
+      cur.rss_kb = rss_kb();
+      cur.partial = now < interval_start + step;
+
+      series.push_back(cur);
+      if (on_interval) {
+        on_interval(cur);
+      }
+
+      interval_start = now;
+      cur = soak_interval_t{};
+      lat_sum = 0;
+    }
+    if (now >= end) {
+      break;
+    }
+
+    const size_t i = order[r % order.size()];
+    const size_t chunk_count = mix[i].first;
+    const size_t i_size = chunk_count * blake3::CHUNK_LEN;
+
+    const uint64_t t0 = host_now_ns();
+    blake3::hash(q, inputs[i], i_size, chunk_count, o_d, nullptr);
+    const double lat = (double)(host_now_ns() - t0);
+
+    cur.requests++;
+    cur.bytes += i_size;
+    cur.max_ns = std::max(cur.max_ns, lat);
+    lat_sum += lat;
+  }
+
+  for (sycl::uchar* i_d : inputs) {
+    sycl::free(i_d, q);
+  }
+  sycl::free(o_d, q);
+
+  return series;
+}
+
+// Relative change of throughput, mean latency and resident memory, from first
+// to last quarter of soak run ( positive means grew )
+struct soak_drift_t
+{
+  double throughput;
+  double latency;
+  double rss;
+  bool flagged; // when any of them moved, in bad direction, beyond threshold
+};
+
+// Compares first and last quarters of soak run, flagging throughput drop,
+// latency or resident memory growth beyond `threshold`, which show up as
+// thermal throttling, memory fragmentation or leaks, only after running for a
+// while
+//
+// Trailing partial interval ( when run length isn't a multiple of interval
+// length ) is left out, so that few seconds of it don't stand for whole last
+// quarter
+soak_drift_t
+soak_drift(const std::vector<soak_interval_t>& series,
+           double threshold = SOAK_DRIFT)
+{
+  soak_drift_t drift{};
+
+  size_t n = series.size();
+  if (n > 0 && series[n - 1].partial) {
+    n--;
+  }
+
+  if (n < 2) {
+    return drift;
+  }
+
+  const size_t quarter = std::max<size_t>(n >> 2, 1);
+
+  // ( throughput in bytes/s, mean latency in ns, mean RSS in KB ) of intervals
+  // [from, from + quarter)
+  auto summary = [&](const size_t from) {
+    double bytes = 0, secs = 0, lat = 0, reqs = 0, rss = 0;
+
+    for (size_t i = from; i < from + quarter; i++) {
+      bytes += (double)series[i].bytes;
+      secs += series[i].length_s;
+      lat += series[i].mean_ns * (double)series[i].requests;
+      reqs += (double)series[i].requests;
+      rss += (double)series[i].rss_kb;
+    }
+
+    return std::array<double, 3>{ secs > 0 ? bytes / secs : 0,
+                                  reqs > 0 ? lat / reqs : 0,
+                                  rss / (double)quarter };
+  };
+
+  const auto first = summary(0);
+  const auto last = summary(n - quarter);
+
+  auto change = [](const double from, const double to) {
+    return from > 0 ? (to - from) / from : 0;
+  };
+
+  drift.throughput = change(first[0], last[0]);
+  drift.latency = change(first[1], last[1]);
+  drift.rss = change(first[2], last[2]);
+  drift.flagged = drift.throughput < -threshold ||
+                  drift.latency > threshold || drift.rss > threshold;
+
+  return drift;
+}
+
+// p-th ( 0 <= p <= 1 ) percentile of samples, using nearest rank, while
+// sorting them in place; 0, when there are no samples
+double
+percentile(std::vector<double>& samples, double p)
+{
+  if (samples.empty()) {
+    return 0;
+  }
+
+  std::sort(samples.begin(), samples.end());
+
+  const size_t rank = static_cast<size_t>(std::ceil(p * samples.size()));
+  return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+}
+
+// Aggregate throughput and per request latency, observed while many host
+// threads submit hash requests concurrently
+struct scale_result_t
+{
+  size_t bytes;      // hashed by all threads
+  double elapsed_ns; // from first submission till last thread is done
+  double mean_ns;    // host observed latency of one request
+  double p99_ns;
+};
+
+// `threads` -many host threads call `blake3::hash` concurrently, each hashing
+// `req_cnt` -many inputs of `chunk_count` -many chunks ( each thread has its
+// own input ), where threads either share one queue or get one queue each (
+// `per_thread` ), while queue(s) are in-order or out-of-order ( `in_order` );
+// all queues live on same device and context as `q`
+//
+// Each request pays `blake3::hash`'s own `malloc_device`, wait and `free` of
+// intermediate buffer, which is what's being measured for scalability
+scale_result_t
+run_scaling(sycl::queue& q,
+            size_t threads,
+            bool per_thread,
+            bool in_order,
+            size_t chunk_count,
+            size_t req_cnt)
+{
+  auto make_queue = [&]() {
+    return in_order ? sycl::queue{ q.get_context(),
+                                   q.get_device(),
+                                   sycl::property::queue::in_order() }
+                    : sycl::queue{ q.get_context(), q.get_device() };
+  };
+
+  std::vector<sycl::queue> queues;
+  for (size_t t = 0; t < (per_thread ? threads : 1); t++) {
+    queues.push_back(make_queue());
+  }
+
+  const size_t i_size = chunk_count * blake3::CHUNK_LEN;
+
+  std::vector<sycl::uchar*> inputs(threads);
+  std::vector<sycl::uchar*> outputs(threads);
+
+  for (size_t t = 0; t < threads; t++) {
+    sycl::queue& tq = queues[per_thread ? t : 0];
+
+    inputs[t] = static_cast<sycl::uchar*>(sycl::malloc_device(i_size, tq));
+    outputs[t] =
+      static_cast<sycl::uchar*>(sycl::malloc_device(blake3::OUT_LEN, tq));
+    tq.memset(inputs[t], 0xff, i_size).wait();
+  }
+
+  // first request on each queue isn't timed, it pays one time setup cost
+  for (size_t t = 0; t < queues.size(); t++) {
+    blake3::hash(
+      queues[t], inputs[t], i_size, chunk_count, outputs[t], nullptr);
+  }
+
+  std::vector<std::vector<double>> latencies(threads);
+  std::vector<std::thread> workers;
+
+  const uint64_t start = host_now_ns();
+
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&, t]() {
+      sycl::queue& tq = queues[per_thread ? t : 0];
+      latencies[t].reserve(req_cnt);
+
+      for (size_t r = 0; r < req_cnt; r++) {
+        const uint64_t t0 = host_now_ns();
+        blake3::hash(tq, inputs[t], i_size, chunk_count, outputs[t], nullptr);
+        latencies[t].push_back((double)(host_now_ns() - t0));
+      }
+    });
+  }
+
+  for (auto& w : workers) {
+    w.join();
+  }
+
+  const uint64_t end = host_now_ns();
+
+  std::vector<double> all;
+  for (const auto& l : latencies) {
+    all.insert(all.end(), l.begin(), l.end());
+  }
+
+  double sum = 0;
+  for (const double l : all) {
+    sum += l;
+  }
+
+  scale_result_t res{};
+  res.bytes = threads * req_cnt * i_size;
+  res.elapsed_ns = (double)(end - start);
+  res.mean_ns = sum / (double)all.size();
+  res.p99_ns = percentile(all, 0.99);
+
+  for (size_t t = 0; t < threads; t++) {
+    sycl::queue& tq = queues[per_thread ? t : 0];
+
+    sycl::free(inputs[t], tq);
+    sycl::free(outputs[t], tq);
+  }
+
+  return res;
+}
+
+// One hash request of replayed trace
+struct replay_request_t
+{
+  size_t size;     // bytes
+  uint64_t gap_ns; // inter-arrival time i.e. since previous request arrived
+};
+
+// Reads hash requests from trace file, where each non-empty line ( except
+// those starting with `#` ) is either
+//
+// - `<size in bytes> <inter-arrival time in us>` : one request, replayed in
+// order of appearance, or
+// - `<size in bytes> <inter-arrival time in us> <count>` : histogram bucket
+// i.e. `count` -many such requests, where requests of all buckets are
+// shuffled ( deterministically ), after whole file is read
+//
+// Returns empty list, when file can't be read or some line is malformed
+std::vector<replay_request_t>
+load_trace(const std::string& path)
+{
+  std::ifstream f{ path };
+  if (!f) {
+    return {};
+  }
+
+  std::vector<replay_request_t> reqs;
+  std::vector<replay_request_t> hist;
+
+  std::string line;
+  while (std::getline(f, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    std::istringstream is{ line };
+    size_t size = 0;
+    double gap_us = 0;
+    if (!(is >> size >> gap_us) || gap_us < 0) {
+      return {};
+    }
+
+    const replay_request_t r{ size, static_cast<uint64_t>(gap_us * 1e3) };
+
+    size_t count = 0;
+    if (is >> count) {
+      hist.insert(hist.end(), count, r);
+    } else {
+      reqs.push_back(r);
+    }
+  }
+
+  // Fisher-Yates shuffle, using xorshift64, so that replays are repeatable
+  uint64_t x = 0x9e3779b97f4a7c15ul;
+  for (size_t i = hist.size(); i > 1; i--) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    std::swap(hist[i - 1], hist[x % i]);
+  }
+
+  reqs.insert(reqs.end(), hist.begin(), hist.end());
+  return reqs;
+}
+
+// Backends a replayed request can be routed to
+enum class replay_backend
+{
+  host,  // whole digest computed on host, see `host_hash_copy`
+  device // full chunks compressed on accelerator, see `multipart_assembler`
+};
+
+// Outcome of replaying trace, against one dispatcher configuration
+struct replay_result_t
+{
+  size_t requests;
+  size_t bytes;
+  double elapsed_ns; // from first arrival till last completion
+
+  // host observed latency i.e. from scheduled arrival till digest is available,
+  // so that queueing delay ( when replay falls behind trace ) is included
+  double p50_ns;
+  double p90_ns;
+  double p99_ns;
+  double p999_ns;
+
+  // routing decisions, indexed by `replay_backend`
+  size_t routed[2];
+  size_t routed_bytes[2];
+};
+
+// Replays hash requests, in open loop i.e. each request is started at its
+// scheduled arrival time, no matter whether earlier ones have completed, while
+// dispatcher routes requests of at most `host_max` -bytes to host and others to
+// accelerator
+//
+// Requests are taken, in order of arrival, by `workers` -many host threads (
+// each with its own multipart assembler ), where a worker sleeps till arrival
+// of request it took; so arrivals are only delayed when all workers are busy,
+// in which case queueing delay shows up in latency
+//
+// Pass `host_max` = 0 to route everything ( but empty requests ) to
+// accelerator, or SIZE_MAX to route everything to host
+replay_result_t
+run_replay(sycl::queue& q,
+           const std::vector<replay_request_t>& reqs,
+           size_t host_max,
+           size_t workers = 8)
+{
+  replay_result_t res{};
+
+  size_t max_size = 0;
+  for (const auto& r : reqs) {
+    max_size = std::max(max_size, r.size);
+  }
+
+  // every request hashes prefix of same buffer
+  std::vector<sycl::uchar> data(max_size);
+  for (size_t i = 0; i < max_size; i++) {
+    data[i] = static_cast<sycl::uchar>(i % 251);
+  }
+
+  // scheduled arrivals, relative to start of replay
+  std::vector<uint64_t> arrivals(reqs.size());
+  uint64_t arrival = 0;
+  for (size_t i = 0; i < reqs.size(); i++) {
+    arrival += reqs[i].gap_ns;
+    arrivals[i] = arrival;
+  }
+
+  std::vector<double> latencies(reqs.size());
+  std::vector<replay_result_t> partial(workers);
+  std::vector<std::thread> pool;
+  std::atomic<size_t> next{ 0 };
+
+  const uint64_t start = host_now_ns();
+
+  for (size_t w = 0; w < workers; w++) {
+    pool.emplace_back([&, w]() {
+      blake3::multipart_assembler a{ q };
+      sycl::uchar digest[blake3::OUT_LEN];
+
+      for (size_t i = next++; i < reqs.size(); i = next++) {
+        const replay_request_t& r = reqs[i];
+        const uint64_t at = start + arrivals[i];
+
+        for (uint64_t now = host_now_ns(); now < at; now = host_now_ns()) {
+          std::this_thread::sleep_for(std::chrono::nanoseconds(at - now));
+        }
+
+        const replay_backend b =
+          r.size <= host_max ? replay_backend::host : replay_backend::device;
+
+        if (b == replay_backend::host) {
+          blake3::host_hash_copy(data.data(), nullptr, r.size, digest);
+        } else {
+          a.reset();
+          a.add_part(0, data.data(), r.size);
+          a.finalize(r.size, digest);
+        }
+
+        latencies[i] = (double)(host_now_ns() - at);
+
+        partial[w].routed[static_cast<size_t>(b)]++;
+        partial[w].routed_bytes[static_cast<size_t>(b)] += r.size;
+      }
+    });
+  }
+
+  for (auto& t : pool) {
+    t.join();
+  }
+
+  for (const auto& p : partial) {
+    for (size_t b = 0; b < 2; b++) {
+      res.routed[b] += p.routed[b];
+      res.routed_bytes[b] += p.routed_bytes[b];
+    }
+  }
+
+  res.requests = reqs.size();
+  res.bytes = res.routed_bytes[0] + res.routed_bytes[1];
+  res.elapsed_ns = (double)(host_now_ns() - start);
+  res.p50_ns = percentile(latencies, 0.5);
+  res.p90_ns = percentile(latencies, 0.9);
+  res.p99_ns = percentile(latencies, 0.99);
+  res.p999_ns = percentile(latencies, 0.999);
+
+  return res;
+}
+
 // Convert nanosecond granularity execution time to readable string i.e. in
 // terms of seconds/ milliseconds/ microseconds/ nanoseconds
 std::string
@@ -78,3 +756,14 @@ to_readable_timespan(double ts)
                                : ts >= 1e3 ? std::to_string(ts * 1e-3) + " us"
                                            : std::to_string(ts) + " ns";
 }
+
+// Convert input size ( in bytes ) and nanosecond granularity execution time to
+// readable effective bandwidth string i.e. in terms of GB/s or MB/s
+std::string
+to_readable_bandwidth(size_t bytes, double ts)
+{
+  const double bps = (double)bytes / (ts * 1e-9);
+
+  return bps >= 1e9 ? std::to_string(bps * 1e-9) + " GB/s"
+                    : std::to_string(bps * 1e-6) + " MB/s";
+}
@@ -0,0 +1,106 @@
+#include "ip.hpp"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+#include <vector>
+
+#if !(defined FPGA_EMU || defined FPGA_HW)
+#define FPGA_EMU
+#endif
+
+// Streaming interfaces of BLAKE3 IP component, which are exported as
+// Avalon-ST ports, when this file is compiled through IP authoring flow
+class pipeBlake3IPIn;
+class pipeBlake3IPOut;
+
+using ip_in_pipe =
+  sycl::ext::intel::pipe<pipeBlake3IPIn, blake3::ip_block_t, 16>;
+using ip_out_pipe =
+  sycl::ext::intel::pipe<pipeBlake3IPOut, blake3::ip_digest_t, 4>;
+
+// Streaming testbench of BLAKE3 IP component, which streams given files
+// through it ( one file is one message ), printing digest of each, in same
+// format as `b3sum`
+//
+// Usage: ./fpga_emu.out <file> [file ...]
+int
+main(int argc, char** argv)
+{
+
+#if defined FPGA_EMU
+  sycl::ext::intel::fpga_emulator_selector s{};
+#elif defined FPGA_HW
+  sycl::ext::intel::fpga_selector s{};
+#endif
+
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <file> [file ...]" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  sycl::device d{ s };
+  sycl::context c{ d };
+  // not in-order, because source, IP and sink kernels must run concurrently
+  sycl::queue q{ c, d };
+
+  const size_t msg_cnt = static_cast<size_t>(argc - 1);
+
+  std::vector<sycl::uchar> input;
+  std::vector<size_t> lens;
+
+  for (size_t m = 0; m < msg_cnt; m++) {
+    std::ifstream f{ argv[m + 1], std::ios::binary };
+    if (!f) {
+      std::cerr << "failed to open " << argv[m + 1] << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    const size_t before = input.size();
+    input.insert(input.end(),
+                 std::istreambuf_iterator<char>(f),
+                 std::istreambuf_iterator<char>());
+    lens.push_back(input.size() - before);
+  }
+
+  // at least one byte, so that allocation is valid, when all files are empty
+  const size_t i_size = std::max<size_t>(input.size(), 1);
+
+  sycl::uchar* i_d = static_cast<sycl::uchar*>(sycl::malloc_device(i_size, q));
+  size_t* l_d =
+    static_cast<size_t*>(sycl::malloc_device(msg_cnt * sizeof(size_t), q));
+  sycl::uchar* o_d = static_cast<sycl::uchar*>(
+    sycl::malloc_device(msg_cnt * blake3::OUT_LEN, q));
+
+  std::vector<sycl::uchar> digests(msg_cnt * blake3::OUT_LEN);
+
+  if (!input.empty()) {
+    q.memcpy(i_d, input.data(), input.size()).wait();
+  }
+  q.memcpy(l_d, lens.data(), msg_cnt * sizeof(size_t)).wait();
+
+  sycl::event evt_0 = blake3::feed_ip<ip_in_pipe>(q, i_d, l_d, msg_cnt);
+  sycl::event evt_1 = blake3::launch_ip<ip_in_pipe, ip_out_pipe>(q, msg_cnt);
+  sycl::event evt_2 = blake3::drain_ip<ip_out_pipe>(q, o_d, msg_cnt);
+
+  evt_2.wait();
+  evt_1.wait();
+  evt_0.wait();
+
+  q.memcpy(digests.data(), o_d, msg_cnt * blake3::OUT_LEN).wait();
+
+  for (size_t m = 0; m < msg_cnt; m++) {
+    for (size_t i = 0; i < blake3::OUT_LEN; i++) {
+      std::cout << std::hex << std::setw(2) << std::setfill('0')
+                << static_cast<uint32_t>(digests[m * blake3::OUT_LEN + i]);
+    }
+    std::cout << "  " << argv[m + 1] << std::endl;
+  }
+
+  sycl::free(i_d, q);
+  sycl::free(l_d, q);
+  sycl::free(o_d, q);
+
+  return EXIT_SUCCESS;
+}
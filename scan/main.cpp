@@ -0,0 +1,191 @@
+#include "cache.hpp"
+#include "multipart.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#if !(defined FPGA_EMU || defined FPGA_HW)
+#define FPGA_EMU
+#endif
+
+// Computes BLAKE3 digest of regular file of any size, by mapping it into
+// memory and adding it as single part to multipart assembler ( see
+// include/multipart.hpp ), so that its full chunks are hashed on accelerator
+//
+// Returns false with `errno` set by failing call
+static bool
+hash_file(blake3::multipart_assembler& a,
+          const int fd,
+          const size_t f_size,
+          uint8_t* const digest)
+{
+  a.reset();
+
+  if (f_size > 0) {
+    void* mapped = mmap(nullptr, f_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+      return false;
+    }
+    madvise(mapped, f_size, MADV_SEQUENTIAL);
+
+    a.add_part(0, static_cast<const sycl::uchar*>(mapped), f_size);
+    munmap(mapped, f_size);
+  }
+
+  return a.finalize(f_size, digest);
+}
+
+// Lowercase hex string of 32 -bytes digest
+static std::string
+to_hex(const uint8_t* const digest)
+{
+  std::ostringstream ss;
+  for (size_t i = 0; i < blake3::OUT_LEN; i++) {
+    ss << std::hex << std::setw(2) << std::setfill('0')
+       << static_cast<uint32_t>(digest[i]);
+  }
+  return ss.str();
+}
+
+// Directory scanner, which prints BLAKE3 digest of each regular file under
+// given directory ( in `b3sum` format ), reusing digests of unchanged files
+// from persistent cache ( see include/cache.hpp ), so that repeated scans of
+// same dataset cost a `stat` per unchanged file
+//
+// Usage: ./fpga_emu.out [--cache <path>] [--snapshot <path>] <directory>
+//
+// - cache defaults to `$XDG_CACHE_HOME/blake3-fpga.cache` ( falling back to
+// `~/.cache/blake3-fpga.cache` )
+// - snapshot, when given, receives same listing ( paths relative to scanned
+// directory, sorted ), so that snapshots of a tree can be diffed or checked
+int
+main(int argc, char** argv)
+{
+  std::string cache_path;
+  std::string snapshot_path;
+  std::string root;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+
+    if (arg == "--cache" && i + 1 < argc) {
+      cache_path = argv[++i];
+    } else if (arg == "--snapshot" && i + 1 < argc) {
+      snapshot_path = argv[++i];
+    } else {
+      root = arg;
+    }
+  }
+
+  if (root.empty()) {
+    std::cerr << "usage: " << argv[0]
+              << " [--cache <path>] [--snapshot <path>] <directory>"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (cache_path.empty()) {
+    const char* dir = std::getenv("XDG_CACHE_HOME");
+    const char* home = std::getenv("HOME");
+
+    cache_path = dir != nullptr && dir[0] != '\0'
+                   ? std::string(dir)
+                   : std::string(home != nullptr ? home : ".") + "/.cache";
+    std::filesystem::create_directories(cache_path);
+    cache_path += "/blake3-fpga.cache";
+  }
+
+#if defined FPGA_EMU
+  sycl::ext::intel::fpga_emulator_selector s{};
+#elif defined FPGA_HW
+  sycl::ext::intel::fpga_selector s{};
+#endif
+
+  sycl::device d{ s };
+  sycl::context c{ d };
+  sycl::queue q{ c, d };
+
+  blake3::digest_cache cache;
+  if (!cache.open(cache_path.c_str())) {
+    std::cerr << "failed to open cache " << cache_path << " : "
+              << std::strerror(errno) << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // reused across files, so that its pinned buffers are allocated once
+  blake3::multipart_assembler a{ q };
+
+  std::vector<std::pair<std::string, std::string>> listing;
+  size_t hits = 0;
+  size_t misses = 0;
+
+  for (const auto& e : std::filesystem::recursive_directory_iterator(root)) {
+    if (!e.is_regular_file()) {
+      continue;
+    }
+
+    const std::string path = e.path().string();
+
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      std::cerr << "failed to open " << path << " : " << std::strerror(errno)
+                << std::endl;
+      if (fd >= 0) {
+        close(fd);
+      }
+      continue;
+    }
+
+    uint8_t digest[blake3::OUT_LEN];
+
+    if (cache.lookup(st, digest)) {
+      hits++;
+    } else {
+      const int64_t started =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+
+      if (!hash_file(a, fd, static_cast<size_t>(st.st_size), digest)) {
+        std::cerr << "failed to hash " << path << " : "
+                  << std::strerror(errno) << std::endl;
+        close(fd);
+        continue;
+      }
+
+      // racily modified files aren't cached, that's fine
+      cache.store(st, digest, started);
+      misses++;
+    }
+
+    close(fd);
+
+    std::cout << to_hex(digest) << "  " << path << std::endl;
+    listing.emplace_back(
+      std::filesystem::relative(e.path(), root).string(), to_hex(digest));
+  }
+
+  std::cerr << hits << " cached, " << misses << " hashed" << std::endl;
+
+  if (!snapshot_path.empty()) {
+    std::sort(listing.begin(), listing.end());
+
+    std::ofstream f{ snapshot_path };
+    for (const auto& [path, hex] : listing) {
+      f << hex << "  " << path << '\n';
+    }
+
+    if (!f) {
+      std::cerr << "failed to write snapshot " << snapshot_path << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+#include "signature.hpp"
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#if !(defined FPGA_EMU || defined FPGA_HW)
+#define FPGA_EMU
+#endif
+
+// Signature generator, which writes rsync style signature file ( weak rolling
+// checksum and strong BLAKE3 checksum of every fixed size block, see
+// include/signature.hpp ) of given file, for delta sync
+//
+// Usage: ./fpga_emu.out [--block <bytes>] [--strong <bytes>] <file> <signature>
+//
+// - block size defaults to 64KB, must be power of 2, at least 2KB
+// - strong checksum length defaults to 16 -bytes, at most 32 -bytes
+int
+main(int argc, char** argv)
+{
+  size_t block_len = blake3::SIG_BLOCK_LEN;
+  size_t strong_len = blake3::SIG_STRONG_LEN;
+  std::vector<std::string> paths;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+
+    if (arg == "--block" && i + 1 < argc) {
+      block_len = std::stoul(argv[++i]);
+    } else if (arg == "--strong" && i + 1 < argc) {
+      strong_len = std::stoul(argv[++i]);
+    } else {
+      paths.push_back(arg);
+    }
+  }
+
+  if (paths.size() != 2 || !blake3::is_valid_sig_block_len(block_len) ||
+      strong_len == 0 || strong_len > blake3::OUT_LEN) {
+    std::cerr << "usage: " << argv[0]
+              << " [--block <bytes>] [--strong <bytes>] <file> <signature>"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const int fd = open(paths[0].c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    std::cerr << "failed to open " << paths[0] << " : " << std::strerror(errno)
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const size_t f_size = static_cast<size_t>(st.st_size);
+
+  void* mapped = nullptr;
+  if (f_size > 0) {
+    mapped = mmap(nullptr, f_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+      std::cerr << "failed to map " << paths[0] << " : "
+                << std::strerror(errno) << std::endl;
+      return EXIT_FAILURE;
+    }
+    madvise(mapped, f_size, MADV_SEQUENTIAL);
+  }
+
+  const int sig_fd =
+    open(paths[1].c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (sig_fd < 0) {
+    std::cerr << "failed to open " << paths[1] << " : " << std::strerror(errno)
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+#if defined FPGA_EMU
+  sycl::ext::intel::fpga_emulator_selector s{};
+#elif defined FPGA_HW
+  sycl::ext::intel::fpga_selector s{};
+#endif
+
+  sycl::device d{ s };
+  sycl::context c{ d };
+  sycl::queue q{ c, d };
+
+  bool ok = false;
+  {
+    blake3::signature_generator g{ q, block_len, strong_len };
+    ok = g.write(static_cast<const sycl::uchar*>(mapped), f_size, sig_fd);
+  }
+
+  if (!ok) {
+    std::cerr << "failed to write " << paths[1] << " : "
+              << std::strerror(errno) << std::endl;
+  }
+
+  if (mapped != nullptr) {
+    munmap(mapped, f_size);
+  }
+  close(fd);
+  close(sig_fd);
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,11 +1,1544 @@
-#include "blake3.hpp"
+#include "bao.hpp"
+#include "cache.hpp"
+#include "cdc.hpp"
+#include "daemon.hpp"
+#include "derive.hpp"
+#include "graph.hpp"
+#include "ip.hpp"
+#include "iterative.hpp"
+#include "mapped.hpp"
+#include "multipart.hpp"
+#include "pack.hpp"
+#include "pipelined.hpp"
+#include "pooled.hpp"
+#include "signature.hpp"
+#include "simd.hpp"
+#include "sparse.hpp"
+#include "staged.hpp"
+#include "stream.hpp"
+#include "trace.hpp"
+#include "utils.hpp"
+#include <array>
+#include <atomic>
 #include <iostream>
+#include <thread>
+#include <vector>
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
 #if !(defined FPGA_EMU || defined FPGA_HW)
 #define FPGA_EMU
 #endif
 
+// Computes all nodes of BLAKE3 binary merkle tree ( except root ) on host,
+// so that Bao slices can be prepared, then verifies them on accelerator, while
+// also checking that tampered slices are rejected
+//
+// Input is 1MB, where i-th byte is ( i % 251 ), so that each message block is
+// different; expected digest computed using python3 `blake3` package ( see
+// below in `main` )
+void
+test_bao_slices(sycl::queue& q)
+{
+  constexpr size_t chunk_count = 1 << 10;
+  constexpr size_t levels = 10;
+  constexpr size_t i_size = chunk_count * blake3::CHUNK_LEN;
+  constexpr size_t slice_cnt = 8;
+
+  // >>> list(blake3.blake3(bytes(i % 251 for i in range(1 << 20))).digest())
+  constexpr sycl::uchar expected[32] = {
+    116, 203, 68, 31,  208, 135, 118, 76,  169, 195, 105,
+    77,  167, 66, 235, 227, 12,  190, 179, 6,   10,  23,
+    0,   156, 168, 24,  37,  199, 168, 209, 3,   67
+  };
+  constexpr size_t chunk_idxs[slice_cnt] = { 0,   1,   2,   511,
+                                             512, 777, 1022, 1023 };
+
+  sycl::uchar* i_h = static_cast<sycl::uchar*>(malloc(i_size));
+  for (size_t i = 0; i < i_size; i++) {
+    i_h[i] = static_cast<sycl::uchar>(i % 251);
+  }
+
+  // level 0 holds chunk chaining values, level `levels - 1` holds two children
+  // of root
+  std::vector<std::vector<uint32_t>> tree(levels);
+
+  uint32_t msg[16];
+  uint32_t state[16];
+  sycl::private_ptr<uint32_t> msg_ptr{ msg };
+  sycl::private_ptr<uint32_t> state_ptr{ state };
+
+  for (size_t i = 0; i < chunk_count; i++) {
+    blake3::compress_chunk(state_ptr,
+                           msg_ptr,
+                           sycl::device_ptr<sycl::uchar>{ i_h + (i << 10) },
+                           i,
+                           0);
+    tree[0].insert(tree[0].end(), state, state + 8);
+  }
+
+  for (size_t l = 1; l < levels; l++) {
+    for (size_t i = 0; i < tree[l - 1].size(); i += 16) {
+      std::copy(tree[l - 1].begin() + i, tree[l - 1].begin() + i + 16, msg);
+      blake3::compress_parent(state_ptr, msg_ptr, 0);
+      tree[l].insert(tree[l].end(), state, state + 8);
+    }
+  }
+
+  // prepare slices, while sibling chaining values are placed from root to leaf
+  const size_t c_size = slice_cnt * blake3::CHUNK_LEN;
+  const size_t s_size = slice_cnt * levels * blake3::OUT_LEN;
+
+  sycl::uchar* c_h = static_cast<sycl::uchar*>(malloc(c_size));
+  sycl::uchar* s_h = static_cast<sycl::uchar*>(malloc(s_size));
+  sycl::uchar* ok_h = static_cast<sycl::uchar*>(malloc(slice_cnt));
+  sycl::uchar* r_h = static_cast<sycl::uchar*>(malloc(blake3::OUT_LEN));
+
+  for (size_t s = 0; s < slice_cnt; s++) {
+    const size_t idx = chunk_idxs[s];
+    std::memcpy(c_h + (s << 10), i_h + (idx << 10), blake3::CHUNK_LEN);
+
+    for (size_t l = 0; l < levels; l++) {
+      const size_t sib = (idx >> l) ^ 1ul;
+      const size_t depth = levels - 1 - l;
+      sycl::uchar* dst = s_h + (s * levels + depth) * blake3::OUT_LEN;
+
+      for (size_t i = 0; i < 8; i++) {
+        const uint32_t word = tree[l][(sib << 3) + i];
+        for (size_t j = 0; j < 4; j++) {
+          dst[(i << 2) + j] = static_cast<sycl::uchar>(word >> (j << 3));
+        }
+      }
+    }
+  }
+
+  sycl::uchar* r_d =
+    static_cast<sycl::uchar*>(sycl::malloc_device(blake3::OUT_LEN, q));
+  sycl::uchar* i_d = static_cast<sycl::uchar*>(sycl::malloc_device(i_size, q));
+  sycl::uchar* c_d = static_cast<sycl::uchar*>(sycl::malloc_device(c_size, q));
+  sycl::uchar* s_d = static_cast<sycl::uchar*>(sycl::malloc_device(s_size, q));
+  size_t* idx_d =
+    static_cast<size_t*>(sycl::malloc_device(sizeof(chunk_idxs), q));
+  sycl::uchar* ok_d =
+    static_cast<sycl::uchar*>(sycl::malloc_device(slice_cnt, q));
+
+  // digest computed on accelerator must match expected one, before slices
+  // are verified against it
+  q.memcpy(i_d, i_h, i_size).wait();
+  blake3::hash(q, i_d, i_size, chunk_count, r_d, nullptr);
+  q.memcpy(r_h, r_d, blake3::OUT_LEN).wait();
+
+  for (size_t i = 0; i < blake3::OUT_LEN; i++) {
+    assert(r_h[i] == expected[i]);
+  }
+
+  q.memcpy(c_d, c_h, c_size).wait();
+  q.memcpy(s_d, s_h, s_size).wait();
+  q.memcpy(idx_d, chunk_idxs, sizeof(chunk_idxs)).wait();
+
+  blake3::verify_slices(
+    q, r_d, c_d, s_d, idx_d, slice_cnt, chunk_count, ok_d, nullptr);
+  q.memcpy(ok_h, ok_d, slice_cnt).wait();
+
+  for (size_t s = 0; s < slice_cnt; s++) {
+    assert(ok_h[s] == 1);
+  }
+
+  // tamper with one chunk byte of slice 1 and one sibling byte of slice 5
+  c_h[(1 << 10) + 100] ^= 1;
+  s_h[(5 * levels + 3) * blake3::OUT_LEN] ^= 1;
+  q.memcpy(c_d, c_h, c_size).wait();
+  q.memcpy(s_d, s_h, s_size).wait();
+
+  blake3::verify_slices(
+    q, r_d, c_d, s_d, idx_d, slice_cnt, chunk_count, ok_d, nullptr);
+  q.memcpy(ok_h, ok_d, slice_cnt).wait();
+
+  for (size_t s = 0; s < slice_cnt; s++) {
+    assert(ok_h[s] == ((s == 1 || s == 5) ? 0 : 1));
+  }
+
+  sycl::free(r_d, q);
+  sycl::free(i_d, q);
+  sycl::free(c_d, q);
+  sycl::free(s_d, q);
+  sycl::free(idx_d, q);
+  sycl::free(ok_d, q);
+
+  std::free(i_h);
+  std::free(c_h);
+  std::free(s_h);
+  std::free(ok_h);
+  std::free(r_h);
+}
+
+// Whole input is just one chunk ( 1024 -bytes ), so slice carries no sibling
+// chaining values and chunk chaining value itself is root
+void
+test_bao_single_chunk(sycl::queue& q)
+{
+  // >>> list(blake3.blake3(bytes(i % 251 for i in range(1024))).digest())
+  constexpr sycl::uchar expected[32] = {
+    66,  33,  71,  57,  240, 149, 164, 6,   243, 252, 131,
+    222, 184, 137, 116, 74,  192, 13,  248, 49,  193, 13,
+    170, 85,  24,  155, 93,  18,  28,  133, 90,  247
+  };
+  constexpr size_t chunk_idx = 0;
+
+  sycl::uchar* c_h = static_cast<sycl::uchar*>(malloc(blake3::CHUNK_LEN));
+  for (size_t i = 0; i < blake3::CHUNK_LEN; i++) {
+    c_h[i] = static_cast<sycl::uchar>(i % 251);
+  }
+
+  sycl::uchar* r_d =
+    static_cast<sycl::uchar*>(sycl::malloc_device(blake3::OUT_LEN, q));
+  sycl::uchar* c_d =
+    static_cast<sycl::uchar*>(sycl::malloc_device(blake3::CHUNK_LEN, q));
+  // never read, because there's no sibling to carry
+  sycl::uchar* s_d =
+    static_cast<sycl::uchar*>(sycl::malloc_device(blake3::OUT_LEN, q));
+  size_t* idx_d = static_cast<size_t*>(sycl::malloc_device(sizeof(size_t), q));
+  sycl::uchar* ok_d = static_cast<sycl::uchar*>(sycl::malloc_device(1, q));
+
+  sycl::uchar ok_h = 0;
+
+  q.memcpy(r_d, expected, blake3::OUT_LEN).wait();
+  q.memcpy(c_d, c_h, blake3::CHUNK_LEN).wait();
+  q.memcpy(idx_d, &chunk_idx, sizeof(size_t)).wait();
+
+  blake3::verify_slices(q, r_d, c_d, s_d, idx_d, 1, 1, ok_d, nullptr);
+  q.memcpy(&ok_h, ok_d, 1).wait();
+  assert(ok_h == 1);
+
+  // tamper with last byte of chunk
+  c_h[blake3::CHUNK_LEN - 1] ^= 1;
+  q.memcpy(c_d, c_h, blake3::CHUNK_LEN).wait();
+
+  blake3::verify_slices(q, r_d, c_d, s_d, idx_d, 1, 1, ok_d, nullptr);
+  q.memcpy(&ok_h, ok_d, 1).wait();
+  assert(ok_h == 0);
+
+  sycl::free(r_d, q);
+  sycl::free(c_d, q);
+  sycl::free(s_d, q);
+  sycl::free(idx_d, q);
+  sycl::free(ok_d, q);
+
+  std::free(c_h);
+}
+
+// Hashes a sparse file ( 1MB, mostly holes ) by uploading only its data chunks
+// and checks that digest matches with one computed over fully read input
+void
+test_sparse_file(sycl::queue& q)
+{
+  constexpr size_t chunk_count = 1 << 10;
+  constexpr size_t i_size = chunk_count * blake3::CHUNK_LEN;
+
+  std::FILE* file = std::tmpfile();
+  assert(file != nullptr);
+  const int fd = fileno(file);
+
+  const int trunc = ftruncate(fd, i_size);
+  assert(trunc == 0);
+
+  // data extents, where last one ends at end of file
+  constexpr size_t extents[3][2] = {
+    { 0, 4096 }, { 300000, 10000 }, { i_size - 1000, 1000 }
+  };
+
+  sycl::uchar* buf = static_cast<sycl::uchar*>(malloc(i_size));
+  for (size_t e = 0; e < 3; e++) {
+    for (size_t i = 0; i < extents[e][1]; i++) {
+      buf[i] = static_cast<sycl::uchar>((e * 7 + i) % 251);
+    }
+    const ssize_t n = pwrite(fd, buf, extents[e][1], extents[e][0]);
+    assert(n == static_cast<ssize_t>(extents[e][1]));
+  }
+
+  sycl::uchar sparse_digest[32];
+  size_t data_chunks = 0;
+  const bool hashed =
+    blake3::hash_file_sparse(q, fd, sparse_digest, &data_chunks, nullptr);
+  assert(hashed);
+  // holes must be reported, otherwise `CHUNK_HOLE` path is never exercised
+  assert(data_chunks > 0 && data_chunks < chunk_count);
+
+  // digest of fully read input, holes being read as zero bytes
+  const bool read = blake3::pread_full(fd, buf, i_size, 0);
+  assert(read);
+
+  sycl::uchar* i_d = static_cast<sycl::uchar*>(sycl::malloc_device(i_size, q));
+  sycl::uchar* o_d =
+    static_cast<sycl::uchar*>(sycl::malloc_device(blake3::OUT_LEN, q));
+  sycl::uchar dense_digest[32];
+
+  q.memcpy(i_d, buf, i_size).wait();
+  blake3::hash(q, i_d, i_size, chunk_count, o_d, nullptr);
+  q.memcpy(dense_digest, o_d, blake3::OUT_LEN).wait();
+
+  for (size_t i = 0; i < blake3::OUT_LEN; i++) {
+    assert(sparse_digest[i] == dense_digest[i]);
+  }
+
+  sycl::free(i_d, q);
+  sycl::free(o_d, q);
+  std::free(buf);
+  std::fclose(file);
+}
+
+// Hashes a file which is just one hole ( 1MB ), so that no chunk is uploaded
+// and all message blocks are synthesized on-chip, then checks that file size
+// not satisfying constraints of `hash` is rejected
+void
+test_sparse_hole_file(sycl::queue& q)
+{
+  constexpr size_t i_size = 1 << 20;
+
+  // >>> list(blake3.blake3(bytes(1 << 20)).digest())
+  constexpr sycl::uchar expected[32] = {
+    72,  141, 226, 2,   247, 59,  217, 118, 222, 78,  112,
+    72,  244, 225, 243, 154, 119, 109, 134, 213, 130, 183,
+    52,  143, 245, 59,  244, 50,  185, 135, 252, 168
+  };
+
+  std::FILE* file = std::tmpfile();
+  assert(file != nullptr);
+  const int fd = fileno(file);
+
+  int trunc = ftruncate(fd, i_size);
+  assert(trunc == 0);
+
+  sycl::uchar digest[32];
+  size_t data_chunks = 1;
+  bool hashed = blake3::hash_file_sparse(q, fd, digest, &data_chunks, nullptr);
+  assert(hashed);
+  assert(data_chunks == 0);
+
+  for (size_t i = 0; i < blake3::OUT_LEN; i++) {
+    assert(digest[i] == expected[i]);
+  }
+
+  // not a multiple of 1024 -bytes, must not be silently truncated
+  trunc = ftruncate(fd, i_size + 1);
+  assert(trunc == 0);
+
+  hashed = blake3::hash_file_sparse(q, fd, digest, nullptr, nullptr);
+  assert(!hashed && errno == EINVAL);
+
+  std::fclose(file);
+}
+
+// Runs local hashing daemon ( server side ) on a background thread, then
+// checks that
+//
+// - it never removes a non-socket file, when asked to listen on that path
+// - it serves more than one client connection
+// - pipelined requests are answered in order, with errors reported per request
+// - payload carried by unsealed memfd is rejected
+void
+test_daemon(sycl::queue& q)
+{
+  constexpr size_t i_size = 1 << 20;
+
+  // >>> list(blake3.blake3(bytes(i % 251 for i in range(1 << 20))).digest())
+  constexpr sycl::uchar expected[32] = {
+    116, 203, 68, 31,  208, 135, 118, 76,  169, 195, 105,
+    77,  167, 66, 235, 227, 12,  190, 179, 6,   10,  23,
+    0,   156, 168, 24,  37,  199, 168, 209, 3,   67
+  };
+
+  char dir[] = "/tmp/blake3-daemon-XXXXXX";
+  const bool made = mkdtemp(dir) != nullptr;
+  assert(made);
+
+  const std::string sock_path = std::string(dir) + "/blake3.sock";
+  const std::string file_path = std::string(dir) + "/file";
+
+  // daemon requires in-order queue
+  sycl::queue dq{ q.get_context(),
+                  q.get_device(),
+                  sycl::property::queue::in_order() };
+  blake3::daemon_server server{ dq };
+
+  const int file = open(file_path.c_str(), O_CREAT | O_WRONLY, 0600);
+  assert(file >= 0);
+  close(file);
+
+  int err = server.listen_on(file_path.c_str());
+  struct stat st;
+  assert(err == EEXIST && lstat(file_path.c_str(), &st) == 0);
+
+  err = server.listen_on(sock_path.c_str());
+  assert(err == 0);
+
+  std::atomic<bool> stop{ false };
+  std::thread serving([&]() {
+    while (!stop && server.poll_once(10))
+      ;
+  });
+
+  sycl::uchar* buf = static_cast<sycl::uchar*>(malloc(i_size));
+  for (size_t i = 0; i < i_size; i++) {
+    buf[i] = static_cast<sycl::uchar>(i % 251);
+  }
+
+  sycl::uchar digest[32];
+
+  // more than one client connection, each sending more than one request
+  for (size_t c = 0; c < 2; c++) {
+    const int sock = blake3::daemon_connect(sock_path.c_str());
+    assert(sock >= 0);
+
+    for (size_t r = 0; r < 2; r++) {
+      std::memset(digest, 0, sizeof(digest));
+      err = blake3::daemon_hash(sock, buf, i_size, digest);
+      assert(err == 0);
+
+      for (size_t i = 0; i < blake3::OUT_LEN; i++) {
+        assert(digest[i] == expected[i]);
+      }
+    }
+
+    close(sock);
+  }
+
+  // pipelined requests, where second one has invalid payload size
+  const int memfd =
+    memfd_create("blake3-test", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  assert(memfd >= 0);
+  const ssize_t n = write(memfd, buf, i_size);
+  assert(n == static_cast<ssize_t>(i_size));
+
+  const int sock = blake3::daemon_connect(sock_path.c_str());
+  assert(sock >= 0);
+
+  // not yet sealed, so must be rejected
+  err = blake3::daemon_hash_memfd(sock, memfd, i_size, digest);
+  assert(err == EPERM);
+
+  err = fcntl(memfd, F_ADD_SEALS, blake3::DAEMON_REQUIRED_SEALS);
+  assert(err == 0);
+
+  constexpr size_t sizes[3] = { i_size, 1000, i_size };
+  for (size_t r = 0; r < 3; r++) {
+    const blake3::daemon_request req{ sizes[r] };
+    const bool sent = blake3::send_with_fd(sock, &req, sizeof(req), memfd);
+    assert(sent);
+  }
+
+  for (size_t r = 0; r < 3; r++) {
+    blake3::daemon_response resp;
+    const ssize_t m = recv(sock, &resp, sizeof(resp), 0);
+    assert(m == sizeof(resp));
+
+    if (r == 1) {
+      assert(resp.status == EINVAL);
+      continue;
+    }
+
+    assert(resp.status == 0);
+    for (size_t i = 0; i < blake3::OUT_LEN; i++) {
+      assert(resp.digest[i] == expected[i]);
+    }
+  }
+
+  close(sock);
+  close(memfd);
+
+  stop = true;
+  serving.join();
+
+  std::free(buf);
+  unlink(file_path.c_str());
+  unlink(sock_path.c_str());
+  rmdir(dir);
+}
+
+// Hashes 1MB input ( where i-th byte is ( i % 251 ), so that each message
+// block is different ) using given BLAKE3 kernel ( say `hash_staged`,
+// `hash_pooled` or `hash_iterative`, for some compile time parameter ), while
+// comparing against digest computed using python3 `blake3` package
+void
+test_hasher(sycl::queue& q, hasher_t hasher)
+{
+  constexpr size_t chunk_count = 1 << 10;
+  constexpr size_t i_size = chunk_count * blake3::CHUNK_LEN;
+
+  // >>> list(blake3.blake3(bytes(i % 251 for i in range(1 << 20))).digest())
+  constexpr sycl::uchar expected[32] = {
+    116, 203, 68, 31,  208, 135, 118, 76,  169, 195, 105,
+    77,  167, 66, 235, 227, 12,  190, 179, 6,   10,  23,
+    0,   156, 168, 24,  37,  199, 168, 209, 3,   67
+  };
+
+  sycl::uchar* i_h = static_cast<sycl::uchar*>(malloc(i_size));
+  sycl::uchar* i_d = static_cast<sycl::uchar*>(sycl::malloc_device(i_size, q));
+  sycl::uchar* o_h = static_cast<sycl::uchar*>(malloc(blake3::OUT_LEN));
+  sycl::uchar* o_d =
+    static_cast<sycl::uchar*>(sycl::malloc_device(blake3::OUT_LEN, q));
+
+  for (size_t i = 0; i < i_size; i++) {
+    i_h[i] = static_cast<sycl::uchar>(i % 251);
+  }
+
+  q.memcpy(i_d, i_h, i_size).wait();
+  hasher(q, i_d, i_size, chunk_count, o_d, nullptr);
+  q.memcpy(o_h, o_d, blake3::OUT_LEN).wait();
+
+  for (size_t i = 0; i < blake3::OUT_LEN; i++) {
+    assert(o_h[i] == expected[i]);
+  }
+
+  sycl::free(i_d, q);
+  sycl::free(o_d, q);
+
+  std::free(i_h);
+  std::free(o_h);
+}
+
+// Hashes three 1MB inputs in one go, using chunk and parent kernels connected
+// by pipe, where inputs are all 0xff, ( i % 251 ) and all zero bytes
+// respectively; digests computed using python3 `blake3` package
+void
+test_hash_many(sycl::queue& q)
+{
+  constexpr size_t chunk_count = 1 << 10;
+  constexpr size_t job_cnt = 3;
+  constexpr size_t j_size = chunk_count * blake3::CHUNK_LEN;
+  constexpr size_t i_size = job_cnt * j_size;
+  constexpr size_t o_size = job_cnt * blake3::OUT_LEN;
+
+  constexpr sycl::uchar expected[o_size] = {
+    // >>> list(blake3.blake3(bytes([0xff] * (1 << 20))).digest())
+    3,   107, 169, 54,  188, 220, 105, 198, 56,  19,  158, 182, 125, 203, 4,
+    77,  220, 197, 132, 215, 44,  187, 125, 130, 161, 92,  234, 112, 223, 45,
+    212, 205,
+    // >>> list(blake3.blake3(bytes(i % 251 for i in range(1 << 20))).digest())
+    116, 203, 68,  31,  208, 135, 118, 76,  169, 195, 105, 77,  167, 66,  235,
+    227, 12,  190, 179, 6,   10,  23,  0,   156, 168, 24,  37,  199, 168, 209,
+    3,   67,
+    // >>> list(blake3.blake3(bytes(1 << 20)).digest())
+    72,  141, 226, 2,   247, 59,  217, 118, 222, 78,  112, 72,  244, 225, 243,
+    154, 119, 109, 134, 213, 130, 183, 52,  143, 245, 59,  244, 50,  185, 135,
+    252, 168
+  };
+
+  sycl::uchar* i_h = static_cast<sycl::uchar*>(malloc(i_size));
+  sycl::uchar* i_d = static_cast<sycl::uchar*>(sycl::malloc_device(i_size, q));
+  sycl::uchar* o_h = static_cast<sycl::uchar*>(malloc(o_size));
+  sycl::uchar* o_d = static_cast<sycl::uchar*>(sycl::malloc_device(o_size, q));
+
+  memset(i_h, 0xff, j_size);
+  for (size_t i = 0; i < j_size; i++) {
+    i_h[j_size + i] = static_cast<sycl::uchar>(i % 251);
+  }
+  memset(i_h + (j_size << 1), 0, j_size);
+
+  q.memcpy(i_d, i_h, i_size).wait();
+  blake3::hash_many(q, i_d, chunk_count, job_cnt, o_d, nullptr);
+  q.memcpy(o_h, o_d, o_size).wait();
+
+  for (size_t i = 0; i < o_size; i++) {
+    assert(o_h[i] == expected[i]);
+  }
+
+  sycl::free(i_d, q);
+  sycl::free(o_d, q);
+
+  std::free(i_h);
+  std::free(o_h);
+}
+
+// Hashes 1MB file ( where i-th byte is ( i % 251 ) ), which is mapped into
+// memory and uploaded straight from page cache, while also checking that file
+// size not satisfying `hash` constraints is rejected
+void
+test_mapped_file(sycl::queue& q)
+{
+  constexpr size_t i_size = 1 << 20;
+
+  // >>> list(blake3.blake3(bytes(i % 251 for i in range(1 << 20))).digest())
+  constexpr sycl::uchar expected[32] = {
+    116, 203, 68, 31,  208, 135, 118, 76,  169, 195, 105,
+    77,  167, 66, 235, 227, 12,  190, 179, 6,   10,  23,
+    0,   156, 168, 24,  37,  199, 168, 209, 3,   67
+  };
+
+  std::FILE* file = std::tmpfile();
+  assert(file != nullptr);
+  const int fd = fileno(file);
+
+  sycl::uchar* buf = static_cast<sycl::uchar*>(malloc(i_size));
+  for (size_t i = 0; i < i_size; i++) {
+    buf[i] = static_cast<sycl::uchar>(i % 251);
+  }
+
+  const ssize_t n = pwrite(fd, buf, i_size, 0);
+  assert(n == static_cast<ssize_t>(i_size));
+
+  sycl::uchar digest[32];
+  bool hashed = blake3::hash_file_mapped(q, fd, digest, nullptr);
+  assert(hashed);
+
+  for (size_t i = 0; i < blake3::OUT_LEN; i++) {
+    assert(digest[i] == expected[i]);
+  }
+
+  const int trunc = ftruncate(fd, i_size >> 1);
+  assert(trunc == 0);
+
+  hashed = blake3::hash_file_mapped(q, fd, digest, nullptr);
+  assert(!hashed && errno == EINVAL);
+
+  std::free(buf);
+  std::fclose(file);
+}
+
+// Hashes seven streams ( of lengths 0, 1024, 1025, 2048, 3089, 65541 and 1MB,
+// where i-th byte is ( i % 251 ) ) concurrently, feeding them in interleaved
+// pieces of varying length, while engine ticks in between, with small batch
+// size, so that a stream's chunks are spread over many ticks; digests computed
+// using python3 `blake3` package
+void
+test_stream_engine(sycl::queue& q)
+{
+  constexpr size_t stream_cnt = 7;
+  constexpr size_t sizes[stream_cnt] = { 0,    1024,  1025,   2048,
+                                         3089, 65541, 1 << 20 };
+  constexpr size_t pieces[4] = { 7, 300, 1024, 4099 };
+
+  // >>> list(blake3.blake3(bytes(i % 251 for i in range(n))).digest())
+  constexpr sycl::uchar expected[stream_cnt][32] = {
+    { 175, 19, 73, 185, 245, 249, 161, 166, 160, 64, 77,
+      234, 54, 220, 201, 73, 155, 203, 37, 201, 173, 193,
+      18, 183, 204, 154, 147, 202, 228, 31, 50, 98 },
+    { 66, 33, 71, 57, 240, 149, 164, 6, 243, 252, 131,
+      222, 184, 137, 116, 74, 192, 13, 248, 49, 193, 13,
+      170, 85, 24, 155, 93, 18, 28, 133, 90, 247 },
+    { 208, 2, 120, 174, 71, 235, 39, 179, 79, 174, 207,
+      103, 180, 254, 38, 63, 130, 213, 65, 41, 22, 193,
+      255, 217, 124, 140, 183, 251, 129, 75, 132, 68 },
+    { 231, 118, 182, 2, 140, 124, 210, 42, 77, 11, 161,
+      130, 168, 191, 98, 32, 93, 46, 245, 118, 70, 126,
+      131, 142, 214, 242, 82, 155, 133, 251, 162, 74 },
+    { 42, 11, 38, 222, 106, 2, 79, 3, 91, 37, 232,
+      138, 98, 102, 216, 8, 23, 191, 67, 207, 69, 247,
+      238, 142, 86, 68, 51, 69, 146, 29, 168, 158 },
+    { 55, 219, 248, 248, 64, 59, 126, 44, 143, 73, 144,
+      27, 84, 60, 253, 109, 21, 63, 109, 120, 64, 5,
+      51, 209, 111, 95, 220, 250, 5, 65, 216, 174 },
+    { 116, 203, 68, 31, 208, 135, 118, 76, 169, 195, 105,
+      77, 167, 66, 235, 227, 12, 190, 179, 6, 10, 23,
+      0, 156, 168, 24, 37, 199, 168, 209, 3, 67 }
+  };
+
+  const size_t i_size = sizes[stream_cnt - 1];
+  sycl::uchar* buf = static_cast<sycl::uchar*>(malloc(i_size));
+  for (size_t i = 0; i < i_size; i++) {
+    buf[i] = static_cast<sycl::uchar>(i % 251);
+  }
+
+  blake3::stream_engine engine{ q, 8 };
+
+  size_t ids[stream_cnt];
+  size_t fed[stream_cnt] = {};
+  for (size_t s = 0; s < stream_cnt; s++) {
+    ids[s] = engine.open();
+  }
+
+  bool pending = true;
+  for (size_t r = 0; pending; r++) {
+    pending = false;
+
+    for (size_t s = 0; s < stream_cnt; s++) {
+      const size_t len = std::min(pieces[(r + s) % 4], sizes[s] - fed[s]);
+      engine.update(ids[s], buf + fed[s], len);
+
+      fed[s] += len;
+      pending |= fed[s] < sizes[s];
+    }
+
+    engine.tick();
+  }
+
+  for (size_t s = 0; s < stream_cnt; s++) {
+    sycl::uchar digest[32];
+    engine.finalize(ids[s], digest);
+
+    for (size_t i = 0; i < blake3::OUT_LEN; i++) {
+      assert(digest[i] == expected[s][i]);
+    }
+  }
+
+  // identifiers of finalized streams are reused
+  const size_t id = engine.open();
+  assert(id < stream_cnt);
+
+  sycl::uchar digest[32];
+  engine.finalize(id, digest);
+  for (size_t i = 0; i < blake3::OUT_LEN; i++) {
+    assert(digest[i] == expected[0][i]);
+  }
+
+  std::free(buf);
+}
+
+// Checks address trace of current and chunk-major global memory schedules, for
+// 1MB input, by counting traffic of each region, while expecting DDR model to
+// rank chunk-major schedule ( which keeps chaining values on-chip ) higher
+void
+test_trace()
+{
+  using namespace blake3::trace;
+
+  constexpr size_t chunk_count = 1 << 10;
+  constexpr size_t i_size = chunk_count * CHUNK_LEN;
+
+  const std::vector<access_t> t_0 =
+    generate(schedule::interleaved, chunk_count);
+  const std::vector<access_t> t_1 =
+    generate(schedule::chunk_major, chunk_count);
+
+  // ( input bytes read, chaining value bytes read, chaining value bytes
+  // written )
+  auto traffic = [](const std::vector<access_t>& t) {
+    size_t counts[3] = {};
+    for (const access_t& a : t) {
+      counts[a.reg == region::input ? 0 : a.write ? 2 : 1] += a.size;
+    }
+    return std::array<size_t, 3>{ counts[0], counts[1], counts[2] };
+  };
+
+  // parent levels read two children and write one parent chaining value, for
+  // ( chunk_count - 2 ) -many parents, then root reads two children
+  constexpr size_t p_reads = (chunk_count - 2) * 64 + 64;
+  constexpr size_t p_writes = (chunk_count - 2) * 32;
+
+  const std::array<size_t, 3> tr_0 = traffic(t_0);
+  assert(tr_0[0] == i_size);
+  assert(tr_0[1] == 15 * chunk_count * OUT_LEN + p_reads);
+  assert(tr_0[2] == 16 * chunk_count * OUT_LEN + p_writes);
+
+  const std::array<size_t, 3> tr_1 = traffic(t_1);
+  assert(tr_1[0] == i_size);
+  assert(tr_1[1] == p_reads);
+  assert(tr_1[2] == chunk_count * OUT_LEN + p_writes);
+
+  const ddr_config_t cfg{};
+  const ddr_stats_t st_0 = simulate(t_0, i_size, cfg);
+  const ddr_stats_t st_1 = simulate(t_1, i_size, cfg);
+
+  assert(st_0.efficiency(cfg) > 0. && st_0.efficiency(cfg) <= 1.);
+  assert(st_1.efficiency(cfg) > st_0.efficiency(cfg));
+}
+
+// Writes ten objects ( of lengths 0, 1024, 1025, 2048 and 3089, twice, where
+// i-th byte is ( i % 251 ) ) into pack, using 16KB arenas, then checks pack
+// and index files, while also checking that object larger than arena is
+// rejected; digests computed using python3 `blake3` package
+//
+// It's done with all objects hashed on accelerator ( in two batches ), with
+// objects upto 1025 -bytes hashed on host, while being staged, and with all
+// of them hashed on host
+//
+// Finally checks that failing write of pack file fails every later call
+void
+test_pack_writer(sycl::queue& q)
+{
+  constexpr size_t obj_cnt = 5;
+  constexpr size_t sizes[obj_cnt] = { 0, 1024, 1025, 2048, 3089 };
+  constexpr size_t arena_size = 1 << 14;
+
+  // >>> list(blake3.blake3(bytes(i % 251 for i in range(n))).digest())
+  constexpr sycl::uchar expected[obj_cnt][32] = {
+    { 175, 19, 73, 185, 245, 249, 161, 166, 160, 64, 77,
+      234, 54, 220, 201, 73, 155, 203, 37, 201, 173, 193,
+      18, 183, 204, 154, 147, 202, 228, 31, 50, 98 },
+    { 66, 33, 71, 57, 240, 149, 164, 6, 243, 252, 131,
+      222, 184, 137, 116, 74, 192, 13, 248, 49, 193, 13,
+      170, 85, 24, 155, 93, 18, 28, 133, 90, 247 },
+    { 208, 2, 120, 174, 71, 235, 39, 179, 79, 174, 207,
+      103, 180, 254, 38, 63, 130, 213, 65, 41, 22, 193,
+      255, 217, 124, 140, 183, 251, 129, 75, 132, 68 },
+    { 231, 118, 182, 2, 140, 124, 210, 42, 77, 11, 161,
+      130, 168, 191, 98, 32, 93, 46, 245, 118, 70, 126,
+      131, 142, 214, 242, 82, 155, 133, 251, 162, 74 },
+    { 42, 11, 38, 222, 106, 2, 79, 3, 91, 37, 232,
+      138, 98, 102, 216, 8, 23, 191, 67, 207, 69, 247,
+      238, 142, 86, 68, 51, 69, 146, 29, 168, 158 }
+  };
+
+  sycl::uchar* buf = static_cast<sycl::uchar*>(malloc(arena_size + 1));
+  for (size_t i = 0; i <= arena_size; i++) {
+    buf[i] = static_cast<sycl::uchar>(i % 251);
+  }
+
+  for (const size_t host_hash_max : { size_t(0), size_t(1025), arena_size }) {
+    std::FILE* pack = std::tmpfile();
+    std::FILE* index = std::tmpfile();
+    assert(pack != nullptr && index != nullptr);
+
+    {
+      blake3::pack_writer writer{
+        q, fileno(pack), fileno(index), arena_size, host_hash_max
+      };
+
+      for (size_t r = 0; r < 2; r++) {
+        for (size_t i = 0; i < obj_cnt; i++) {
+          const bool added = writer.add(buf, sizes[i]);
+          assert(added);
+        }
+      }
+
+      const bool added = writer.add(buf, arena_size + 1);
+      assert(!added && errno == EFBIG);
+
+      const bool flushed = writer.flush();
+      assert(flushed);
+    }
+
+    blake3::pack_index_entry_t entries[obj_cnt << 1];
+    const ssize_t n = pread(fileno(index), entries, sizeof(entries), 0);
+    assert(n == static_cast<ssize_t>(sizeof(entries)));
+
+    uint64_t offset = 0;
+    for (size_t e = 0; e < (obj_cnt << 1); e++) {
+      const size_t i = e % obj_cnt;
+
+      assert(entries[e].offset == offset);
+      assert(entries[e].length == sizes[i]);
+      for (size_t j = 0; j < blake3::OUT_LEN; j++) {
+        assert(entries[e].digest[j] == expected[i][j]);
+      }
+
+      // object bytes are written to pack, as they are
+      std::vector<sycl::uchar> obj(sizes[i]);
+      const ssize_t m = pread(fileno(pack), obj.data(), sizes[i], offset);
+      assert(m == static_cast<ssize_t>(sizes[i]));
+      assert(std::equal(obj.begin(), obj.end(), buf));
+
+      offset += sizes[i];
+    }
+
+    std::fclose(pack);
+    std::fclose(index);
+  }
+
+  // failing write ( pack file not writable ) is sticky, while index file is
+  // left as it was before failing batch
+  {
+    const int pack_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    std::FILE* index = std::tmpfile();
+    assert(pack_fd >= 0 && index != nullptr);
+
+    {
+      blake3::pack_writer writer{ q, pack_fd, fileno(index), arena_size, 0 };
+
+      // second object doesn't fit, so first batch is sealed and written
+      bool added = writer.add(buf, arena_size);
+      assert(added);
+      added = writer.add(buf, sizes[1]);
+      assert(added);
+
+      const bool flushed = writer.flush();
+      assert(!flushed && errno == EBADF);
+
+      errno = 0;
+      added = writer.add(buf, sizes[1]);
+      assert(!added && errno == EBADF);
+    }
+
+    struct stat st;
+    const int ret = fstat(fileno(index), &st);
+    assert(ret == 0 && st.st_size == 0);
+
+    close(pack_fd);
+    std::fclose(index);
+  }
+
+  std::free(buf);
+}
+
+// Compares host compression function ( row vectorized, when host supports it )
+// against `compress( ... )`, for many pseudo random hash states and message
+// blocks, then checks digest of empty input ( computed on host ), against
+// python3 `blake3` package
+void
+test_host_compress()
+{
+  // empty input
+  constexpr sycl::uchar expected[32] = {
+    175, 19,  73,  185, 245, 249, 161, 166, 160, 64, 77,  234, 54, 220, 201, 73,
+    155, 203, 37,  201, 173, 193, 18,  183, 204, 154, 147, 202, 228, 31,  50, 98
+  };
+
+  uint32_t x = 0x9e3779b9u;
+
+  // xorshift32
+  auto next = [&]() {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+  };
+
+  for (size_t t = 0; t < 1 << 10; t++) {
+    uint32_t state[2][16];
+    uint32_t msg[2][16];
+
+    for (size_t i = 0; i < 16; i++) {
+      state[0][i] = state[1][i] = next();
+      msg[0][i] = msg[1][i] = next();
+    }
+
+    blake3::compress(sycl::private_ptr<uint32_t>{ state[0] },
+                     sycl::private_ptr<uint32_t>{ msg[0] });
+    blake3::host_compress(state[1], msg[1]);
+    assert(std::equal(state[0], state[0] + 8, state[1]));
+  }
+
+  blake3::cv_stack_t stack;
+  sycl::uchar digest[32];
+  blake3::cv_stack_root(stack, nullptr, 0, 0, digest);
+  assert(std::equal(digest, digest + 32, expected));
+}
+
+// Streaming testbench of BLAKE3 IP component, where source kernel splits ten
+// messages ( of lengths 0, 1, 64, 65, 1024, 1025, 2048, 3089, 65541 and
+// 1048583, where i-th byte of each is ( i % 251 ) ) into beats, IP component
+// hashes them and sink kernel collects digests, which are checked against
+// python3 `blake3` package
+//
+// Note, pipe names are declared at namespace scope, because they're part of
+// kernel names
+class pipeTestIPIn;
+class pipeTestIPOut;
+
+void
+test_ip_component(sycl::queue& q)
+{
+  using in_pipe = sycl::ext::intel::pipe<pipeTestIPIn, blake3::ip_block_t, 16>;
+  using out_pipe =
+    sycl::ext::intel::pipe<pipeTestIPOut, blake3::ip_digest_t, 4>;
+
+  constexpr size_t msg_cnt = 10;
+  constexpr size_t lens[msg_cnt] = { 0,    1,    64,   65,    1024,
+                                     1025, 2048, 3089, 65541, 1048583 };
+  constexpr sycl::uchar expected[msg_cnt][32] = {
+    { 175, 19,  73,  185, 245, 249, 161, 166, 160, 64,  77,
+      234, 54,  220, 201, 73,  155, 203, 37,  201, 173, 193,
+      18,  183, 204, 154, 147, 202, 228, 31,  50,  98 },
+    { 45,  58,  222, 223, 241, 27, 97,  241, 76,  136, 110,
+      53,  175, 160, 54,  115, 109, 205, 135, 167, 77,  39,
+      181, 193, 81,  2,   37,  208, 245, 146, 226, 19 },
+    { 78,  237, 113, 65,  234, 74,  92,  212, 183, 136, 96,
+      107, 210, 63,  70,  226, 18,  175, 156, 172, 235, 172,
+      220, 125, 31,  76,  109, 199, 242, 81,  27,  152 },
+    { 222, 30,  95,  160, 190, 112, 223, 109, 43,  232, 255,
+      253, 14,  153, 206, 170, 142, 182, 232, 201, 58,  99,
+      242, 216, 209, 195, 14,  203, 107, 38,  61,  238 },
+    { 66,  33,  71,  57,  240, 149, 164, 6,  243, 252, 131,
+      222, 184, 137, 116, 74,  192, 13,  248, 49, 193, 13,
+      170, 85,  24,  155, 93,  18,  28,  133, 90, 247 },
+    { 208, 2,   120, 174, 71,  235, 39,  179, 79,  174, 207,
+      103, 180, 254, 38,  63,  130, 213, 65,  41,  22,  193,
+      255, 217, 124, 140, 183, 251, 129, 75,  132, 68 },
+    { 231, 118, 182, 2,   140, 124, 210, 42,  77,  11,  161,
+      130, 168, 191, 98,  32,  93,  46,  245, 118, 70,  126,
+      131, 142, 214, 242, 82,  155, 133, 251, 162, 74 },
+    { 42, 11,  38,  222, 106, 2,   79,  3,   91,  37,  232,
+      138, 98,  102, 216, 8,   23,  191, 67,  207, 69,  247,
+      238, 142, 86,  68,  51,  69,  146, 29,  168, 158 },
+    { 55,  219, 248, 248, 64,  59,  126, 44,  143, 73,  144,
+      27,  84,  60,  253, 109, 21,  63,  109, 120, 64,  5,
+      51,  209, 111, 95,  220, 250, 5,   65,  216, 174 },
+    { 137, 84,  31,  16, 71,  247, 165, 104, 6,   254, 22,
+      239, 218, 76,  44, 220, 69,  241, 65,  200, 56,  228,
+      19,  1,   159, 1,  36,  24,  159, 165, 82,  50 },
+  };
+
+  size_t i_size = 0;
+  for (size_t m = 0; m < msg_cnt; m++) {
+    i_size += lens[m];
+  }
+
+  sycl::uchar* i_h = static_cast<sycl::uchar*>(std::malloc(i_size));
+  sycl::uchar* o_h = static_cast<sycl::uchar*>(std::malloc(msg_cnt * 32));
+  size_t* l_h = static_cast<size_t*>(std::malloc(sizeof(lens)));
+
+  sycl::uchar* i_d = static_cast<sycl::uchar*>(sycl::malloc_device(i_size, q));
+  sycl::uchar* o_d =
+    static_cast<sycl::uchar*>(sycl::malloc_device(msg_cnt * 32, q));
+  size_t* l_d = static_cast<size_t*>(sycl::malloc_device(sizeof(lens), q));
+
+  size_t offset = 0;
+  for (size_t m = 0; m < msg_cnt; m++) {
+    for (size_t i = 0; i < lens[m]; i++) {
+      i_h[offset + i] = static_cast<sycl::uchar>(i % 251);
+    }
+    l_h[m] = lens[m];
+    offset += lens[m];
+  }
+
+  q.memcpy(i_d, i_h, i_size).wait();
+  q.memcpy(l_d, l_h, sizeof(lens)).wait();
+
+  // all three kernels run concurrently, connected by pipes
+  sycl::event evt_0 = blake3::feed_ip<in_pipe>(q, i_d, l_d, msg_cnt);
+  sycl::event evt_1 = blake3::launch_ip<in_pipe, out_pipe>(q, msg_cnt);
+  sycl::event evt_2 = blake3::drain_ip<out_pipe>(q, o_d, msg_cnt);
+
+  evt_2.wait();
+  evt_1.wait();
+  evt_0.wait();
+
+  q.memcpy(o_h, o_d, msg_cnt * 32).wait();
+
+  for (size_t m = 0; m < msg_cnt; m++) {
+    assert(std::equal(expected[m], expected[m] + 32, o_h + m * 32));
+  }
+
+  sycl::free(i_d, q);
+  sycl::free(o_d, q);
+  sycl::free(l_d, q);
+
+  std::free(i_h);
+  std::free(o_h);
+  std::free(l_h);
+}
+
+// Computes BLAKE3 digest of 1MB input ( all bytes 0xff ), using each of host
+// wait strategies, checking that all of them observe completed kernel i.e.
+// digest is same as expected one ( see below in `main` )
+//
+// Note, wait cost isn't collected, because test queue doesn't have profiling
+// enabled
+void
+test_wait_strategies(sycl::queue& q)
+{
+  constexpr size_t chunk_count = 1 << 10;
+  constexpr size_t i_size = chunk_count * blake3::CHUNK_LEN;
+
+  constexpr sycl::uchar expected[32] = {
+    3,   107, 169, 54, 188, 220, 105, 198, 56,  19, 158,
+    182, 125, 203, 4,  77,  220, 197, 132, 215, 44, 187,
+    125, 130, 161, 92, 234, 112, 223, 45,  212, 205
+  };
+
+  constexpr wait_strategy strategies[] = {
+    wait_strategy::blocking,
+    wait_strategy::yield,
+    wait_strategy::adaptive,
+    wait_strategy::polling,
+  };
+
+  sycl::uchar* i_h = static_cast<sycl::uchar*>(std::malloc(i_size));
+  sycl::uchar* o_h = static_cast<sycl::uchar*>(std::malloc(blake3::OUT_LEN));
+  sycl::uchar* i_d = static_cast<sycl::uchar*>(sycl::malloc_device(i_size, q));
+  sycl::uchar* o_d =
+    static_cast<sycl::uchar*>(sycl::malloc_device(blake3::OUT_LEN, q));
+
+  std::memset(i_h, 0xff, i_size);
+  q.memcpy(i_d, i_h, i_size).wait();
+
+  for (const wait_strategy ws : strategies) {
+    q.memset(o_d, 0, blake3::OUT_LEN).wait();
+    blake3::hash(q, i_d, i_size, chunk_count, o_d, nullptr, ws, nullptr);
+    q.memcpy(o_h, o_d, blake3::OUT_LEN).wait();
+
+    assert(std::equal(expected, expected + 32, o_h));
+  }
+
+  sycl::free(i_d, q);
+  sycl::free(o_d, q);
+
+  std::free(i_h);
+  std::free(o_h);
+}
+
+// Hashes two payloads of 16KB ( first one's i-th byte is ( i % 251 ), all
+// bytes of second one are 0xff ) one after another, using same buffer layout,
+// both with and without recorded command graph, then payloads of 2KB and 1MB,
+// on either side of small payload kernel, checking digests against python3
+// `blake3` package
+void
+test_hash_graph(sycl::queue& q)
+{
+  constexpr size_t chunk_count = 16;
+  constexpr size_t i_size = chunk_count * blake3::CHUNK_LEN;
+
+  constexpr sycl::uchar expected[2][32] = {
+    { 248, 117, 214, 100, 109, 226, 137, 133, 100, 111, 52,
+      238, 19,  190, 154, 87,  111, 213, 21,  247, 107, 91,
+      10,  38,  187, 50,  71,  53,  4,   29,  221, 228 },
+    { 176, 109, 73,  85,  154, 91,  86, 170, 101, 67, 255,
+      137, 119, 92,  238, 94,  122, 64, 229, 79,  90, 156,
+      91,  148, 211, 116, 86,  141, 47, 17,  214, 82 },
+  };
+
+  for (const bool record : { true, false }) {
+    blake3::hash_graph g{ q, chunk_count, record };
+
+    for (size_t i = 0; i < i_size; i++) {
+      g.payload()[i] = static_cast<sycl::uchar>(i % 251);
+    }
+    g.replay();
+    assert(std::equal(expected[0], expected[0] + 32, g.digest()));
+
+    std::memset(g.payload(), 0xff, i_size);
+    g.replay();
+    assert(std::equal(expected[1], expected[1] + 32, g.digest()));
+  }
+
+  // smallest payload and smallest one hashed by `submit_hash`, where i-th byte
+  // is ( i % 251 )
+  constexpr size_t counts[2] = { 2, blake3::GRAPH_SMALL_CHUNKS };
+  constexpr sycl::uchar expected_i[2][32] = {
+    { 231, 118, 182, 2,  140, 124, 210, 42,  77,  11,  161,
+      130, 168, 191, 98, 32,  93,  46,  245, 118, 70,  126,
+      131, 142, 214, 242, 82, 155, 133, 251, 162, 74 },
+    { 116, 203, 68,  31, 208, 135, 118, 76,  169, 195, 105,
+      77,  167, 66,  235, 227, 12,  190, 179, 6,   10,  23,
+      0,   156, 168, 24,  37, 199, 168, 209, 3,   67 },
+  };
+
+  for (size_t j = 0; j < 2; j++) {
+    blake3::hash_graph g{ q, counts[j] };
+
+    for (size_t i = 0; i < counts[j] * blake3::CHUNK_LEN; i++) {
+      g.payload()[i] = static_cast<sycl::uchar>(i % 251);
+    }
+    g.replay();
+    assert(std::equal(expected_i[j], expected_i[j] + 32, g.digest()));
+  }
+}
+
+// Assembles digests of objects ( of lengths 0, 1, 1024, 2048 and 300000, where
+// i-th byte is ( i % 251 ) ), whose parts are added out of order, where part
+// boundaries aren't chunk aligned; also checks that incomplete object can't be
+// finalized, while batch size is kept small, so that large part is hashed in
+// many launches; then adds same parts from concurrent threads; digests computed
+// using python3 `blake3` package
+void
+test_multipart(sycl::queue& q)
+{
+  constexpr size_t obj_cnt = 5;
+  constexpr size_t sizes[obj_cnt] = { 0, 1, 1024, 2048, 300000 };
+  constexpr sycl::uchar expected[obj_cnt][32] = {
+    { 175, 19,  73,  185, 245, 249, 161, 166, 160, 64,  77,
+      234, 54,  220, 201, 73,  155, 203, 37,  201, 173, 193,
+      18,  183, 204, 154, 147, 202, 228, 31,  50,  98 },
+    { 45,  58,  222, 223, 241, 27, 97,  241, 76,  136, 110,
+      53,  175, 160, 54,  115, 109, 205, 135, 167, 77,  39,
+      181, 193, 81,  2,   37,  208, 245, 146, 226, 19 },
+    { 66,  33,  71,  57,  240, 149, 164, 6,  243, 252, 131,
+      222, 184, 137, 116, 74,  192, 13,  248, 49, 193, 13,
+      170, 85,  24,  155, 93,  18,  28,  133, 90, 247 },
+    { 231, 118, 182, 2,   140, 124, 210, 42,  77,  11,  161,
+      130, 168, 191, 98,  32,  93,  46,  245, 118, 70,  126,
+      131, 142, 214, 242, 82,  155, 133, 251, 162, 74 },
+    { 108, 201, 220, 224, 93, 76, 255, 140, 91,  239, 92,
+      90,  36,  104, 30,  66, 177, 63, 3,   227, 74,  11,
+      197, 230, 111, 101, 169, 29, 72, 201, 68,  250 },
+  };
+
+  std::vector<sycl::uchar> data(sizes[obj_cnt - 1]);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<sycl::uchar>(i % 251);
+  }
+
+  sycl::uchar digest[32];
+
+  // whole object as one part
+  for (size_t i = 0; i < obj_cnt - 1; i++) {
+    blake3::multipart_assembler a{ q, 16 };
+
+    a.add_part(0, data.data(), sizes[i]);
+    assert(a.finalize(sizes[i], digest));
+    assert(std::equal(expected[i], expected[i] + 32, digest));
+  }
+
+  // boundaries of parts, which are added in shuffled order
+  constexpr size_t b_cnt = 7;
+  constexpr size_t bounds[b_cnt] = { 0,      700,    70001, 140000,
+                                     200003, 262144, 300000 };
+  constexpr size_t order[b_cnt - 1] = { 3, 0, 5, 2, 4, 1 };
+
+  blake3::multipart_assembler a{ q, 16 };
+
+  for (size_t i = 0; i < b_cnt - 1; i++) {
+    const size_t p = order[i];
+
+    // last part is still missing
+    assert(!a.finalize(sizes[obj_cnt - 1], digest));
+    a.add_part(bounds[p], data.data() + bounds[p], bounds[p + 1] - bounds[p]);
+  }
+
+  assert(a.finalize(sizes[obj_cnt - 1], digest));
+  assert(std::equal(expected[obj_cnt - 1], expected[obj_cnt - 1] + 32, digest));
+
+  // same parts, added concurrently, one thread per part
+  a.reset();
+
+  std::vector<std::thread> adders;
+  for (size_t p = 0; p < b_cnt - 1; p++) {
+    adders.emplace_back([&, p]() {
+      a.add_part(bounds[p], data.data() + bounds[p], bounds[p + 1] - bounds[p]);
+    });
+  }
+  for (auto& t : adders) {
+    t.join();
+  }
+
+  assert(a.finalize(sizes[obj_cnt - 1], digest));
+  assert(std::equal(expected[obj_cnt - 1], expected[obj_cnt - 1] + 32, digest));
+}
+
+// Stores digests into persistent cache, checking that they're found again (
+// also after reopening cache file, and after table grew ), while stale entries
+// ( file size, mtime or ctime changed ) and racily modified files miss
+void
+test_digest_cache()
+{
+  char path[] = "/tmp/blake3-cache-XXXXXX";
+  const int tmp_fd = mkstemp(path);
+  assert(tmp_fd >= 0);
+  close(tmp_fd);
+
+  // 2020-01-01, so that entries aren't racy, when stored now
+  constexpr int64_t t_0 = 1577836800;
+  const int64_t now = static_cast<int64_t>(time(nullptr)) * 1'000'000'000l;
+
+  auto make_stat = [&](const uint64_t ino, const uint64_t size) {
+    struct stat st;
+    std::memset(&st, 0, sizeof(st));
+    st.st_dev = 42;
+    st.st_ino = ino;
+    st.st_size = static_cast<off_t>(size);
+    st.st_mtim.tv_sec = t_0 + static_cast<int64_t>(ino);
+    st.st_ctim.tv_sec = t_0 + static_cast<int64_t>(ino);
+    return st;
+  };
+
+  auto make_digest = [](const uint64_t ino, uint8_t* const digest) {
+    for (size_t i = 0; i < 32; i++) {
+      digest[i] = static_cast<uint8_t>(ino * 31 + i);
+    }
+  };
+
+  // more than half of initial slots, so that table grows
+  constexpr size_t file_cnt = blake3::CACHE_MIN_SLOTS;
+
+  uint8_t digest[32];
+  uint8_t found[32];
+
+  {
+    blake3::digest_cache cache;
+    assert(cache.open(path));
+
+    for (uint64_t i = 0; i < file_cnt; i++) {
+      make_digest(i, digest);
+      assert(cache.store(make_stat(i, i << 10), digest, now));
+    }
+    assert(cache.size() == file_cnt);
+
+    // same file, rewritten with other content, replaces its entry
+    struct stat st = make_stat(7, 7 << 10);
+    st.st_mtim.tv_sec++;
+    make_digest(1 << 20, digest);
+    assert(cache.store(st, digest, now));
+    assert(cache.size() == file_cnt);
+
+    // racily modified file isn't stored
+    struct stat racy = make_stat(file_cnt, 1);
+    racy.st_mtim.tv_sec = now / 1'000'000'000l;
+    assert(!cache.store(racy, digest, now));
+    assert(errno == EAGAIN);
+  }
+
+  blake3::digest_cache cache;
+  assert(cache.open(path));
+  assert(cache.size() == file_cnt);
+
+  for (uint64_t i = 0; i < file_cnt; i++) {
+    if (i == 7) {
+      continue;
+    }
+
+    make_digest(i, digest);
+    assert(cache.lookup(make_stat(i, i << 10), found));
+    assert(std::equal(digest, digest + 32, found));
+  }
+
+  // file 7 is stale, unless its new mtime is given
+  assert(!cache.lookup(make_stat(7, 7 << 10), found));
+  struct stat st = make_stat(7, 7 << 10);
+  st.st_mtim.tv_sec++;
+  make_digest(1 << 20, digest);
+  assert(cache.lookup(st, found));
+  assert(std::equal(digest, digest + 32, found));
+
+  // size or ctime changed, or never stored
+  assert(!cache.lookup(make_stat(3, 1), found));
+  st = make_stat(3, 3 << 10);
+  st.st_ctim.tv_nsec = 1;
+  assert(!cache.lookup(st, found));
+  assert(!cache.lookup(make_stat(file_cnt, 1), found));
+
+  cache.close();
+  unlink(path);
+}
+
+// Splits 512KB pseudo random input into content defined segments, checking
+// that boundaries found on accelerator match those found on host, that segment
+// sizes respect given limits and that digest of each segment matches digest
+// assembled by `multipart_assembler`; then inserts a few bytes at start of
+// input, checking that all but first few segments ( and their digests ) are
+// found again, only shifted
+void
+test_cdc_segments(sycl::queue& q)
+{
+  constexpr size_t len = 1 << 19;
+  constexpr size_t ins = 13;
+  const blake3::cdc_params_t p{};
+
+  // xorshift64, so that input has no period, which could align boundaries
+  std::vector<sycl::uchar> data(ins + len);
+  uint64_t x = 0x9e3779b97f4a7c15ul;
+  for (size_t i = 0; i < data.size(); i++) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    data[i] = static_cast<sycl::uchar>(x >> 56);
+  }
+
+  const sycl::uchar* const orig = data.data() + ins;
+
+  const auto cuts = blake3::cdc_cuts_host(orig, len, p);
+  const auto segs = blake3::hash_segments(q, orig, len, p);
+
+  assert(segs.size() == cuts.size());
+  assert(segs.size() > 1);
+
+  blake3::multipart_assembler a{ q };
+  sycl::uchar digest[32];
+
+  for (size_t i = 0; i < segs.size(); i++) {
+    const size_t start = i == 0 ? 0 : cuts[i - 1];
+
+    assert(segs[i].offset == start);
+    assert(segs[i].offset + segs[i].length == cuts[i]);
+    assert(segs[i].length <= p.max);
+    assert(i + 1 == segs.size() || segs[i].length > p.min);
+
+    a.reset();
+    a.add_part(0, orig + start, segs[i].length);
+    assert(a.finalize(segs[i].length, digest));
+    assert(std::equal(digest, digest + 32, segs[i].digest));
+  }
+  assert(cuts.back() == len);
+
+  // same input, with a few bytes prepended
+  const auto shifted = blake3::hash_segments(q, data.data(), ins + len, p);
+
+  size_t matched = 0;
+  for (const auto& s : shifted) {
+    for (const auto& o : segs) {
+      if (s.offset == o.offset + ins && s.length == o.length) {
+        assert(std::equal(s.digest, s.digest + 32, o.digest));
+        matched++;
+      }
+    }
+  }
+  assert(matched + 2 >= segs.size());
+}
+
+// Generates signature file of pseudo random input, spanning more than one
+// window and ending with a partial block, for two block sizes, checking that
+// weak and strong checksums of each block match those computed on host, then
+// that rolling weak checksum over input matches weak checksum of each window
+void
+test_block_signatures(sycl::queue& q)
+{
+  constexpr size_t len = blake3::SIG_WINDOW + (1 << 13) + 777;
+
+  // xorshift64, so that no two blocks are alike
+  std::vector<sycl::uchar> data(len);
+  uint64_t x = 0x9e3779b97f4a7c15ul;
+  for (size_t i = 0; i < len; i++) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    data[i] = static_cast<sycl::uchar>(x >> 56);
+  }
+
+  for (const size_t block_len : { size_t(1 << 11), blake3::SIG_BLOCK_LEN }) {
+    std::FILE* sig = std::tmpfile();
+    assert(sig != nullptr);
+
+    {
+      blake3::signature_generator g{ q, block_len, 20 };
+      const bool written = g.write(data.data(), len, fileno(sig));
+      assert(written);
+    }
+
+    blake3::sig_header_t h;
+    std::vector<blake3::block_sig_t> sigs;
+    const bool read = blake3::read_signatures(fileno(sig), h, sigs);
+    assert(read);
+
+    assert(h.block_len == block_len && h.file_len == len && h.strong_len == 20);
+    assert(sigs.size() == (len + block_len - 1) / block_len);
+
+    sycl::uchar digest[32];
+    for (size_t i = 0; i < sigs.size(); i++) {
+      const size_t off = i * block_len;
+      const size_t blk_len = std::min(block_len, len - off);
+
+      blake3::host_hash_copy(data.data() + off, nullptr, blk_len, digest);
+
+      assert(sigs[i].weak == blake3::weak_checksum(data.data() + off, blk_len));
+      assert(std::equal(digest, digest + 20, sigs[i].strong));
+    }
+
+    std::fclose(sig);
+  }
+
+  constexpr size_t win = 1 << 11;
+  uint32_t sum = blake3::weak_checksum(data.data(), win);
+  for (size_t i = 1; i + win <= (1 << 14); i++) {
+    sum = blake3::weak_roll(sum, data[i - 1], data[i + win - 1], win);
+    assert(sum == blake3::weak_checksum(data.data() + i, win));
+  }
+}
+
+// Derives keys from key materials of a few sizes ( spanning one, two and all
+// sixteen message blocks of a chunk ), on host and on accelerator, checking
+// them against known derived keys, while checking that context key is computed
+// once; then checks CLOCK eviction in a single set cache and concurrent lookups
+void
+test_derive_key(sycl::queue& q)
+{
+  constexpr size_t cnt = 5;
+  constexpr size_t sizes[cnt] = { 0, 1, 64, 65, 1024 };
+  constexpr std::string_view ctx = "blake3-fpga 2026-10-18 session keys v1";
+
+  // >>> list(blake3.blake3(bytes(i % 251 for i in range(n)),
+  // ...                    derive_key_context=ctx).digest())
+  constexpr sycl::uchar expected[cnt][32] = {
+    { 89, 170, 114, 51, 237, 13, 45, 192, 189, 137, 11,
+      172, 242, 250, 86, 111, 76, 56, 8, 228, 130, 39,
+      131, 248, 65, 211, 49, 239, 131, 120, 36, 186 },
+    { 221, 17, 182, 208, 95, 200, 0, 145, 165, 194, 128,
+      89, 240, 32, 203, 17, 134, 133, 139, 222, 4, 205,
+      33, 4, 68, 150, 235, 129, 230, 106, 158, 140 },
+    { 44, 236, 73, 149, 1, 57, 173, 199, 101, 153, 187,
+      137, 69, 28, 232, 219, 172, 232, 247, 75, 161, 11,
+      32, 124, 124, 241, 219, 91, 13, 201, 133, 30 },
+    { 15, 95, 152, 72, 181, 100, 73, 15, 137, 240, 140,
+      47, 244, 88, 101, 226, 196, 103, 44, 200, 162, 127,
+      3, 210, 35, 209, 188, 216, 161, 235, 184, 136 },
+    { 229, 129, 103, 117, 29, 77, 110, 206, 204, 212, 114,
+      100, 136, 111, 203, 212, 240, 179, 167, 28, 232, 214,
+      106, 223, 229, 212, 152, 244, 47, 242, 1, 146 }
+  };
+
+  blake3::derive_key_cache cache;
+
+  sycl::uchar buf[blake3::CHUNK_LEN];
+  for (size_t i = 0; i < blake3::CHUNK_LEN; i++) {
+    buf[i] = static_cast<sycl::uchar>(i % 251);
+  }
+
+  sycl::uchar key[32];
+  for (size_t i = 0; i < cnt; i++) {
+    blake3::derive_key(cache, ctx, buf, sizes[i], key);
+    assert(std::equal(key, key + 32, expected[i]));
+  }
+
+  // 100 key materials, of each size, where j-th one is shifted by j bytes
+  constexpr size_t m_cnt = 100;
+  std::vector<sycl::uchar> mats(m_cnt * blake3::CHUNK_LEN);
+  for (size_t i = 0; i < mats.size(); i++) {
+    mats[i] = static_cast<sycl::uchar>(i % 253);
+  }
+
+  sycl::uchar* mats_d = static_cast<sycl::uchar*>(
+    sycl::malloc_device(m_cnt * blake3::CHUNK_LEN, q));
+  sycl::uchar* keys_d =
+    static_cast<sycl::uchar*>(sycl::malloc_device(m_cnt * 32, q));
+  std::vector<sycl::uchar> keys(m_cnt * 32);
+
+  for (size_t i = 0; i < cnt; i++) {
+    const size_t m_len = sizes[i];
+
+    q.memcpy(mats_d, mats.data(), m_cnt * m_len).wait();
+    blake3::derive_keys(q, cache, ctx, mats_d, m_len, m_cnt, keys_d, nullptr);
+    q.memcpy(keys.data(), keys_d, m_cnt * 32).wait();
+
+    for (size_t j = 0; j < m_cnt; j++) {
+      blake3::derive_key(cache, ctx, mats.data() + j * m_len, m_len, key);
+      assert(std::equal(key, key + 32, keys.data() + j * 32));
+    }
+  }
+
+  sycl::free(mats_d, q);
+  sycl::free(keys_d, q);
+
+  const blake3::derive_cache_stats_t st = cache.stats();
+  assert(st.misses == 1 && st.inserts == 1 && st.evictions == 0);
+  assert(st.hits == cnt - 1 + cnt * (m_cnt + 1));
+
+  // one set of four entries, where recently used contexts survive eviction
+  blake3::derive_key_cache small{ blake3::DERIVE_CACHE_WAYS };
+  const std::string ctxs[] = { "ctx a", "ctx b", "ctx c", "ctx d", "ctx e" };
+
+  uint32_t words[8];
+  uint32_t expected_words[8];
+  for (size_t i = 0; i < 4; i++) {
+    small.context_key(ctxs[i], words);
+  }
+  assert(small.lookup(ctxs[0], words));
+  small.context_key(ctxs[4], words);
+  assert(small.lookup(ctxs[0], words));
+  assert(small.lookup(ctxs[4], words));
+  assert(small.stats().evictions == 1);
+
+  // long contexts aren't cached, but their context key is still right
+  const std::string long_ctx(blake3::DERIVE_CTX_MAX + 1, 'x');
+  small.context_key(long_ctx, words);
+  blake3::context_key_host(long_ctx, expected_words);
+  assert(std::equal(words, words + 8, expected_words));
+  assert(!small.lookup(long_ctx, words));
+
+  // many threads deriving context keys of more contexts than cache holds
+  blake3::derive_key_cache shared{ 8 };
+  std::atomic<size_t> wrong{ 0 };
+  std::vector<std::thread> threads;
+
+  for (size_t t = 0; t < 4; t++) {
+    threads.emplace_back([&, t]() {
+      uint32_t w[8];
+      uint32_t e[8];
+
+      for (size_t i = 0; i < 2000; i++) {
+        const std::string c = "context " + std::to_string((i * 7 + t) % 12);
+
+        shared.context_key(c, w);
+        blake3::context_key_host(c, e);
+        wrong += std::equal(w, w + 8, e) ? 0 : 1;
+      }
+    });
+  }
+  for (auto& th : threads) {
+    th.join();
+  }
+
+  const blake3::derive_cache_stats_t sh = shared.stats();
+  assert(wrong == 0);
+  assert(sh.hits + sh.misses == 4 * 2000 && sh.hits > 0);
+}
+
 int
 main(int argc, char** argv)
 {
@@ -72,5 +1605,76 @@ main(int argc, char** argv)
 
   std::cout << "passed blake3 test !" << std::endl;
 
+  test_bao_slices(q);
+  test_bao_single_chunk(q);
+  std::cout << "passed bao slice verification test !" << std::endl;
+
+  test_sparse_file(q);
+  test_sparse_hole_file(q);
+  std::cout << "passed sparse file hashing test !" << std::endl;
+
+  test_daemon(q);
+  std::cout << "passed local hashing daemon test !" << std::endl;
+
+  // shallowest, default and deepest staging buffer
+  test_hasher(q, blake3::hash_staged<1>);
+  test_hasher(q, blake3::hash_staged<blake3::STAGE_DEPTH>);
+  test_hasher(q, blake3::hash_staged<64>);
+  std::cout << "passed on-chip staged blake3 test !" << std::endl;
+
+  // smallest, default and largest pool of compress engines
+  test_hasher(q, blake3::hash_pooled<2>);
+  test_hasher(q, blake3::hash_pooled<blake3::POOL_LANES>);
+  test_hasher(q, blake3::hash_pooled<8>);
+  std::cout << "passed shared compress engine pool test !" << std::endl;
+
+  // one, default and largest number of iterative cores
+  test_hasher(q, blake3::hash_iterative<1>);
+  test_hasher(q, blake3::hash_iterative<blake3::ITER_LANES>);
+  test_hasher(q, blake3::hash_iterative<128>);
+  std::cout << "passed iterative compress core test !" << std::endl;
+
+  test_hash_many(q);
+  std::cout << "passed pipelined multi-job blake3 test !" << std::endl;
+
+  test_mapped_file(q);
+  std::cout << "passed mapped file hashing test !" << std::endl;
+
+  test_stream_engine(q);
+  std::cout << "passed multiplexed stream hashing test !" << std::endl;
+
+  test_trace();
+  std::cout << "passed address trace simulation test !" << std::endl;
+
+  test_pack_writer(q);
+  std::cout << "passed content-addressed pack writer test !" << std::endl;
+
+  test_host_compress();
+  std::cout << "passed row vectorized host compression test !" << std::endl;
+
+  test_ip_component(q);
+  std::cout << "passed streaming IP component test !" << std::endl;
+
+  test_wait_strategies(q);
+  std::cout << "passed host wait strategy test !" << std::endl;
+
+  test_hash_graph(q);
+  std::cout << "passed command graph replay test !" << std::endl;
+
+  test_multipart(q);
+  std::cout << "passed out-of-order multipart assembly test !" << std::endl;
+
+  test_digest_cache();
+  std::cout << "passed persistent digest cache test !" << std::endl;
+
+  test_cdc_segments(q);
+  std::cout << "passed content defined chunking test !" << std::endl;
+
+  test_block_signatures(q);
+  std::cout << "passed block signature test !" << std::endl;
+
+  test_derive_key(q);
+  std::cout << "passed derive_key context cache test !" << std::endl;
+
   return EXIT_SUCCESS;
 }
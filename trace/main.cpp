@@ -0,0 +1,70 @@
+#include "trace.hpp"
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Host tool, which ranks global memory schedules of BLAKE3 kernels by
+// generating their exact address trace and running it through a simple DDR
+// model ( see include/trace.hpp ), without compiling for FPGA
+//
+// Usage: ./trace.out [log2 of max chunk count, default 16]
+int
+main(int argc, char** argv)
+{
+  using namespace blake3::trace;
+
+  const size_t max_log = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+  const ddr_config_t cfg{};
+
+  struct candidate_t
+  {
+    std::string name;
+    schedule sched;
+    size_t tile;
+  };
+
+  const candidate_t candidates[] = {
+    { "interleaved", schedule::interleaved, 0 },
+    { "chunk-major", schedule::chunk_major, 0 },
+    { "tiled ( 64 )", schedule::tiled, 64 },
+    { "tiled ( 1024 )", schedule::tiled, 1024 },
+  };
+
+  std::cout << "Simulating BLAKE3 global memory schedules, on "
+            << cfg.peak_gbps << " GB/s DDR channel ( " << cfg.banks
+            << " banks, " << cfg.row_bytes << " -bytes rows )" << std::endl
+            << std::endl;
+  std::cout << std::setw(12) << std::right << "input size" << std::setw(18)
+            << std::right << "schedule" << std::setw(16) << std::right
+            << "bytes moved" << std::setw(16) << std::right << "row hit rate"
+            << std::setw(14) << std::right << "efficiency" << std::setw(16)
+            << std::right << "bandwidth" << std::endl;
+
+  for (size_t l = 10; l <= max_log; l++) {
+    const size_t chunk_count = 1ul << l;
+    const size_t i_size = chunk_count * CHUNK_LEN;
+
+    for (const candidate_t& c : candidates) {
+      if (c.sched == schedule::tiled && c.tile > chunk_count) {
+        continue;
+      }
+
+      // streamed, trace of 1GB input would take >1GB, if materialized
+      const ddr_stats_t st = simulate(c.sched, chunk_count, c.tile, cfg);
+
+      const double hit_rate = static_cast<double>(st.row_hits) /
+                              static_cast<double>(st.row_hits + st.row_misses);
+
+      std::cout << std::setw(9) << std::right << (i_size >> 20) << " MB"
+                << std::setw(18) << std::right << c.name << std::setw(16)
+                << std::right << st.bursts * cfg.burst_bytes << std::setw(14)
+                << std::right << std::fixed << std::setprecision(2)
+                << hit_rate * 100. << " %" << std::setw(12) << std::right
+                << st.efficiency(cfg) * 100. << " %" << std::setw(11)
+                << std::right << st.bandwidth(cfg) << " GB/s" << std::endl;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}